@@ -0,0 +1,150 @@
+// Micro-benchmark Harness class
+#pragma once
+
+#include "types.h"
+#include <functional>
+
+// ================================ Benchmark Class ================================
+/**
+ * @brief Micro-benchmark harness class
+ * @details Every benchmark is a function, which performs a fixed batch of operations (e.g. intersects 4096 rays with a triangle) and
+ * returns a value depending on all of them, so that the compiler can not remove the work. The harness calibrates the number of calls,
+ * so that one sample takes at least the minimal sample time, runs one warm-up sample and then the given number of samples. The time
+ * per operation is reported as the minimum, the median, the mean and the standard deviation over the samples; the median is the robust
+ * estimate to compare between the runs.
+ * @code
+ * CBenchmark bench(15, 20);
+ * bench.run("transform point", vPoints.size(), [&] { ... return sum; });
+ * bench.print();
+ * bench.writeJson("bench.json");
+ * @endcode
+ */
+class CBenchmark
+{
+public:
+	/// Statistics of a benchmark
+	struct Result {
+		std::string	name;				///< The name of the benchmark
+		size_t		ops = 0;			///< The number of operations per sample
+		size_t		samples = 0;		///< The number of samples
+		double		min = 0;			///< The minimal time per operation in nanoseconds
+		double		median = 0;			///< The median time per operation in nanoseconds
+		double		mean = 0;			///< The mean time per operation in nanoseconds
+		double		stddev = 0;			///< The standard deviation of the time per operation in nanoseconds
+	};
+
+	/**
+	 * @brief Constructor
+	 * @param nSamples The number of samples per benchmark
+	 * @param minSampleTime The minimal duration of a sample in milliseconds
+	 * @param filter Only the benchmarks, whose names contain this string, are run (empty - all)
+	 */
+	CBenchmark(size_t nSamples = 15, double minSampleTime = 20, const std::string& filter = "")
+		: m_nSamples(MAX(1, nSamples))
+		, m_minSampleTime(minSampleTime)
+		, m_filter(filter)
+	{}
+	CBenchmark(const CBenchmark&) = delete;
+	~CBenchmark(void) = default;
+	const CBenchmark& operator=(const CBenchmark&) = delete;
+
+	/**
+	 * @brief Checks whether the benchmark \b name passes the filter
+	 * @details This allows to skip the preparation of the data of the filtered benchmarks
+	 * @param name The name of the benchmark
+	 * @retval true If the benchmark is to be run
+	 * @retval false Otherwise
+	 */
+	bool isEnabled(const std::string& name) const { return m_filter.empty() || name.find(m_filter) != std::string::npos; }
+	/**
+	 * @brief Runs the benchmark
+	 * @param name The name of the benchmark
+	 * @param ops The number of operations performed by one call of \b fn
+	 * @param fn The function performing the operations and returning a value depending on them
+	 */
+	void run(const std::string& name, size_t ops, const std::function<double(void)>& fn)
+	{
+		if (!isEnabled(name)) return;
+
+		// calibration: the number of calls per sample
+		size_t nCalls = 1;
+		for (;;) {
+			double time = measure(fn, nCalls);
+			if (time >= m_minSampleTime || nCalls >= (1 << 24)) break;
+			nCalls = time > 0 ? MAX(nCalls + 1, static_cast<size_t>(nCalls * 1.2 * m_minSampleTime / time)) : 2 * nCalls;
+		}
+
+		measure(fn, nCalls);												// warm-up
+		std::vector<double> vTimes(m_nSamples);
+		for (double& time : vTimes)
+			time = 1e6 * measure(fn, nCalls) / (nCalls * MAX(1, ops));		// nanoseconds per operation
+
+		Result res;
+		res.name = name;
+		res.ops = nCalls * ops;
+		res.samples = m_nSamples;
+		std::sort(vTimes.begin(), vTimes.end());
+		res.min = vTimes.front();
+		res.median = vTimes.size() % 2 ? vTimes[vTimes.size() / 2] : 0.5 * (vTimes[vTimes.size() / 2 - 1] + vTimes[vTimes.size() / 2]);
+		for (double time : vTimes) res.mean += time / vTimes.size();
+		for (double time : vTimes) res.stddev += (time - res.mean) * (time - res.mean) / MAX(1, vTimes.size() - 1);
+		res.stddev = sqrt(res.stddev);
+		printf("%-32s %12.2f %12.2f %10.2f%%\n", name.c_str(), res.median, res.min, res.median > 0 ? 100 * res.stddev / res.median : 0);
+		fflush(stdout);
+		m_vResults.push_back(res);
+	}
+	/// Prints the header of the table of the results, which run() fills
+	void printHeader(void) const { printf("%-32s %12s %12s %11s\n", "benchmark", "median (ns)", "min (ns)", "stddev"); }
+	/**
+	 * @brief Returns the results of the benchmarks run so far
+	 * @return The results
+	 */
+	const std::vector<Result>& getResults(void) const { return m_vResults; }
+	/**
+	 * @brief Writes the results as JSON
+	 * @param fileName The name of the JSON file ("-" - standard output)
+	 * @param seed The seed of the benchmark data, stored with the results
+	 * @retval true If the file was written
+	 * @retval false If the file could not be opened
+	 */
+	bool writeJson(const std::string& fileName, qword seed) const
+	{
+		FILE* pFile = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+		if (!pFile) return false;
+		fprintf(pFile, "{\n");
+		fprintf(pFile, "  \"seed\": %llu,\n", static_cast<unsigned long long>(seed));
+		fprintf(pFile, "  \"samples\": %zu,\n", m_nSamples);
+		fprintf(pFile, "  \"min_sample_ms\": %.3f,\n", m_minSampleTime);
+		fprintf(pFile, "  \"benchmarks\": [");
+		for (size_t i = 0; i < m_vResults.size(); i++) {
+			const Result& res = m_vResults[i];
+			fprintf(pFile, "%s\n    {\"name\": \"%s\", \"ops_per_sample\": %zu, \"samples\": %zu, \"ns_per_op\": {\"min\": %.4f, \"median\": %.4f, \"mean\": %.4f, \"stddev\": %.4f}}",
+				i ? "," : "", res.name.c_str(), res.ops, res.samples, res.min, res.median, res.mean, res.stddev);
+		}
+		fprintf(pFile, "\n  ]\n}\n");
+		if (pFile != stdout) fclose(pFile);
+		return true;
+	}
+
+
+private:
+	// Calls the function \b nCalls times and returns the time in milliseconds
+	double measure(const std::function<double(void)>& fn, size_t nCalls)
+	{
+		int64 ticks = getTickCount();
+		double sum = 0;
+		for (size_t c = 0; c < nCalls; c++)
+			sum += fn();
+		double res = 1000.0 * (getTickCount() - ticks) / getTickFrequency();
+		m_sink = m_sink + sum;
+		return res;
+	}
+
+
+private:
+	size_t				m_nSamples;			///< The number of samples per benchmark
+	double				m_minSampleTime;	///< The minimal duration of a sample in milliseconds
+	std::string			m_filter;			///< The filter of the benchmark names
+	std::vector<Result>	m_vResults;			///< The results of the benchmarks
+	volatile double		m_sink = 0;			///< The sum of the returned values, which keeps the benchmarked work alive
+};
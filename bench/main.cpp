@@ -0,0 +1,231 @@
+// Micro-benchmarks of the hot paths of the ray tracer
+#include "Benchmark.h"
+#include "BSPTree.h"
+#include "Scene.h"
+#include "LightOmni.h"
+#include "ShaderPhongT.h"
+#include "PrimSphere.h"
+#include "PrimTriangle.h"
+#include "SolidSphere.h"
+#include "ShaderFlat.h"
+#include "Texture.h"
+#include "Transform.h"
+#include "random.h"
+
+namespace {
+	// Returns a random point in the box [-size; size]^3
+	Vec3f randomPoint(CPCG32& rng, float size)
+	{
+		std::uniform_real_distribution<float> dist(-size, size);
+		return Vec3f(dist(rng), dist(rng), dist(rng));
+	}
+
+	// Returns the rays from the random points on the sphere with radius \b distance around \b center towards the random points near \b center
+	std::vector<Ray> randomRays(CPCG32& rng, const Vec3f& center, float distance, float spread, size_t n)
+	{
+		std::vector<Ray> res(n);
+		for (Ray& ray : res) {
+			ray.org = center + distance * normalize(randomPoint(rng, 1));
+			ray.dir = normalize(center + randomPoint(rng, spread) - ray.org);
+		}
+		return res;
+	}
+
+	// Returns small random triangles in the box [-1; 1]^3
+	std::vector<ptr_prim_t> randomTriangles(CPCG32& rng, ptr_shader_t pShader, size_t n, float size)
+	{
+		std::vector<ptr_prim_t> res;
+		res.reserve(n);
+		for (size_t i = 0; i < n; i++) {
+			Vec3f a = randomPoint(rng, 1);
+			res.push_back(std::make_shared<CPrimTriangle>(pShader, a, a + randomPoint(rng, size), a + randomPoint(rng, size)));
+		}
+		return res;
+	}
+
+	// Intersects every ray with the primitive and returns the number of hits
+	double intersectAll(const IPrim& prim, std::vector<Ray>& vRays)
+	{
+		size_t res = 0;
+		for (Ray& ray : vRays) {
+			ray.t = std::numeric_limits<double>::infinity();
+			if (prim.intersect(ray)) res++;
+		}
+		return static_cast<double>(res);
+	}
+
+	// Traverses the tree with every ray and returns the number of hits
+	double intersectAll(const CBSPTree& tree, std::vector<Ray>& vRays)
+	{
+		size_t res = 0;
+		for (Ray& ray : vRays) {
+			ray.t = std::numeric_limits<double>::infinity();
+			ray.hit = nullptr;
+			if (tree.intersect(ray)) res++;
+		}
+		return static_cast<double>(res);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string keys =
+		"{help ?      |              | Print this message}"
+		"{samples     | 15           | Number of samples per benchmark}"
+		"{min-time    | 20           | Minimal duration of a sample in milliseconds}"
+		"{filter      |              | Run only the benchmarks, whose names contain this string}"
+		"{seed        | 1            | Seed of the random benchmark data}"
+		"{json        | bench.json   | File name of the JSON results (- for the standard output, empty - do not write)}";
+	CommandLineParser parser(argc, argv, keys);
+	parser.about("eyden-bench");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+	const size_t nSamples	= static_cast<size_t>(MAX(1, parser.get<int>("samples")));
+	const double minTime	= MAX(0.0, parser.get<double>("min-time"));
+	const qword seed		= static_cast<qword>(MAX(0, parser.get<int>("seed")));
+	const std::string json	= parser.get<std::string>("json");
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
+	}
+
+	CBenchmark bench(nSamples, minTime, parser.get<std::string>("filter"));
+	auto pShader = std::make_shared<CShaderFlat>(RGB(1, 1, 1));
+	const size_t nRays = 4096;
+	bench.printHeader();
+
+	// Primitives
+	{
+		CPCG32 rng(seed);
+		// the primitives store the hits as shared pointers to themselves
+		auto pTriangle = std::make_shared<CPrimTriangle>(pShader, Vec3f(-1, -1, 0), Vec3f(1, -1, 0), Vec3f(0, 1, 0));
+		auto pSphere = std::make_shared<CPrimSphere>(pShader, Vec3f(0, 0, 0), 1.0f);
+		std::vector<Ray> vRays = randomRays(rng, Vec3f(0, 0, 0), 5, 1.5f, nRays);	// about half of the rays hit
+		bench.run("triangle intersect", vRays.size(), [&] { return intersectAll(*pTriangle, vRays); });
+		bench.run("sphere intersect", vRays.size(), [&] { return intersectAll(*pSphere, vRays); });
+
+		CBoundingBox box(Vec3f::all(-1), Vec3f::all(1));
+		bench.run("bbox clip", vRays.size(), [&] {
+			double res = 0;
+			for (const Ray& ray : vRays) {
+				double t0 = 0, t1 = std::numeric_limits<double>::infinity();
+				box.clip(ray, t0, t1);
+				if (t0 <= t1) res += t1 - t0;
+			}
+			return res;
+		});
+	}
+
+	// BSP tree on synthetic triangles and on the spheres of the main scene
+	{
+		CPCG32 rng(seed);
+		struct Scene {
+			std::string				name;
+			std::vector<ptr_prim_t>	vpPrims;
+			std::vector<Ray>		vRays;
+		};
+		std::vector<Scene> vScenes;
+		vScenes.push_back({ "synthetic 10k", randomTriangles(rng, pShader, 10000, 0.05f), randomRays(rng, Vec3f(0, 0, 0), 3, 1, nRays) });
+		vScenes.push_back({ "synthetic 100k", randomTriangles(rng, pShader, 100000, 0.02f), randomRays(rng, Vec3f(0, 0, 0), 3, 1, nRays) });
+		// the Earth and the Moon as in main.cpp, seen from the distance of the side camera
+		CSolidSphere earth(pShader, Vec3f(150000, 0, 0), 6.371f, 64);
+		CSolidSphere moon(pShader, Vec3f(150000, 0, -384), 1.737f, 64);
+		Scene spheres{ "spheres", earth.getPrims(), randomRays(rng, Vec3f(150000, 0, 0), 260, 8, nRays) };
+		spheres.vpPrims.insert(spheres.vpPrims.end(), moon.getPrims().begin(), moon.getPrims().end());
+		vScenes.push_back(spheres);
+		for (Scene& scene : vScenes) {
+			CBSPTree tree;
+			bench.run("bsp build " + scene.name, scene.vpPrims.size(), [&] {
+				tree.build(scene.vpPrims, 20, 3);
+				return static_cast<double>(scene.vpPrims.size());
+			});
+			tree.build(scene.vpPrims, 20, 3);
+			bench.run("bsp intersect " + scene.name, scene.vRays.size(), [&] { return intersectAll(tree, scene.vRays); });
+		}
+	}
+
+	// Texture
+	{
+		CPCG32 rng(seed);
+		std::uniform_real_distribution<float> dist(0, 1);
+		Mat img(1024, 2048, CV_32FC3);
+		for (int y = 0; y < img.rows; y++)
+			for (int x = 0; x < img.cols; x++)
+				img.at<Vec3f>(y, x) = Vec3f(dist(rng), dist(rng), dist(rng));
+		CTexture texture(img);
+		std::vector<Vec2f> vUVs(nRays);
+		for (Vec2f& uv : vUVs) uv = Vec2f(dist(rng), dist(rng));
+		bench.run("texture getTexel", vUVs.size(), [&] {
+			Vec3f res = Vec3f::all(0);
+			for (const Vec2f& uv : vUVs) res += texture.getTexel(uv);
+			return static_cast<double>(res.val[0]);
+		});
+	}
+
+	// Transforms
+	{
+		CPCG32 rng(seed);
+		CTransform transform;
+		Mat t = transform.rotate(Vec3f(0, 1, 0), 0.5f).translate(Vec3f(0.1f, 0, 0)).get();
+		std::vector<Vec3f> vPoints(nRays);
+		for (Vec3f& p : vPoints) p = randomPoint(rng, 10);
+		bench.run("transform point", vPoints.size(), [&] {
+			Vec3f res = Vec3f::all(0);
+			for (const Vec3f& p : vPoints) res += CTransform::point(p, t);
+			return static_cast<double>(res.val[0]);
+		});
+
+		CSolidSphere sphere(pShader, Vec3f(0, 0, 0), 1, 32);
+		bench.run("solid transform", sphere.getPrims().size(), [&] {
+			sphere.transform(t);
+			return static_cast<double>(sphere.getPivot().val[0]);
+		});
+	}
+
+	// Phong shaders of the main scene: generic against the specialized instantiation (textured, ks = 0, no shadows)
+	{
+		CPCG32 rng(seed);
+		std::uniform_real_distribution<float> dist(0, 1);
+		Mat img(256, 512, CV_32FC3);
+		for (int y = 0; y < img.rows; y++)
+			for (int x = 0; x < img.cols; x++)
+				img.at<Vec3f>(y, x) = Vec3f(dist(rng), dist(rng), dist(rng));
+		auto pTexture = std::make_shared<CTexture>(img);
+
+		CScene scene;
+		scene.add(std::make_shared<CLightOmni>(Vec3f::all(3e10), Vec3f(0, 0, 0), false));
+		auto pGeneric = std::make_shared<CShaderPhong>(scene, pTexture, 0.1f, 0.9f, 0.0f, 40.0f);
+		auto pSpecialized = makeShaderPhong(scene, pTexture, 0.1f, 0.9f, 0.0f, 40.0f);
+		CSolidSphere earth(pGeneric, Vec3f(150000, 0, 0), 6.371f, 64);
+		scene.add(earth);
+		scene.buildAccelStructure(20, 3);
+
+		// both shaders shade the same hits
+		std::vector<Ray> vRays = randomRays(rng, Vec3f(150000, 0, 0), 260, 4, nRays);
+		std::vector<const Ray*> vpHits;
+		for (Ray& ray : vRays)
+			if (scene.intersect(ray)) vpHits.push_back(&ray);
+		std::vector<Vec3f> vColors(vpHits.size());
+		std::vector<ShadowQuery> vShadows;
+		for (auto& [name, pShader] : { std::make_pair(std::string("generic"), ptr_shader_t(pGeneric)), std::make_pair(std::string("specialized"), pSpecialized) }) {
+			bench.run("phong shade " + name, vpHits.size(), [&, pShader = pShader] {
+				Vec3f res = Vec3f::all(0);
+				for (const Ray* pRay : vpHits) res += pShader->shade(*pRay);
+				return static_cast<double>(res.val[0]);
+			});
+			bench.run("phong shadeBatch " + name, vpHits.size(), [&, pShader = pShader] {
+				vShadows.clear();
+				pShader->shadeBatch(vpHits.data(), vpHits.size(), vColors.data(), vShadows);
+				return static_cast<double>(vColors.front().val[0] + vShadows.size());
+			});
+		}
+	}
+
+	if (!json.empty() && !bench.writeJson(json, seed)) {
+		fprintf(stderr, "ERROR: Can't write file %s\n", json.c_str());
+		return 2;
+	}
+	return 0;
+}
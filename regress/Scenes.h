@@ -0,0 +1,134 @@
+// Canonical scenes of the performance regression runner
+#pragma once
+
+#include "Scene.h"
+#include "CameraPerspective.h"
+#include "LightOmni.h"
+#include "PrimTriangle.h"
+#include "SolidSphere.h"
+#include "SolidCone.h"
+#include "SolidQuad.h"
+#include "ShaderPhongT.h"
+#include "Texture.h"
+#include "random.h"
+#include <functional>
+
+/// Canonical scene of the regression runner
+struct RegressionScene {
+	std::string	name;			///< The name of the scene
+	/// Fills the empty scene for the camera resolution and returns the variant of the scene (e.g. "procedural" if the data files are absent)
+	std::function<std::string(CScene& scene, Size resolution, const std::string& dataPath)>	build;
+};
+
+namespace {
+	// Returns a smooth random pattern blending the colors \b a and \b b
+	ptr_texture_t makeProceduralTexture(Size size, const Vec3f& a, const Vec3f& b, qword seed)
+	{
+		CPCG32 rng(seed);
+		std::uniform_real_distribution<float> dist(0, 1);
+		Mat noise(size.height / 16, size.width / 16, CV_32FC1);
+		for (int y = 0; y < noise.rows; y++)
+			for (int x = 0; x < noise.cols; x++)
+				noise.at<float>(y, x) = dist(rng);
+		resize(noise, noise, size, 0, 0, INTER_CUBIC);
+
+		Mat img(size, CV_32FC3);
+		for (int y = 0; y < img.rows; y++)
+			for (int x = 0; x < img.cols; x++) {
+				float t = MIN(1.0f, MAX(0.0f, noise.at<float>(y, x)));
+				img.at<Vec3f>(y, x) = (1 - t) * a + t * b;
+			}
+		return std::make_shared<CTexture>(img);
+	}
+
+	// Returns the texture from the file or the procedural texture, if the file is absent
+	ptr_texture_t loadTexture(const std::string& fileName, const Vec3f& a, const Vec3f& b, qword seed, bool& procedural)
+	{
+		auto pTexture = std::make_shared<CTexture>(fileName);
+		if (!pTexture->empty()) return pTexture;
+		procedural = true;
+		return makeProceduralTexture(Size(2048, 1024), a, b, seed);
+	}
+}
+
+/**
+ * @brief Returns the canonical scenes of the regression runner
+ * @details
+ * - \a earth_moon: the Earth and the Moon of main.cpp, seen from the side camera. The textures are replaced by procedural ones, when the data files are absent
+ * - \a solids: many random spheres and cones on a ground quad, lit by two shadow-casting lights
+ * - \a mesh: a procedurally generated terrain of about 300 thousand triangles
+ * @return The scenes
+ */
+inline std::vector<RegressionScene> getRegressionScenes(void)
+{
+	std::vector<RegressionScene> res;
+
+	res.push_back({ "earth_moon", [](CScene& scene, Size resolution, const std::string& dataPath) {
+		scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(150000 - 11, 3, 250), Vec3f(0, 0, -1), Vec3f(0, 1, 0), 3.5f));
+		scene.add(std::make_shared<CLightOmni>(Vec3f::all(3e10), Vec3f(0, 0, 0), false));
+		bool procedural = false;
+		auto pEarth = loadTexture(dataPath + "earth_8k.jpg", RGB(0.08f, 0.16f, 0.47f), RGB(0.24f, 0.47f, 0.16f), 1, procedural);
+		auto pMoon = loadTexture(dataPath + "moon_8k.jpg", RGB(0.35f, 0.35f, 0.35f), RGB(0.8f, 0.8f, 0.8f), 2, procedural);
+		scene.add(CSolidSphere(makeShaderPhong(scene, pEarth, 0.1f, 0.9f, 0.0f, 40.0f), Vec3f(150000, 0, 0), 6.371f, 32));
+		scene.add(CSolidSphere(makeShaderPhong(scene, pMoon, 0.1f, 0.9f, 0.0f, 40.0f), Vec3f(150000, 0, -384), 1.737f, 32));
+		return std::string(procedural ? "procedural" : "data");
+	} });
+
+	res.push_back({ "solids", [](CScene& scene, Size resolution, const std::string&) {
+		scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(0, 18, -32), normalize(Vec3f(0, -0.5f, 1)), Vec3f(0, 1, 0), 60.0f));
+		scene.add(std::make_shared<CLightOmni>(Vec3f::all(900), Vec3f(12, 30, -18)));
+		scene.add(std::make_shared<CLightOmni>(Vec3f::all(300), Vec3f(-20, 15, -10)));
+		scene.add(CSolidQuad(makeShaderPhong(scene, RGB(0.7f, 0.7f, 0.7f), 0.1f, 0.9f, 0.0f, 0.0f), Vec3f(-30, 0, -30), Vec3f(-30, 0, 30), Vec3f(30, 0, 30), Vec3f(30, 0, -30)));
+		CPCG32 rng(3);
+		std::uniform_real_distribution<float> pos(-15, 15);
+		std::uniform_real_distribution<float> size(0.3f, 1.2f);
+		std::uniform_real_distribution<float> color(0.2f, 1.0f);
+		for (int i = 0; i < 300; i++) {
+			auto pShader = makeShaderPhong(scene, Vec3f(color(rng), color(rng), color(rng)), 0.1f, 0.6f, 0.3f, 20.0f);
+			const Vec3f origin(pos(rng), 0, pos(rng));
+			const float r = size(rng);
+			if (i % 2) scene.add(CSolidSphere(pShader, origin + Vec3f(0, r, 0), r, 16));
+			else scene.add(CSolidCone(pShader, origin, r, 2.5f * r, 16));
+		}
+		return std::string("procedural");
+	} });
+
+	res.push_back({ "mesh", [](CScene& scene, Size resolution, const std::string&) {
+		scene.add(std::make_shared<CCameraPerspective>(resolution, Vec3f(0, 30, -60), normalize(Vec3f(0, -0.45f, 1)), Vec3f(0, 1, 0), 50.0f));
+		scene.add(std::make_shared<CLightOmni>(Vec3f::all(8000), Vec3f(40, 80, -40)));
+		auto pShader = makeShaderPhong(scene, RGB(0.47f, 0.63f, 0.35f), 0.1f, 0.9f, 0.0f, 0.0f);
+
+		// terrain: a sum of waves with random phases on a regular grid
+		const int n = 384;
+		const float extent = 50;
+		CPCG32 rng(4);
+		std::uniform_real_distribution<float> phase(0, 2 * Pif);
+		std::vector<Vec3f> vWaves(6);
+		for (size_t w = 0; w < vWaves.size(); w++) vWaves[w] = Vec3f(phase(rng), phase(rng), 0.25f * (w + 1));
+		auto height = [&](float x, float z) {
+			float res = 0;
+			for (const Vec3f& wave : vWaves)
+				res += 4 * sinf(wave.val[2] * x + wave.val[0]) * cosf(wave.val[2] * z + wave.val[1]) / (1 + 2 * wave.val[2]);
+			return res;
+		};
+		std::vector<Vec3f> vVertices((n + 1) * (n + 1));
+		for (int j = 0; j <= n; j++)
+			for (int i = 0; i <= n; i++) {
+				float x = extent * (2.0f * i / n - 1);
+				float z = extent * (2.0f * j / n - 1);
+				vVertices[j * (n + 1) + i] = Vec3f(x, height(x, z), z);
+			}
+		for (int j = 0; j < n; j++)
+			for (int i = 0; i < n; i++) {
+				const Vec3f& a = vVertices[j * (n + 1) + i];
+				const Vec3f& b = vVertices[j * (n + 1) + i + 1];
+				const Vec3f& c = vVertices[(j + 1) * (n + 1) + i + 1];
+				const Vec3f& d = vVertices[(j + 1) * (n + 1) + i];
+				scene.add(std::make_shared<CPrimTriangle>(pShader, a, b, c));
+				scene.add(std::make_shared<CPrimTriangle>(pShader, a, c, d));
+			}
+		return std::string("procedural");
+	} });
+
+	return res;
+}
@@ -0,0 +1,309 @@
+// End-to-end performance regression runner
+#include "Scenes.h"
+#include "RenderEngine.h"
+#include "RayStats.h"
+#include <algorithm>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/// Exit codes of the runner
+enum ExitCode {
+	EXIT_OK = 0,			///< All the scenes are within the tolerances of the baseline (or the baseline was recorded)
+	EXIT_USAGE = 1,			///< Invalid command-line arguments
+	EXIT_IO = 2,			///< A file could not be read or written
+	EXIT_REGRESSION = 3		///< At least one scene regressed
+};
+
+/// Relative and absolute tolerances of the comparison with the baseline
+struct Tolerances {
+	double	time	= 0.15;		///< Maximal relative increase of the build and render times
+	double	mrays	= 0.15;		///< Maximal relative decrease of the ray throughput
+	double	memory	= 0.25;		///< Maximal relative increase of the peak memory
+	double	rmse	= 0.01;		///< Maximal root mean square difference to the reference image (the colors are in [0; 1])
+};
+
+/// Measurements of a scene
+struct Result {
+	std::string	name;					///< The name of the scene
+	std::string	variant;				///< The variant of the scene (see RegressionScene::build)
+	size_t		nPrims		= 0;		///< The number of primitives
+	double		build		= 0;		///< The time of building the acceleration structure in milliseconds
+	double		render		= 0;		///< The fastest render time in milliseconds
+	double		mrays		= 0;		///< The ray throughput of the fastest render in millions of rays per second
+	double		peak		= 0;		///< The peak resident memory in megabytes (0 - not measured)
+	double		rmse		= -1;		///< The difference to the reference image (negative - not compared)
+	bool		passed		= true;		///< False if any measurement is out of the tolerances
+	Mat			img;					///< The rendered 8-bit image
+};
+
+static double elapsed(int64 ticks) { return 1000.0 * (getTickCount() - ticks) / getTickFrequency(); }
+
+// Resets the peak resident memory of the process, so that getPeakMemory() measures the following scene only (Linux only)
+static void resetPeakMemory(void)
+{
+#ifdef __linux__
+	FILE* pFile = fopen("/proc/self/clear_refs", "w");
+	if (pFile) {
+		fputs("5", pFile);
+		fclose(pFile);
+	}
+#endif
+}
+
+// Returns the peak resident memory of the process in megabytes (0 - not available)
+static double getPeakMemory(void)
+{
+#ifdef __linux__
+	FILE* pFile = fopen("/proc/self/status", "r");
+	if (pFile) {
+		char line[256];
+		double res = 0;
+		while (fgets(line, sizeof(line), pFile))
+			if (sscanf(line, "VmHWM: %lf kB", &res) == 1) break;
+		fclose(pFile);
+		if (res > 0) return res / 1024;
+	}
+#endif
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+		return usage.ru_maxrss / (1024.0 * 1024.0);		// in bytes
+#else
+		return usage.ru_maxrss / 1024.0;				// in kilobytes
+#endif
+	}
+#endif
+	return 0;
+}
+
+// Builds and renders the scene \b repeat times and measures it
+static Result runScene(const RegressionScene& regressionScene, Size resolution, size_t nThreads, size_t repeat, const std::string& dataPath)
+{
+	Result res;
+	res.name = regressionScene.name;
+	resetPeakMemory();
+
+	CScene scene(RGB(0, 0, 0));
+	res.variant = regressionScene.build(scene, resolution, dataPath);
+	int64 ticks = getTickCount();
+	scene.buildAccelStructure(20, 3);
+	res.build = elapsed(ticks);
+	res.nPrims = scene.getPrims().size();
+
+	CRenderEngine engine(scene, nThreads);
+	Mat img(resolution, CV_32FC3);
+	for (size_t r = 0; r < repeat; r++) {
+		CRayStats::Counters before = CRayStats::instance().collect();
+		ticks = getTickCount();
+		engine.render(img);
+		double ms = elapsed(ticks);
+		if (r == 0 || ms < res.render) {
+			res.render = ms;
+			res.mrays = (CRayStats::instance().collect() - before).getMrays(ms);
+		}
+	}
+	res.peak = getPeakMemory();
+	img.convertTo(res.img, CV_8UC3, 255);
+	return res;
+}
+
+// Compares the measurement with the baseline, prints the row of the table and returns false, if the tolerance is exceeded
+static bool compare(const std::string& scene, const char* metric, double baseline, double current, double tolerance, bool lowerIsBetter)
+{
+	double change = baseline > 0 ? (current - baseline) / baseline : 0;
+	bool res = baseline <= 0 || (lowerIsBetter ? change <= tolerance : change >= -tolerance);
+	bool improved = baseline > 0 && (lowerIsBetter ? change < -tolerance : change > tolerance);
+	printf("%-12s %-10s %12.2f %12.2f %+9.1f%%  %s\n", scene.c_str(), metric, baseline, current, 100 * change, res ? (improved ? "improved" : "ok") : "REGRESSED");
+	return res;
+}
+
+// Reads the measurements of a scene from its node in the baseline
+static Result readResult(const FileNode& node)
+{
+	Result res;
+	res.name	= node.name();
+	res.variant	= static_cast<std::string>(node["variant"]);
+	res.nPrims	= static_cast<size_t>(static_cast<int>(node["primitives"]));
+	res.build	= static_cast<double>(node["build_ms"]);
+	res.render	= static_cast<double>(node["render_ms"]);
+	res.mrays	= static_cast<double>(node["mrays"]);
+	res.peak	= static_cast<double>(node["peak_mb"]);
+	if (!node["rmse"].empty()) res.rmse = static_cast<double>(node["rmse"]);
+	if (!node["passed"].empty()) res.passed = static_cast<int>(node["passed"]) != 0;
+	return res;
+}
+
+// Writes the resolution, the tolerances and the measurements as JSON, which may be read back as the baseline
+static bool writeJson(const std::string& fileName, Size resolution, size_t nThreads, const Tolerances& tolerances, const std::vector<Result>& vResults)
+{
+	FILE* pFile = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+	if (!pFile) return false;
+	fprintf(pFile, "{\n");
+	fprintf(pFile, "  \"resolution\": [%d, %d],\n", resolution.width, resolution.height);
+	fprintf(pFile, "  \"threads\": %zu,\n", nThreads);
+	fprintf(pFile, "  \"tolerances\": {\"time\": %.3f, \"mrays\": %.3f, \"memory\": %.3f, \"rmse\": %.4f},\n", tolerances.time, tolerances.mrays, tolerances.memory, tolerances.rmse);
+	fprintf(pFile, "  \"scenes\": {");
+	for (size_t i = 0; i < vResults.size(); i++) {
+		const Result& res = vResults[i];
+		fprintf(pFile, "%s\n    \"%s\": {\"variant\": \"%s\", \"primitives\": %zu, \"build_ms\": %.3f, \"render_ms\": %.3f, \"mrays\": %.4f, \"peak_mb\": %.2f",
+			i ? "," : "", res.name.c_str(), res.variant.c_str(), res.nPrims, res.build, res.render, res.mrays, res.peak);
+		if (res.rmse >= 0) fprintf(pFile, ", \"rmse\": %.6f", res.rmse);
+		fprintf(pFile, ", \"passed\": %s}", res.passed ? "true" : "false");
+	}
+	fprintf(pFile, "\n  }\n}\n");
+	if (pFile != stdout) fclose(pFile);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string keys =
+		"{help ?      |              | Print this message}"
+		"{baseline    | baseline     | Folder of the baseline: baseline.json and the reference images <scene>.png}"
+		"{update      |              | Record the measurements and the images of the run scenes as the new baseline}"
+		"{scene       |              | Run only the scenes, whose names contain this string}"
+		"{threads     | 0            | Number of render threads (0 - all hardware threads)}"
+		"{repeat      | 3            | Number of renders per scene, the fastest one is reported}"
+		"{data        |              | Path to the data folder}"
+		"{json        | regress.json | File name of the JSON results (- for the standard output, empty - do not write)}";
+	CommandLineParser parser(argc, argv, keys);
+	parser.about("eyden-regress");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return EXIT_OK;
+	}
+	const Size resolution(640, 360);											// fixed, so that the measurements are comparable
+	std::string baselinePath	= parser.get<std::string>("baseline");
+	const std::string filter	= parser.get<std::string>("scene");
+	const size_t nThreads		= static_cast<size_t>(MAX(0, parser.get<int>("threads")));
+	const size_t repeat			= static_cast<size_t>(MAX(1, parser.get<int>("repeat")));
+	std::string dataPath		= parser.get<std::string>("data");
+	const std::string json		= parser.get<std::string>("json");
+	if (!parser.check() || baselinePath.empty()) {
+		parser.printErrors();
+		fprintf(stderr, "ERROR: Invalid arguments, see --help\n");
+		return EXIT_USAGE;
+	}
+	if (dataPath.empty())
+#ifdef WIN32
+		dataPath = "../data/";
+#else
+		dataPath = "../../../data/";
+#endif
+	if (dataPath.back() != '/' && dataPath.back() != '\\') dataPath += "/";
+	if (baselinePath.back() != '/' && baselinePath.back() != '\\') baselinePath += "/";
+
+	// the baseline is recorded, if it does not exist yet; an existing one is read also for --update, which keeps its tolerances and the other scenes
+	const std::string baselineFile = baselinePath + "baseline.json";
+	FileStorage baseline;
+	bool update = parser.has("update");
+	FILE* pFile = fopen(baselineFile.c_str(), "r");
+	if (pFile) fclose(pFile);
+	if (!pFile) {
+		if (!update) printf("No baseline %s, recording it\n", baselineFile.c_str());
+		update = true;
+	}
+	else if (!baseline.open(baselineFile, FileStorage::READ | FileStorage::FORMAT_JSON)) {
+		fprintf(stderr, "ERROR: Can't read file %s\n", baselineFile.c_str());
+		return EXIT_IO;
+	}
+
+	Tolerances tolerances;
+	bool keepScenes = baseline.isOpened();		// the scenes of the baseline, which are not run, are kept by --update
+	if (baseline.isOpened()) {
+		FileNode node = baseline["tolerances"];
+		if (!node["time"].empty()) tolerances.time = static_cast<double>(node["time"]);
+		if (!node["mrays"].empty()) tolerances.mrays = static_cast<double>(node["mrays"]);
+		if (!node["memory"].empty()) tolerances.memory = static_cast<double>(node["memory"]);
+		if (!node["rmse"].empty()) tolerances.rmse = static_cast<double>(node["rmse"]);
+		FileNode size = baseline["resolution"];
+		if (size.size() == 2 && (static_cast<int>(size[0]) != resolution.width || static_cast<int>(size[1]) != resolution.height)) {
+			if (!update) {
+				fprintf(stderr, "ERROR: The baseline was recorded at %dx%d, record it again with --update\n", static_cast<int>(size[0]), static_cast<int>(size[1]));
+				return EXIT_USAGE;
+			}
+			printf("WARNING: The baseline was recorded at %dx%d, its scenes, which are not run, are dropped\n", static_cast<int>(size[0]), static_cast<int>(size[1]));
+			keepScenes = false;
+		}
+		if (!update && !baseline["threads"].empty() && static_cast<size_t>(static_cast<int>(baseline["threads"])) != nThreads)
+			printf("WARNING: The baseline was recorded with --threads=%d\n", static_cast<int>(baseline["threads"]));
+	}
+
+	std::error_code error;
+	if (update) std::filesystem::create_directories(baselinePath, error);
+
+	std::vector<Result> vResults;
+	int status = EXIT_OK;
+	if (!update) printf("%-12s %-10s %12s %12s %10s  %s\n", "scene", "metric", "baseline", "current", "change", "status");
+	for (const RegressionScene& regressionScene : getRegressionScenes()) {
+		if (!filter.empty() && regressionScene.name.find(filter) == std::string::npos) continue;
+		Result res = runScene(regressionScene, resolution, nThreads, repeat, dataPath);
+		if (update) {
+			printf("%-12s %s, %zu primitives: build %.2f ms, render %.2f ms, %.2f Mrays/s, peak %.1f MB\n", res.name.c_str(), res.variant.c_str(), res.nPrims, res.build, res.render, res.mrays, res.peak);
+			const std::string fileName = baselinePath + res.name + ".png";
+			if (!imwrite(fileName, res.img)) {
+				fprintf(stderr, "ERROR: Can't write file %s\n", fileName.c_str());
+				return EXIT_IO;
+			}
+			vResults.push_back(res);
+			continue;
+		}
+
+		FileNode node = baseline["scenes"][res.name];
+		if (node.empty()) {
+			printf("%-12s not in the baseline, record it with --update\n", res.name.c_str());
+			vResults.push_back(res);
+			continue;
+		}
+		res.passed &= compare(res.name, "build_ms", static_cast<double>(node["build_ms"]), res.build, tolerances.time, true);
+		res.passed &= compare(res.name, "render_ms", static_cast<double>(node["render_ms"]), res.render, tolerances.time, true);
+		res.passed &= compare(res.name, "mrays", static_cast<double>(node["mrays"]), res.mrays, tolerances.mrays, false);
+		if (res.peak > 0) res.passed &= compare(res.name, "peak_mb", static_cast<double>(node["peak_mb"]), res.peak, tolerances.memory, true);
+
+		// the image is compared only with the reference of the same variant, e.g. not the procedural textures with the data files
+		Mat ref = imread(baselinePath + res.name + ".png");
+		if (static_cast<std::string>(node["variant"]) != res.variant)
+			printf("%-12s %-10s %38s  skipped (%s, the baseline is %s)\n", res.name.c_str(), "rmse", "", res.variant.c_str(), static_cast<std::string>(node["variant"]).c_str());
+		else if (ref.empty() || ref.size() != res.img.size() || ref.type() != res.img.type())
+			printf("%-12s %-10s %38s  skipped (no reference image)\n", res.name.c_str(), "rmse", "");
+		else {
+			res.rmse = norm(res.img, ref, NORM_L2) / (255 * sqrt(static_cast<double>(res.img.total() * res.img.channels())));
+			bool passed = res.rmse <= tolerances.rmse;
+			printf("%-12s %-10s %12.4f %12.4f %10s  %s\n", res.name.c_str(), "rmse", tolerances.rmse, res.rmse, "", passed ? "ok" : "REGRESSED");
+			res.passed &= passed;
+		}
+		if (!res.passed) status = EXIT_REGRESSION;
+		vResults.push_back(res);
+	}
+
+	if (update) {
+		// the run scenes replace their entries in place, the other entries of the baseline are kept, the new scenes are appended
+		std::vector<Result> vBaseline;
+		std::vector<bool> vStored(vResults.size(), false);
+		if (keepScenes)
+			for (const FileNode& node : baseline["scenes"]) {
+				auto it = std::find_if(vResults.begin(), vResults.end(), [&node](const Result& res) { return res.name == node.name(); });
+				if (it == vResults.end()) vBaseline.push_back(readResult(node));
+				else {
+					vBaseline.push_back(*it);
+					vStored[it - vResults.begin()] = true;
+				}
+			}
+		for (size_t i = 0; i < vResults.size(); i++)
+			if (!vStored[i]) vBaseline.push_back(vResults[i]);
+		if (!writeJson(baselineFile, resolution, nThreads, tolerances, vBaseline)) {
+			fprintf(stderr, "ERROR: Can't write file %s\n", baselineFile.c_str());
+			return EXIT_IO;
+		}
+	}
+	if (!json.empty() && !writeJson(json, resolution, nThreads, tolerances, vResults)) {
+		fprintf(stderr, "ERROR: Can't write file %s\n", json.c_str());
+		if (status == EXIT_OK) status = EXIT_IO;
+	}
+	if (status == EXIT_REGRESSION) fprintf(stderr, "ERROR: Performance or image regression, see above\n");
+	return status;
+}
@@ -0,0 +1,203 @@
+// Animation class
+#pragma once
+
+#include "Scene.h"
+#include "LightOmni.h"
+#include "RenderEngine.h"
+#include <deque>
+#include <unordered_map>
+
+// ================================ Animation Class ================================
+/**
+ * @brief Animation class
+ * @details This class describes the state of the scene in every frame as a function of the frame index: the transformations of the solids,
+ * the positions of the point light sources and the camera. Instead of modifying the scene in place after every frame, it builds an immutable
+ * snapshot of the scene for every frame (see snapshot()). The snapshots share all the unchanged primitives, lights, shaders and textures
+ * with the original scene; only the animated primitives and lights are copied. Thus, several frames may be built and rendered at the same
+ * time (see render()), which keeps all the cores busy even if a single frame is too small to be split efficiently.
+ * @code
+ * CAnimation animation(scene);
+ * animation.animate(earth, [](size_t frame) { return CTransform().rotate(Vec3f(0, 1, 0), frame * 2.0f).get(); });
+ * animation.animate(sun, [](size_t frame) { return Vec3f(0, 0, frame * 10.0f); });
+ * animation.render(0, 180, 4, 0, [&](size_t frame, const Mat& img) { frameWriter.push(img, frame); });
+ * @endcode
+ * @note The shaders query the lights and the occluders of the scene, which is being rendered (see CScene::activate())
+ */
+class CAnimation
+{
+public:
+	/// Function returning the transformation matrix (size: 4 x 4; type: CV_32FC1) for the given frame
+	using transform_fn_t	= std::function<Mat(size_t)>;
+	/// Function returning the position for the given frame
+	using position_fn_t		= std::function<Vec3f(size_t)>;
+	/// Function returning the camera for the given frame
+	using camera_fn_t		= std::function<ptr_camera_t(size_t)>;
+
+	/**
+	 * @brief Constructor
+	 * @param scene The scene with the geometry, the lights and the cameras in their initial state
+	 */
+	CAnimation(CScene& scene) : m_scene(scene) {}
+	CAnimation(const CAnimation&) = delete;
+	~CAnimation(void) = default;
+	const CAnimation& operator=(const CAnimation&) = delete;
+
+	/**
+	 * @brief Animates the solid \b solid
+	 * @param solid The solid, which is part of the scene. It must not be destroyed before the animation
+	 * @param fnTransform The function returning the transformation of the solid from its initial state in the given frame.
+	 * The transformation is applied relative to the pivot point of the solid (see CSolid::transform())
+	 */
+	void animate(const CSolid& solid, transform_fn_t fnTransform) { m_vSolids.emplace_back(&solid, fnTransform); }
+	/**
+	 * @brief Animates the point light source \b pLight
+	 * @param pLight Pointer to the light source, which is part of the scene
+	 * @param fnOrigin The function returning the position of the light source in the given frame
+	 */
+	void animate(const std::shared_ptr<CLightOmni>& pLight, position_fn_t fnOrigin) { m_vLights.emplace_back(pLight, fnOrigin); }
+	/**
+	 * @brief Animates the active camera
+	 * @param fnCamera The function returning the camera in the given frame, e.g. a new perspective camera with the frame's position and direction
+	 */
+	void animateCamera(camera_fn_t fnCamera) { m_fnCamera = fnCamera; }
+	/**
+	 * @brief Sets the parameters of the acceleration structures of the snapshots
+	 * @param maxDepth The maximum allowed depth of the tree
+	 * @param minPrimitives The minimum number of primitives in a leaf-node
+	 */
+	void setAccelStructure(size_t maxDepth, size_t minPrimitives)
+	{
+		m_maxDepth = maxDepth;
+		m_minPrimitives = minPrimitives;
+	}
+
+	/**
+	 * @brief Builds the snapshot of the scene for the frame \b frame
+	 * @details The acceleration structure of the snapshot is built too. The scene itself is not modified, thus the snapshots of
+	 * different frames may be built concurrently
+	 * @param frame The frame index
+	 * @return Pointer to the snapshot
+	 */
+	std::shared_ptr<CScene> snapshot(size_t frame) const
+	{
+		auto pSnapshot = std::make_shared<CScene>(m_scene.getBackgroundColor());
+		snapshot(frame, *pSnapshot);
+		return pSnapshot;
+	}
+	/**
+	 * @brief Builds the snapshot of the scene for the frame \b frame into the scene \b target
+	 * @details The previous content of \b target is removed (see CScene::clear()), but its acceleration structure keeps the arenas.
+	 * Thus, the same target re-used for a sequence of frames builds the BSP trees without allocations
+	 * @param frame The frame index
+	 * @param target The scene receiving the snapshot, which is not being rendered
+	 */
+	void snapshot(size_t frame, CScene& target) const
+	{
+		PROFILE_ZONE("snapshot");
+		target.clear();
+
+		// geometry: the primitives of the animated solids are copied and transformed, the others are shared
+		// the translation back to the pivot is applied separately, since the combined matrix would lose precision far from the origin
+		std::unordered_map<const IPrim*, std::pair<Mat, Mat>> mTransforms;
+		for (auto& [pSolid, fnTransform] : m_vSolids) {
+			CTransform tr;
+			Mat T1 = tr.translate(-pSolid->getPivot()).get();
+			Mat T2 = tr.translate(pSolid->getPivot()).get();
+			Mat t = fnTransform(frame) * T1;
+			for (auto& pPrim : pSolid->getPrims())
+				mTransforms[pPrim.get()] = std::make_pair(t, T2);
+		}
+		for (auto& pPrim : m_scene.getPrims()) {
+			auto it = mTransforms.find(pPrim.get());
+			if (it == mTransforms.end()) target.add(pPrim);
+			else {
+				ptr_prim_t pCopy = pPrim->clone();
+				pCopy->transform(it->second.first);
+				pCopy->transform(it->second.second);
+				target.add(pCopy);
+			}
+		}
+
+		// lights: the animated light sources are copied
+		for (auto& pLight : m_scene.getLights()) {
+			auto it = std::find_if(m_vLights.begin(), m_vLights.end(), [&pLight](const auto& light) { return light.first == pLight; });
+			if (it == m_vLights.end()) target.add(pLight);
+			else target.add(std::make_shared<CLightOmni>(it->first->getIntensity(), it->second(frame), it->first->shadow()));
+		}
+		auto [threshold, nSamples] = m_scene.getLightSampling();
+		target.setLightSampling(threshold, nSamples);
+
+		// cameras
+		for (size_t c = 0; c < m_scene.getCameras().size(); c++)
+			target.add(m_fnCamera && c == m_scene.getActiveCameraIndex() ? m_fnCamera(frame) : m_scene.getCameras()[c]);
+		target.setActiveCamera(m_scene.getActiveCameraIndex());
+
+		target.buildAccelStructure(m_maxDepth, m_minPrimitives);
+	}
+	/**
+	 * @brief Renders the frames concurrently
+	 * @details Up to \b nConcurrent frames are built and rendered at the same time, each by its own @ref CRenderEngine with
+	 * \b nThreads / \b nConcurrent threads. Every engine keeps its snapshot scene, which is re-filled for each of its frames, so that
+	 * the arenas of the BSP trees are re-used. The rendered frames are passed to the callback function in the frame order.
+	 * @param firstFrame The index of the first frame
+	 * @param nFrames The number of frames
+	 * @param nConcurrent The number of frames rendered at the same time
+	 * @param nThreads The total number of render threads. If zero, the number of concurrent threads supported by the hardware is used
+	 * @param fnFrame The callback function fnFrame(size_t frame, const Mat& img), receiving the rendered frames (type: CV_32FC3).
+	 * It is called from the calling thread, while the next frames are being rendered
+	 * @param fnConfigure Optional function configuring the render engines, e.g. for the anti-aliasing
+	 */
+	void render(size_t firstFrame, size_t nFrames, size_t nConcurrent, size_t nThreads,
+		const std::function<void(size_t, const Mat&)>& fnFrame, const std::function<void(CRenderEngine&)>& fnConfigure = nullptr)
+	{
+		if (nThreads == 0) nThreads = MAX(1, std::thread::hardware_concurrency());
+		nConcurrent = MAX(1, MIN(nConcurrent, nFrames));
+		std::vector<std::unique_ptr<CRenderEngine>> vpEngines;
+		std::vector<std::unique_ptr<CScene>> vpSnapshots;
+		for (size_t k = 0; k < nConcurrent; k++) {
+			vpEngines.push_back(std::make_unique<CRenderEngine>(m_scene, MAX(1, nThreads / nConcurrent)));
+			vpSnapshots.push_back(std::make_unique<CScene>(m_scene.getBackgroundColor()));
+			vpSnapshots.back()->setBudgetShare(nConcurrent);				// the trees of the concurrent frames split the budgets
+			if (fnConfigure) fnConfigure(*vpEngines.back());
+		}
+
+		// frame f is rendered by the engine f % nConcurrent with its snapshot, which are free since frame f - nConcurrent was collected
+		CThreadPool pool(nConcurrent);
+		auto launch = [&](size_t frame) {
+			CRenderEngine* pEngine = vpEngines[frame % nConcurrent].get();
+			CScene* pSnapshot = vpSnapshots[frame % nConcurrent].get();
+			return pool.enqueue([this, pEngine, pSnapshot, frame] {
+				snapshot(frame, *pSnapshot);
+				pEngine->setFrame(static_cast<dword>(frame));		// the samplers are seeded with the absolute frame index
+				Mat img(pSnapshot->getActiveCamera()->getResolution(), CV_32FC3, Scalar::all(0));
+				pEngine->render(img, *pSnapshot);
+				pSnapshot->clear();				// the copied primitives are freed, the arenas of the BSP tree are kept
+				return img;
+			});
+		};
+
+		const size_t endFrame = firstFrame + nFrames;
+		size_t next = firstFrame;
+		std::deque<std::future<Mat>> qFrames;
+		while (next < endFrame && qFrames.size() < nConcurrent)
+			qFrames.push_back(launch(next++));
+		for (size_t frame = firstFrame; frame < endFrame; frame++) {
+			Mat img = qFrames.front().get();
+			qFrames.pop_front();
+			if (next < endFrame) qFrames.push_back(launch(next++));
+			fnFrame(frame, img);
+		}
+	}
+
+
+private:
+	using solid_t = std::pair<const CSolid*, transform_fn_t>;
+	using light_t = std::pair<std::shared_ptr<CLightOmni>, position_fn_t>;
+
+	CScene&					m_scene;				///< The scene in its initial state
+	std::vector<solid_t>	m_vSolids;				///< The animated solids
+	std::vector<light_t>	m_vLights;				///< The animated light sources
+	camera_fn_t				m_fnCamera;				///< The camera animation
+	size_t					m_maxDepth = 20;		///< The maximum depth of the BSP trees of the snapshots
+	size_t					m_minPrimitives = 3;	///< The minimum number of primitives in the BSP leafs of the snapshots
+};
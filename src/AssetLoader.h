@@ -0,0 +1,82 @@
+// Asynchronous Asset Loader class
+#pragma once
+
+#include "ThreadPool.h"
+#include "Texture.h"
+#include "Solid.h"
+#include "Profiler.h"
+
+// ================================ Asset Loader Class ================================
+/**
+ * @brief Asynchronous asset loader class
+ * @details This class decodes textures and parses / generates meshes concurrently on its own thread pool.
+ * All the methods return immediately with a future object, which may be passed directly to the shaders and to the scene.
+ * These resolve the futures lazily, i.e. at the moment the asset is needed for the first time. This way the texture decoding
+ * is overlapped with the geometry construction and the acceleration structure build.
+ * @code
+ * CAssetLoader loader;
+ * auto pShader = std::make_shared<CShaderPhong>(scene, loader.loadTexture("earth_8k.jpg"), 0.1f, 0.9f, 0.0f, 40.0f);
+ * scene.add(loader.loadSolid(pShader, "earth.obj"));
+ * scene.buildAccelStructure(20, 3);	// waits only for the meshes, the texture is still being decoded
+ * @endcode
+ */
+class CAssetLoader
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param nThreads The number of loader threads. If zero, the number of concurrent threads supported by the hardware is used
+	 */
+	CAssetLoader(size_t nThreads = 0) : m_pool(nThreads) {}
+	CAssetLoader(const CAssetLoader&) = delete;
+	~CAssetLoader(void) = default;
+	const CAssetLoader& operator=(const CAssetLoader&) = delete;
+
+	/**
+	 * @brief Starts loading of the texture from file \b fileName
+	 * @details The image is decoded and converted to the internal floating-point format in a loader thread.
+	 * If the file can not be read, the resulting texture is empty (and thus generates a chess pattern)
+	 * @param fileName The path to the texture file
+	 * @return The future holding the pointer to the texture
+	 */
+	future_texture_t loadTexture(const std::string& fileName)
+	{
+		return m_pool.enqueue([fileName] {
+			PROFILE_ZONE("asset load");
+			Mat img = imread(fileName);
+			if (img.empty()) printf("ERROR: Texture file %s is not found!\n", fileName.c_str());
+			return std::make_shared<CTexture>(img);
+		}).share();
+	}
+	/**
+	 * @brief Starts parsing of the .obj file \b fileName
+	 * @param pShader Pointer to the shader to be used with the parsed object
+	 * @param fileName The full path to the .obj file
+	 * @return The future holding the pointer to the solid
+	 */
+	std::shared_future<ptr_solid_t> loadSolid(ptr_shader_t pShader, const std::string& fileName)
+	{
+		return m_pool.enqueue([pShader, fileName] {
+			PROFILE_ZONE("asset load");
+			return std::make_shared<CSolid>(pShader, fileName);
+		}).share();
+	}
+	/**
+	 * @brief Starts generation of a procedural solid
+	 * @tparam TSolid The type of the solid, e.g. \ref CSolidSphere or \ref CSolidCone
+	 * @param args The arguments to be passed to the constructor of the solid
+	 * @return The future holding the pointer to the solid
+	 */
+	template <typename TSolid, typename... Args>
+	std::shared_future<ptr_solid_t> makeSolid(Args... args)
+	{
+		return m_pool.enqueue([args...]() -> ptr_solid_t {
+			PROFILE_ZONE("asset load");
+			return std::make_shared<TSolid>(args...);
+		}).share();
+	}
+
+
+private:
+	CThreadPool m_pool;		///< The loader threads
+};
@@ -3,123 +3,80 @@
 #pragma once
 
 #include "types.h"
-#include "ray.h"
-
-class CBSPNode;
-using ptr_bspnode_t = std::shared_ptr<CBSPNode>;
 
 // ================================ BSP Node Class ================================
 /**
  * @brief Binary Space Partitioning (BSP) node class
+ * @details The nodes live in the node arena of @ref CBSPTree and refer to each other and to the primitives by indices:
+ * the two children of a branch node are adjacent in the arena, and a leaf node refers to a range of the leaf primitives of the tree.
+ * Thus a node occupies 16 bytes without any pointer or reference counter
  */
 class CBSPNode
 {
 public:
+	CBSPNode(void) = default;
 	/**
 	 * @brief Leaf node constructor
-	 * @param vpPrims The vector of pointers to the primitives included in the leaf node
+	 * @param first The index of the first primitive of the leaf in the leaf primitives of the tree
+	 * @param nPrims The number of primitives in the leaf
 	 */
-	CBSPNode(const std::vector<ptr_prim_t>& vpPrims)
-		: CBSPNode(vpPrims, 0, 0, nullptr, nullptr)
+	CBSPNode(size_t first, size_t nPrims)
+		: m_splitDim(LeafDim)
+		, m_first(static_cast<dword>(first))
+		, m_nPrims(static_cast<dword>(nPrims))
 	{}
 	/**
 	 * @brief Branch node constructor
 	 * @param splitDim The splitting dimension
 	 * @param splitVal The splitting value
-	 * @param left Pointer to the left sub-tree
-	 * @param right Pointer to the right sub-tree
+	 * @param left The index of the left child in the node arena; the right child follows it
 	 */
-	CBSPNode(int splitDim, float splitVal, ptr_bspnode_t left, ptr_bspnode_t right)
-		: CBSPNode(std::nullopt, splitDim, splitVal, left, right)
+	CBSPNode(int splitDim, float splitVal, size_t left)
+		: m_splitDim(static_cast<dword>(splitDim))
+		, m_splitVal(splitVal)
+		, m_first(static_cast<dword>(left))
 	{}
-	CBSPNode(const CBSPNode&) = delete;
-	virtual ~CBSPNode(void) = default;
-	const CBSPNode& operator=(const CBSPNode&) = delete;
+	~CBSPNode(void) = default;
 
 	/**
-	 * @brief Traverses the ray \b ray and checks for intersection with a primitive
-	 * @details If the intersection is found, \b ray.t is updated
-	 * @param[in,out] ray The ray
-	 * @param[in] t0 The distance from ray origin at which the ray enters the scene
-	 * @param[in] t1 The distance from ray origin at which the ray leaves the scene
-	 * @retval true If ray \b ray intersects any object
-	 * @retval false otherwise
+	 * @brief Checks whether the node is either leaf or branch node
+	 * @retval true if the node is the leaf-node
+	 * @retval false if the node is a branch-node
 	 */
-	bool intersect(Ray& ray, double t0, double t1) const
-	{
-		if (isLeaf()) {
-			for (auto& pPrim : m_vpPrims)
-				pPrim->intersect(ray);
-			return (ray.hit && ray.t < t1 + Epsilon);
-		}
-		else {
-			// distnace from ray origin to the split plane of the current volume (may be negative)
-			double d = (m_splitVal - ray.org[m_splitDim]) / ray.dir[m_splitDim];
-
-			auto frontNode = (ray.dir[m_splitDim] < 0) ? Right() : Left();
-			auto backNode = (ray.dir[m_splitDim] < 0) ? Left() : Right();
-
-			if (d <= t0) {
-				// t0..t1 is totally behind d, only go to back side
-				return backNode->intersect(ray, t0, t1);
-			}
-			else if (d >= t1) {
-				// t0..t1 is totally in front of d, only go to front side
-				return frontNode->intersect(ray, t0, t1);
-			}
-			else {
-				// travese both children. front one first, back one last
-				if (frontNode->intersect(ray, t0, d))
-					return true;
-
-				return backNode->intersect(ray, d, t1);
-			}
-		}
-	}
-
+	bool isLeaf(void) const { return m_splitDim == LeafDim; }
 	/**
-	 * @brief Returns the pointer to the \a left child
-	 * @returns The pointer to the root-node of the \a left sub-tree
+	 * @brief Returns the splitting dimension of the branch node
 	 */
-	ptr_bspnode_t Left(void) const { return m_pLeft; }
+	int getSplitDim(void) const { return static_cast<int>(m_splitDim); }
 	/**
-	 * @brief Returns the pointer to the \a right child
-	 * @returns The pointer to the root-node of the \a right sub-tree
+	 * @brief Returns the splitting value of the branch node
 	 */
-	ptr_bspnode_t Right(void) const { return m_pRight; }
-
-	
-private:
+	float getSplitVal(void) const { return m_splitVal; }
 	/**
-	 * @brief Genereal private constructor
-	 * @details This constructor may contruct both types of the nodes (leaf and branch) and is to be called from public leaf- and branch-node contructors
-	 * @param vpPrims The vector of pointers to the primitives included in the leaf node
-	 * @param splitDim The splitting dimension
-	 * @param splitVal The splitting value
-	 * @param left Pointer to the left sub-tree
-	 * @param right Pointer to the right sub-tree
+	 * @brief Returns the index of the \a left child of the branch node
+	 * @returns The index of the root-node of the \a left sub-tree in the node arena
 	 */
-	CBSPNode(std::optional<std::vector<ptr_prim_t>> vpPrims, int splitDim, float splitVal, ptr_bspnode_t left, ptr_bspnode_t right)
-		: m_vpPrims(vpPrims.value_or(std::vector<ptr_prim_t>()))
-		, m_splitDim(splitDim)
-		, m_splitVal(splitVal)
-		, m_pLeft(left)
-		, m_pRight(right)
-	{}
-
+	size_t Left(void) const { return m_first; }
 	/**
-	 * @brief Checks whether the node is either leaf or branch node
-	 * @retval true if the node is the leaf-node
-	 * @retval false if the node is a branch-node
+	 * @brief Returns the index of the \a right child of the branch node
+	 * @returns The index of the root-node of the \a right sub-tree in the node arena
+	 */
+	size_t Right(void) const { return m_first + 1; }
+	/**
+	 * @brief Returns the index of the first primitive of the leaf node
 	 */
-	bool isLeaf(void) const { return (!m_pLeft && !m_pRight); }
-	
-	
+	size_t getFirstPrim(void) const { return m_first; }
+	/**
+	 * @brief Returns the number of primitives in the leaf node
+	 */
+	size_t getNumPrims(void) const { return m_nPrims; }
+
+
 private:
-	std::vector<ptr_prim_t>	m_vpPrims;		///< The vector of pointers to the primitives included in the leaf node
-	int 					m_splitDim;		///< The splitting dimension
-	float 					m_splitVal;		///< The splitting value
-	ptr_bspnode_t 	        m_pLeft;		///< Pointer to the left sub-tree
-	ptr_bspnode_t 	        m_pRight;		///< Pointer to the right sub-tree
-};
+	static constexpr dword LeafDim = 3;		///< The splitting dimension, which marks a leaf node
 
+	dword	m_splitDim	= LeafDim;			///< The splitting dimension
+	float	m_splitVal	= 0;				///< The splitting value
+	dword	m_first		= 0;				///< The index of the left child (branch nodes) or of the first primitive (leaf nodes)
+	dword	m_nPrims	= 0;				///< The number of primitives (leaf nodes)
+};
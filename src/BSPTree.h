@@ -1,20 +1,13 @@
 #pragma once
 
 #include "BSPNode.h"
+#include "MemoryStats.h"
 #include "BoundingBox.h"
+#include "RayStats.h"
 #include "IPrim.h"
 #include "ray.h"
 
 namespace {
-	// Calculates and return the bounding box, containing the whole scene
-	CBoundingBox calcBoundingBox(const std::vector<ptr_prim_t>& vpPrims)
-	{
-		CBoundingBox res;
-		for (auto pPrim : vpPrims)
-			res.extend(pPrim->getBoundingBox());
-		return res;
-	}
-
 	// Returns the best dimension index for next split
 	int MaxDim(const Vec3f& v)
 	{
@@ -25,13 +18,21 @@ namespace {
 // ================================ BSP Tree Class ================================
 /**
  * @brief Binary Space Partitioning (BSP) tree class
+ * @details The tree keeps the nodes (see @ref CBSPNode), the raw pointers of the leaf primitives and the build buffers in vectors, which
+ * are cleared, but not freed, by the next build. They act as arenas: a tree re-built every frame of an animation allocates only when the
+ * scene grows. The builder queries the bounding box of every primitive once, and splits the index ranges of the primitives on a stack
+ * instead of copying their shared pointers. The arenas are accounted in @ref CMemoryStats.
+ * @note The tree does not own the primitives: they must outlive the tree or its next build
  */
 class CBSPTree
 {
 public:
 	CBSPTree(void) = default;
 	CBSPTree(const CBSPTree&) = delete;
-	~CBSPTree(void) = default;
+	~CBSPTree(void)
+	{
+		release();
+	}
 	const CBSPTree& operator=(const CBSPTree&) = delete;
 	
 	/**
@@ -41,14 +42,37 @@ public:
 	 * Increasing the depth of the tree may speed-up rendering, but increse the memory consumption.
 	 * @param minPrimitives The minimum number of primitives in a leaf-node.
 	 * This parameters should be alway above 1.
+	 * @note If the nodes or the leaves of this tree exceed its share of their budgets (see @ref CMemoryStats and setBudgetShare()),
+	 * the build is stopped and the tree is rebuilt with a smaller maximum depth. The budgets limit the used part of the arenas: their
+	 * capacity is kept for the next build and is trimmed only if it exceeds the budgets, thus it may exceed them while a vector grows
 	 */
 	void build(const std::vector<ptr_prim_t>& vpPrims, size_t maxDepth = 20, size_t minPrimitives = 3) {
-		m_treeBoundingBox = calcBoundingBox(vpPrims);
 		m_maxDepth = maxDepth;
 		m_minPrimitives = minPrimitives;
-		std::cout << "Scene bounds are : " << m_treeBoundingBox << std::endl;
-		m_root = build(m_treeBoundingBox, vpPrims, 0);
+		rebuild(vpPrims);
+
+		while (m_maxDepth > 0 && isOverBudget()) {
+			m_maxDepth = m_maxDepth > 2 ? m_maxDepth - 2 : 0;
+			rebuild(vpPrims);		// the arenas keep their capacity
+		}
+		if (m_maxDepth != maxDepth)
+			printf("WARNING: The BSP tree exceeds its memory budget, rebuilt with the maximum depth %zu instead of %zu\n", m_maxDepth, maxDepth);
+		// the capacity beyond the used part of the arenas (e.g. reserved by an oversized tree) is returned only if it does not fit into the budgets
+		if (isOverBudget(true)) {
+			m_vNodes.shrink_to_fit();
+			m_vpLeafPrims.shrink_to_fit();
+			m_vBoxes.shrink_to_fit();
+			m_vIdx.shrink_to_fit();
+			account();
+		}
 	}
+	/**
+	 * @brief Sets the share of the memory budgets of the BSP trees, which this tree may use
+	 * @details When several trees exist at the same time, e.g. the trees of the frames rendered concurrently (see CAnimation::render()),
+	 * every tree is built within its share of the budgets, independently of the others
+	 * @param nShares The number of trees sharing the budgets: the tree may use 1 / \b nShares of every budget
+	 */
+	void setBudgetShare(size_t nShares) { m_nShares = MAX(1, nShares); }
 	/**
 	 * @brief Checks whether the ray \b ray intersects a primitive.
 	 * @details If ray \b ray intersects a primitive, the \b ray.t value will be updated
@@ -61,23 +85,57 @@ public:
 		m_treeBoundingBox.clip(ray, t0, t1);
 		if (t1 < t0) return false;  // no intersection with the bounding box
 
-		return m_root->intersect(ray, t0, t1);
+		return intersect(m_vNodes[0], ray, t0, t1);
 	}
+	/**
+	 * @brief Returns the bounding box of the tree
+	 * @return The bounding box containing all the primitives of the tree
+	 */
+	const CBoundingBox& getBoundingBox(void) const { return m_treeBoundingBox; }
 
 
 private:
+	// Builds the tree into the cleared arenas
+	void rebuild(const std::vector<ptr_prim_t>& vpPrims)
+	{
+		m_vNodes.clear();
+		m_vpLeafPrims.clear();
+		m_vBoxes.clear();
+		m_vIdx.clear();
+
+		m_treeBoundingBox = CBoundingBox();
+		for (auto& pPrim : vpPrims) {
+			m_vBoxes.push_back(pPrim->getBoundingBox());
+			m_treeBoundingBox.extend(m_vBoxes.back());
+		}
+		for (size_t i = 0; i < vpPrims.size(); i++)
+			m_vIdx.push_back(static_cast<dword>(i));
+
+		m_vNodes.emplace_back();
+		build(0, m_treeBoundingBox, vpPrims, 0, vpPrims.size(), 0);
+		account();
+	}
 	/**
 	 * @brief Builds the BSP tree
-	 * @details This function builds the BSP tree recursively
-	 * @param box The bounding box containing all the scene primitives
-	 * @param vpPrims The vector of pointers to the primitives included in the bounding box \b box
+	 * @details This function builds the BSP tree recursively. The indices of the primitives of a node are the range [\b begin; \b end) of the
+	 * index stack. The indices of the right half are copied to the top of the stack and those of the left half are compacted in place,
+	 * both keeping their order; the primitives crossing the splitting plane go to both halves
+	 * @param n The index of the node in the node arena
+	 * @param box The bounding box of the node
+	 * @param vpPrims The vector of pointers to all the primitives of the tree
+	 * @param begin The first position of the primitives of the node in the index stack
+	 * @param end The position after the last primitive of the node in the index stack
 	 * @param depth The distance from the root node of the tree
 	 */
-	ptr_bspnode_t build(const CBoundingBox& box, const std::vector<ptr_prim_t>& vpPrims, size_t depth)
+	void build(size_t n, const CBoundingBox& box, const std::vector<ptr_prim_t>& vpPrims, size_t begin, size_t end, size_t depth)
 	{
 		// Check for stoppong criteria
-		if (depth >= m_maxDepth || vpPrims.size() <= m_minPrimitives)
-			return std::make_shared<CBSPNode>(vpPrims);                                     // => Create a leaf node and break recursion
+		if (depth >= m_maxDepth || end - begin <= m_minPrimitives || isOverBudget()) {
+			m_vNodes[n] = CBSPNode(m_vpLeafPrims.size(), end - begin);                     // => Create a leaf node and break recursion
+			for (size_t i = begin; i < end; i++)
+				m_vpLeafPrims.push_back(vpPrims[m_vIdx[i]].get());
+			return;
+		}
 
 		// else -> prepare for creating a branch node
 		// First split the bounding volume into two halfes
@@ -88,27 +146,124 @@ private:
 		CBoundingBox& rBox = splitBoxes.second;
 
 		// Second order the primitives into new nounding boxes
-		std::vector<ptr_prim_t> lPrim;
-		std::vector<ptr_prim_t> rPrim;
-		for (auto pPrim : vpPrims) {
-			if (pPrim->getBoundingBox().overlaps(lBox))
-				lPrim.push_back(pPrim);
-			if (pPrim->getBoundingBox().overlaps(rBox))
-				rPrim.push_back(pPrim);
-		}
+		// (the primitives of a node overlap its box, thus only the splitting dimension has to be checked, as in CBoundingBox::overlaps())
+		const size_t rBegin = m_vIdx.size();
+		for (size_t i = begin; i < end; i++)
+			if (!(m_vBoxes[m_vIdx[i]].getMaxPoint()[splitDim] + Epsilon < splitVal))
+				m_vIdx.push_back(m_vIdx[i]);
+		const size_t rEnd = m_vIdx.size();
+		size_t lEnd = begin;
+		for (size_t i = begin; i < end; i++)
+			if (!(m_vBoxes[m_vIdx[i]].getMinPoint()[splitDim] - Epsilon > splitVal))
+				m_vIdx[lEnd++] = m_vIdx[i];
 
 		// Next build recursively 2 subtrees for both halfes
-		auto pLeft = build(lBox, lPrim, depth + 1);
-		auto pRight = build(rBox, rPrim, depth + 1);
+		const size_t left = m_vNodes.size();
+		m_vNodes.resize(left + 2);
+		m_vNodes[n] = CBSPNode(splitDim, splitVal, left);
+		build(left, lBox, vpPrims, begin, lEnd, depth + 1);
+		build(left + 1, rBox, vpPrims, rBegin, rEnd, depth + 1);
+		m_vIdx.resize(rBegin);
+	}
+	/**
+	 * @brief Traverses the ray \b ray and checks for intersection with a primitive
+	 * @details If the intersection is found, \b ray.t is updated. The visited nodes and the tested primitives are counted (see @ref CRayStats)
+	 * @param node The node
+	 * @param[in,out] ray The ray
+	 * @param[in] t0 The distance from ray origin at which the ray enters the node
+	 * @param[in] t1 The distance from ray origin at which the ray leaves the node
+	 * @retval true If ray \b ray intersects any object
+	 * @retval false otherwise
+	 */
+	bool intersect(const CBSPNode& node, Ray& ray, double t0, double t1) const
+	{
+		STATS_ADD(nodeVisits, 1);
+		if (node.isLeaf()) {
+			STATS_ADD(primTests, node.getNumPrims());
+			for (size_t i = node.getFirstPrim(); i < node.getFirstPrim() + node.getNumPrims(); i++)
+				m_vpLeafPrims[i]->intersect(ray);
+			return (ray.hit && ray.t < t1 + Epsilon);
+		}
+		else {
+			const int splitDim = node.getSplitDim();
+			// distnace from ray origin to the split plane of the current volume (may be negative)
+			double d = (node.getSplitVal() - ray.org[splitDim]) / ray.dir[splitDim];
 
-		return std::make_shared<CBSPNode>(splitDim, splitVal, pLeft, pRight);
+			const CBSPNode& frontNode = m_vNodes[(ray.dir[splitDim] < 0) ? node.Right() : node.Left()];
+			const CBSPNode& backNode = m_vNodes[(ray.dir[splitDim] < 0) ? node.Left() : node.Right()];
+
+			if (d <= t0) {
+				// t0..t1 is totally behind d, only go to back side
+				return intersect(backNode, ray, t0, t1);
+			}
+			else if (d >= t1) {
+				// t0..t1 is totally in front of d, only go to front side
+				return intersect(frontNode, ray, t0, t1);
+			}
+			else {
+				// travese both children. front one first, back one last
+				if (intersect(frontNode, ray, t0, d))
+					return true;
+
+				return intersect(backNode, ray, d, t1);
+			}
+		}
+	}
+	// Accounts the capacities of the arenas in CMemoryStats and checks whether the used parts (or the capacities) exceed the share of the budgets of this tree
+	// (the capacity reserved by a previous build does not count, since it is re-used)
+	bool isOverBudget(bool capacity = false)
+	{
+		account();
+		auto& stats = CMemoryStats::instance();
+		auto over = [&](CMemoryStats::Subsystem subsystem, qword bytes) {
+			const qword budget = stats.getBudget(subsystem);
+			return budget && bytes > budget / m_nShares;
+		};
+		return over(CMemoryStats::Subsystem::bspNodes, getNodeBytes(capacity)) || over(CMemoryStats::Subsystem::bspLeaves, getLeafBytes(capacity));
+	}
+	// Returns the bytes of the nodes and the build buffers: their capacity or their used part
+	qword getNodeBytes(bool capacity) const
+	{
+		return capacity
+			? m_vNodes.capacity() * sizeof(CBSPNode) + m_vBoxes.capacity() * sizeof(CBoundingBox) + m_vIdx.capacity() * sizeof(dword)
+			: m_vNodes.size() * sizeof(CBSPNode) + m_vBoxes.size() * sizeof(CBoundingBox) + m_vIdx.size() * sizeof(dword);
+	}
+	// Returns the bytes of the leaf primitives: their capacity or their used part
+	qword getLeafBytes(bool capacity) const
+	{
+		return (capacity ? m_vpLeafPrims.capacity() : m_vpLeafPrims.size()) * sizeof(const IPrim*);
+	}
+	// Reports the changes of the capacities of the arenas to CMemoryStats
+	void account(void)
+	{
+		const int64 nodeBytes = static_cast<int64>(getNodeBytes(true));
+		const int64 leafBytes = static_cast<int64>(getLeafBytes(true));
+		auto& stats = CMemoryStats::instance();
+		if (nodeBytes != m_nodeBytes) stats.add(CMemoryStats::Subsystem::bspNodes, nodeBytes - m_nodeBytes);
+		if (leafBytes != m_leafBytes) stats.add(CMemoryStats::Subsystem::bspLeaves, leafBytes - m_leafBytes);
+		m_nodeBytes = nodeBytes;
+		m_leafBytes = leafBytes;
+	}
+	// Frees the arenas
+	void release(void)
+	{
+		std::vector<CBSPNode>().swap(m_vNodes);
+		std::vector<const IPrim*>().swap(m_vpLeafPrims);
+		std::vector<CBoundingBox>().swap(m_vBoxes);
+		std::vector<dword>().swap(m_vIdx);
+		account();
 	}
 
 	
 private:
-	CBoundingBox 	m_treeBoundingBox;		///<
-	size_t			m_maxDepth;				///< The maximum allowed depth of the tree
-	size_t			m_minPrimitives;		///< The minimum number of primitives in a leaf-node
-	ptr_bspnode_t   m_root = nullptr;		///<
+	CBoundingBox 				m_treeBoundingBox;		///< The bounding box of the scene
+	size_t						m_maxDepth;				///< The maximum allowed depth of the tree
+	size_t						m_minPrimitives;		///< The minimum number of primitives in a leaf-node
+	std::vector<CBSPNode>		m_vNodes;				///< The node arena, the root node comes first
+	std::vector<const IPrim*>	m_vpLeafPrims;			///< The primitives of the leaf nodes, every leaf refers to a range
+	std::vector<CBoundingBox>	m_vBoxes;				///< Build buffer: the bounding boxes of the primitives
+	std::vector<dword>			m_vIdx;					///< Build buffer: the stack of the index ranges of the primitives
+	int64						m_nodeBytes = 0;		///< The bytes of the nodes and the build buffers accounted in @ref CMemoryStats
+	int64						m_leafBytes = 0;		///< The bytes of the leaf primitives accounted in @ref CMemoryStats
+	size_t						m_nShares = 1;			///< The number of trees sharing the budgets
 };
-	
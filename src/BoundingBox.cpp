@@ -1,5 +1,6 @@
 #include "BoundingBox.h"
 #include "ray.h"
+#include "CpuDispatch.h"
 
 namespace {
 	inline Vec3f Min3f(const Vec3f a, const Vec3f b)
@@ -44,43 +45,6 @@ bool CBoundingBox::overlaps(const CBoundingBox& box) const
 	
 void CBoundingBox::clip(const Ray& ray, double& t0, double& t1) const
 {
-    float d, den;
-    if (ray.dir.val[0] != 0) {
-        den = 1.0f / ray.dir.val[0];
-        if (ray.dir.val[0] > 0) {
-            if ((d = (m_minPoint.val[0] - ray.org.val[0]) * den) > t0) t0 = d;
-            if ((d = (m_maxPoint.val[0] - ray.org.val[0]) * den) < t1) t1 = d;
-        }
-        else {
-            if ((d = (m_maxPoint.val[0] - ray.org.val[0]) * den) > t0) t0 = d;
-            if ((d = (m_minPoint.val[0] - ray.org.val[0]) * den) < t1) t1 = d;
-        }
-        if (t0 > t1) return;
-    }
-
-    if (ray.dir.val[1] != 0) {
-        den = 1.0f / ray.dir.val[1];
-        if (ray.dir.val[1] > 0) {
-            if ((d = (m_minPoint.val[1] - ray.org.val[1]) * den) > t0) t0 = d;
-            if ((d = (m_maxPoint.val[1] - ray.org.val[1]) * den) < t1) t1 = d;
-        }
-        else {
-            if ((d = (m_maxPoint.val[1] - ray.org.val[1]) * den) > t0) t0 = d;
-            if ((d = (m_minPoint.val[1] - ray.org.val[1]) * den) < t1) t1 = d;
-        }
-        if (t0 > t1) return;
-    }
-
-    if (ray.dir.val[2] != 0) {
-        den = 1.0f / ray.dir.val[2];
-        if (ray.dir.val[2] > 0) {
-            if ((d = (m_minPoint.val[2] - ray.org.val[2]) * den) > t0) t0 = d;
-            if ((d = (m_maxPoint.val[2] - ray.org.val[2]) * den) < t1) t1 = d;
-        }
-        else {
-            if ((d = (m_maxPoint.val[2] - ray.org.val[2]) * den) > t0) t0 = d;
-            if ((d = (m_minPoint.val[2] - ray.org.val[2]) * den) < t1) t1 = d;
-        }
-    }
+    CCpuDispatch::getKernels().clip(m_minPoint.val, m_maxPoint.val, ray.org.val, ray.dir.val, t0, t1);
 }
 	
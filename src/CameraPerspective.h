@@ -33,6 +33,11 @@ public:
         m_xAxis = normalize(m_xAxis);
         m_yAxis = normalize(m_yAxis);
         m_zAxis = normalize(m_zAxis);
+
+        // the direction through the screen point (x, y) is m_d0 + x * m_dx + y * m_dy
+        m_d0 = m_focus * m_zAxis - getAspectRatio() * m_xAxis - m_yAxis;
+        m_dx = 2 * getAspectRatio() / resolution.width * m_xAxis;
+        m_dy = 2.0f / resolution.height * m_yAxis;
     }
     virtual ~CCameraPerspective(void) = default;
 
@@ -40,16 +45,75 @@ public:
 	
     virtual void InitRay(Ray& ray, int x, int y, const Vec2f& sample = Vec2f::all(0.5f)) override
     {
-        float dx = sample[0];	// x-shift to the center of the pixel
-        float dy = sample[1];	// y-shift to the center of the pixel
+        float sx = x + sample[0];	// screen coordinates of the sample
+        float sy = y + sample[1];
+
+        Vec3f dir = m_d0 + sx * m_dx + sy * m_dy;
+        ray.org = m_pos;
+        ray.dir = (1.0f / sqrtf(dir.dot(dir))) * dir;
+        ray.t = std::numeric_limits<double>::infinity();
+    }
+
+    virtual void InitRays(RayBatch& batch, const Rect& region, const Vec2f& sample = Vec2f::all(0.5f)) override
+    {
+        batch.resize(region);
+        std::fill(batch.orgX.begin(), batch.orgX.end(), m_pos.val[0]);
+        std::fill(batch.orgY.begin(), batch.orgY.end(), m_pos.val[1]);
+        std::fill(batch.orgZ.begin(), batch.orgZ.end(), m_pos.val[2]);
+
+        // the same arithmetic as InitRay(), split into independent lanes, which the compiler may vectorize
+        const float d0x = m_d0.val[0], d0y = m_d0.val[1], d0z = m_d0.val[2];
+        const float dxx = m_dx.val[0], dxy = m_dx.val[1], dxz = m_dx.val[2];
+        const float dyx = m_dy.val[0], dyy = m_dy.val[1], dyz = m_dy.val[2];
+        for (int y = 0; y < region.height; y++) {
+            const float sy = region.y + y + sample[1];
+            const size_t row = static_cast<size_t>(y) * region.width;
+            float* pDirX = batch.dirX.data() + row;
+            float* pDirY = batch.dirY.data() + row;
+            float* pDirZ = batch.dirZ.data() + row;
+            for (int x = 0; x < region.width; x++) {
+                const float sx = region.x + x + sample[0];
+                const float dirX = d0x + sx * dxx + sy * dyx;
+                const float dirY = d0y + sx * dxy + sy * dyy;
+                const float dirZ = d0z + sx * dxz + sy * dyz;
+                const float invLength = 1.0f / sqrtf(dirX * dirX + dirY * dirY + dirZ * dirZ);
+                pDirX[x] = invLength * dirX;
+                pDirY[x] = invLength * dirY;
+                pDirZ[x] = invLength * dirZ;
+            }
+        }
+    }
+
+    virtual std::optional<Vec3f> project(const Vec3f& point) const override
+    {
+        Vec3f d = point - m_pos;
+        float z = d.dot(m_zAxis);
+        if (z < Epsilon) return std::nullopt;
 
         // Screen space coordinates [-1, 1]
-        float sscx = 2 * (x + dx) / getResolution().width - 1;
-        float sscy = 2 * (y + dy) / getResolution().height - 1;
+        float sscx = m_focus * d.dot(m_xAxis) / (getAspectRatio() * z);
+        float sscy = m_focus * d.dot(m_yAxis) / z;
+        return Vec3f((sscx + 1) * getResolution().width / 2, (sscy + 1) * getResolution().height / 2, static_cast<float>(norm(d)));
+    }
 
-        ray.org = m_pos;
-        ray.dir = normalize(getAspectRatio() * sscx * m_xAxis + sscy * m_yAxis + m_focus * m_zAxis);
-        ray.t = std::numeric_limits<float>::infinity();
+    /**
+     * @brief Returns the camera origin
+     * @return The camera origin (center of projection) in WCS
+     */
+    Vec3f getPosition(void) const { return m_pos; }
+    /**
+     * @brief Returns the direction of the primary rays as a linear function of the pixel coordinates
+     * @details The ray through the point (x, y) of the screen has the direction normalize(d0 + x * dx + y * dy), where the pixel (i, j)
+     * has its center at (i + 0.5, j + 0.5) (see InitRay())
+     * @param[out] d0 The direction through the upper-left corner of the screen
+     * @param[out] dx The change of the direction per pixel along the x-axis
+     * @param[out] dy The change of the direction per pixel along the y-axis
+     */
+    void getRayDirection(Vec3f& d0, Vec3f& dx, Vec3f& dy) const
+    {
+        d0 = m_d0;
+        dx = m_dx;
+        dy = m_dy;
     }
 
 
@@ -64,5 +128,8 @@ private:
     Vec3f m_xAxis;  ///< Camera x-axis in WCS
     Vec3f m_yAxis;  ///< Camera y-axis in WCS
     Vec3f m_zAxis;  ///< Camera z-axis in WCS
+    Vec3f m_d0;     ///< Ray direction through the upper-left corner of the screen
+    Vec3f m_dx;     ///< Change of the ray direction per pixel along the x-axis
+    Vec3f m_dy;     ///< Change of the ray direction per pixel along the y-axis
 };
 
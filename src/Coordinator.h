@@ -0,0 +1,213 @@
+// Distributed Rendering Coordinator class
+#pragma once
+
+#include "Socket.h"
+#ifndef _WIN32
+#include "RenderEngine.h"
+#include <poll.h>
+#include <deque>
+#include <map>
+#include <numeric>
+
+// ================================ Coordinator Class ================================
+/**
+ * @brief Coordinator of the distributed rendering
+ * @details The coordinator splits the frames into shards: whole frames or, for a single large frame, rectangular regions. It accepts
+ * the connections of the render workers (see @ref CWorker), which may join at any time, assigns one shard at a time to every idle worker,
+ * assembles the received regions and passes the completed frames to the callback function in the frame order. While rendering, the workers
+ * send keep-alive messages. If a worker disconnects or sends nothing within the timeout (see setTimeout()), its shard is assigned again to another worker.
+ * @code
+ * CCoordinator coordinator(7777, resolution, 256);
+ * // start the workers: eyden-tracer --worker=localhost:7777
+ * coordinator.run(0, 180, [&](size_t frame, const Mat& img) { frameWriter.push(img, frame); });
+ * @endcode
+ */
+class CCoordinator
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param port The TCP port, where the workers connect to. If zero, a free port is chosen (see getPort())
+	 * @param resolution The resolution of the frames
+	 * @param shardSize The size of the square regions in pixels. If zero, every shard is a whole frame
+	 */
+	CCoordinator(word port, Size resolution, int shardSize = 0)
+		: m_listener(CSocket::listen(port))
+		, m_resolution(resolution)
+		, m_vRegions(CRenderEngine::getTiles(resolution, shardSize > 0 ? shardSize : MAX(resolution.width, resolution.height), CRenderEngine::TileOrder::scanline))
+	{}
+	CCoordinator(const CCoordinator&) = delete;
+	~CCoordinator(void) = default;
+	const CCoordinator& operator=(const CCoordinator&) = delete;
+
+	/**
+	 * @brief Renders the frames with the connected workers
+	 * @details Blocks until all the frames are rendered. Finally, the workers are asked to quit
+	 * @param firstFrame The index of the first frame
+	 * @param nFrames The number of frames
+	 * @param fnFrame The callback function fnFrame(size_t frame, const Mat& img), receiving the assembled frames (type: CV_32FC3)
+	 * @retval true If all the frames were rendered
+	 * @retval false If no worker was connected for longer than the timeout
+	 */
+	bool run(size_t firstFrame, size_t nFrames, const std::function<void(size_t, const Mat&)>& fnFrame)
+	{
+		if (!m_listener.isValid()) return false;
+
+		struct Shard {
+			size_t	frame;
+			Rect	region;
+		};
+		std::vector<Shard> vShards;
+		for (size_t frame = firstFrame; frame < firstFrame + nFrames; frame++)
+			for (auto& region : m_vRegions)
+				vShards.push_back({ frame, region });
+		std::deque<size_t> qPending(vShards.size());
+		std::iota(qPending.begin(), qPending.end(), 0);
+
+		std::map<size_t, std::pair<Mat, size_t>> mFrames;		// the frames being assembled and their numbers of missing regions
+		std::vector<Worker> vWorkers;
+		int64 idleTicks = getTickCount();						// the time since when no worker is connected
+		auto drop = [&](size_t w) {
+			if (vWorkers[w].shard >= 0) {
+				qPending.push_front(static_cast<size_t>(vWorkers[w].shard));
+				m_nReassigned++;
+			}
+			vWorkers.erase(vWorkers.begin() + w);
+			if (vWorkers.empty()) idleTicks = getTickCount();
+		};
+
+		size_t nextFrame = firstFrame;
+		while (nextFrame < firstFrame + nFrames) {
+			// assign the pending shards to the idle workers
+			for (size_t w = 0; w < vWorkers.size(); w++) {
+				if (vWorkers[w].shard >= 0 || qPending.empty()) continue;
+				size_t s = qPending.front();
+				const Shard& shard = vShards[s];
+				ShardMessage msg;
+				msg.type = ShardMessage::job;
+				msg.frame = static_cast<dword>(shard.frame);
+				msg.x = shard.region.x;
+				msg.y = shard.region.y;
+				msg.width = shard.region.width;
+				msg.height = shard.region.height;
+				if (!vWorkers[w].socket.send(&msg, sizeof(msg))) {
+					drop(w--);
+					continue;
+				}
+				qPending.pop_front();
+				vWorkers[w].shard = static_cast<int>(s);
+				vWorkers[w].ticks = getTickCount();
+				if (mFrames.find(shard.frame) == mFrames.end())
+					mFrames[shard.frame] = std::make_pair(Mat(m_resolution, CV_32FC3, Scalar::all(0)), m_vRegions.size());
+			}
+
+			// wait for new workers and results
+			std::vector<pollfd> vFds(1 + vWorkers.size());
+			vFds[0] = { m_listener.getFd(), POLLIN, 0 };
+			for (size_t w = 0; w < vWorkers.size(); w++)
+				vFds[1 + w] = { vWorkers[w].socket.getFd(), POLLIN, 0 };
+			poll(vFds.data(), vFds.size(), 100);
+
+			for (size_t w = vWorkers.size(); w > 0; w--) {
+				Worker& worker = vWorkers[w - 1];
+				if (vFds[w].revents == 0) {
+					if (worker.shard >= 0 && (getTickCount() - worker.ticks) / getTickFrequency() > m_timeout) {
+						printf("Worker timed out, reassigning the shard\n");
+						drop(w - 1);
+					}
+					continue;
+				}
+				ShardMessage msg;
+				if (worker.shard < 0 || !worker.socket.recv(&msg, sizeof(msg))
+					|| (msg.type != ShardMessage::alive && !receive(worker.socket, msg, vShards[worker.shard].region, mFrames[vShards[worker.shard].frame]))) {
+					if (worker.shard >= 0) printf("Worker disconnected, reassigning the shard\n");
+					drop(w - 1);
+					continue;
+				}
+				if (msg.type == ShardMessage::alive) worker.ticks = getTickCount();
+				else worker.shard = -1;
+			}
+			if (vFds[0].revents & POLLIN) {
+				CSocket socket = m_listener.accept();
+				if (socket.isValid()) {
+					vWorkers.push_back({ std::move(socket), -1, 0 });
+					m_nWorkers++;
+				}
+			}
+
+			// deliver the completed frames in order
+			for (auto it = mFrames.find(nextFrame); it != mFrames.end() && it->second.second == 0; it = mFrames.find(++nextFrame)) {
+				fnFrame(nextFrame, it->second.first);
+				mFrames.erase(it);
+			}
+
+			if (vWorkers.empty() && (getTickCount() - idleTicks) / getTickFrequency() > m_timeout) {
+				printf("ERROR: No render workers connected\n");
+				return false;
+			}
+		}
+
+		ShardMessage msg;
+		msg.type = ShardMessage::quit;
+		for (auto& worker : vWorkers)
+			worker.socket.send(&msg, sizeof(msg));
+		return true;
+	}
+	/**
+	 * @brief Sets the time, after which a silent worker is considered lost
+	 * @details A worker is silent, if it neither sent the result nor a keep-alive message (see CWorker::setHeartbeat()) since the assignment
+	 * of its shard or since its last keep-alive message. The same time limits the waiting for the workers, when none is connected
+	 * @param seconds The timeout in seconds
+	 */
+	void setTimeout(double seconds) { m_timeout = seconds; }
+	/**
+	 * @brief Returns the TCP port of the coordinator
+	 * @return The TCP port
+	 */
+	word getPort(void) const { return m_listener.getPort(); }
+	/**
+	 * @brief Checks whether the coordinator is listening for workers
+	 * @retval true If the port was successfully bound
+	 * @retval false Otherwise
+	 */
+	bool isValid(void) const { return m_listener.isValid(); }
+	/**
+	 * @brief Returns the number of workers, which connected to the coordinator
+	 * @return The number of workers since the creation of the coordinator
+	 */
+	size_t getNumWorkers(void) const { return m_nWorkers; }
+	/**
+	 * @brief Returns the number of shards, which had to be assigned again after a worker failure
+	 * @return The number of reassigned shards since the creation of the coordinator
+	 */
+	size_t getNumReassigned(void) const { return m_nReassigned; }
+
+
+private:
+	struct Worker {
+		CSocket	socket;			///< The connection to the worker
+		int		shard;			///< The index of the assigned shard (-1 - idle)
+		int64	ticks;			///< The time of the assignment or of the last keep-alive message
+	};
+
+	// Receives the pixels following the result message \b msg of the region and copies them into the frame
+	static bool receive(const CSocket& socket, const ShardMessage& msg, const Rect& region, std::pair<Mat, size_t>& frame)
+	{
+		if (msg.type != ShardMessage::result || Rect(msg.x, msg.y, msg.width, msg.height) != region) return false;
+		Mat tile(region.height, region.width, CV_32FC3);
+		if (!socket.recv(tile.data, tile.total() * tile.elemSize())) return false;
+		tile.copyTo(frame.first(region));
+		frame.second--;
+		return true;
+	}
+
+
+private:
+	CSocket				m_listener;				///< The listening socket
+	Size				m_resolution;			///< The resolution of the frames
+	std::vector<Rect>	m_vRegions;				///< The regions of a frame
+	double				m_timeout = 60;			///< The timeout in seconds
+	size_t				m_nWorkers = 0;			///< The number of connected workers
+	size_t				m_nReassigned = 0;		///< The number of reassigned shards
+};
+#endif
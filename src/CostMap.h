@@ -0,0 +1,136 @@
+// Render Cost Map class
+#pragma once
+
+#include "RayStats.h"
+#include <array>
+
+// ================================ Cost Map Class ================================
+/**
+ * @brief Per-pixel render cost map class
+ * @details The cost of a pixel is the difference of the thread-local ray counters (see CRayStats::getLocal()) before and after the pixel:
+ * the visited BSP nodes, the ray - primitive tests and the shadow rays. Thus the cost map and the ray throughput share one counting
+ * mechanism, which is compiled in only with ENABLE_STATS; otherwise only the time channel is recorded. The render engine
+ * (see CRenderEngine::setCostMap()) stores the counters together with the time spent on the pixel in the cost map. The channels of the map
+ * may be retrieved as raw float buffers (see get()) or as false-color images (see getHeatmap()) and written next to the rendered image
+ * (see write()). They show, whether the expensive pixels are caused by deep traversals, by large leaves or by the shadow rays.
+ * @code
+ * CRayStats::Counters before = CRayStats::getLocal();
+ * Vec3f color = scene.RayTrace(ray);
+ * costMap.set(x, y, CRayStats::getLocal() - before, ns);
+ * @endcode
+ */
+class CCostMap
+{
+public:
+	/// Channels of the cost map
+	enum class Channel {
+		nodes,		///< The number of visited BSP nodes
+		prims,		///< The number of ray - primitive intersection tests
+		shadows,	///< The number of cast shadow rays
+		time		///< The time spent on the pixel in nanoseconds
+	};
+	/**
+	 * @brief Constructor
+	 * @param resolution The resolution of the map
+	 */
+	CCostMap(Size resolution = Size(0, 0)) { clear(resolution); }
+	CCostMap(const CCostMap&) = delete;
+	~CCostMap(void) = default;
+	const CCostMap& operator=(const CCostMap&) = delete;
+
+	/**
+	 * @brief Resets the map
+	 * @param resolution The resolution of the map
+	 */
+	void clear(Size resolution)
+	{
+		for (auto& map : m_vMaps) map = Mat(resolution, CV_32FC1, Scalar(0));
+	}
+	/**
+	 * @brief Stores the cost of the pixel (x, y)
+	 * @param x The x-coordinate of the pixel
+	 * @param y The y-coordinate of the pixel
+	 * @param counters The ray counters of the pixel
+	 * @param time The time spent on the pixel in nanoseconds
+	 */
+	void set(int x, int y, const CRayStats::Counters& counters, float time)
+	{
+		m_vMaps[static_cast<size_t>(Channel::nodes)].at<float>(y, x) = static_cast<float>(counters[CRayStats::Counter::nodeVisits]);
+		m_vMaps[static_cast<size_t>(Channel::prims)].at<float>(y, x) = static_cast<float>(counters[CRayStats::Counter::primTests]);
+		m_vMaps[static_cast<size_t>(Channel::shadows)].at<float>(y, x) = static_cast<float>(counters[CRayStats::Counter::shadowRays]);
+		m_vMaps[static_cast<size_t>(Channel::time)].at<float>(y, x) = time;
+	}
+	/**
+	 * @brief Returns a channel of the map
+	 * @param channel The channel
+	 * @return The raw values of the channel (type: CV_32FC1)
+	 */
+	const Mat& get(Channel channel) const { return m_vMaps[static_cast<size_t>(channel)]; }
+	/**
+	 * @brief Returns the size of the channels
+	 * @return The size in bytes
+	 */
+	size_t getMemory(void) const
+	{
+		size_t res = 0;
+		for (const Mat& map : m_vMaps) res += map.total() * map.elemSize();
+		return res;
+	}
+	/**
+	 * @brief Returns a channel of the map as a false-color image
+	 * @details The scale is clipped at the 99th percentile of the channel, so that a few outliers (e.g. the pixels interrupted by the
+	 * operating system) do not darken the rest of the image
+	 * @param channel The channel
+	 * @return The color-coded channel (type: CV_8UC3), where blue is no cost and red is the highest cost
+	 */
+	Mat getHeatmap(Channel channel) const
+	{
+		const Mat& map = get(channel);
+		std::vector<float> vValues(map.begin<float>(), map.end<float>());
+		float scale = 0;
+		if (!vValues.empty()) {
+			auto percentile = vValues.begin() + (vValues.size() - 1) * 99 / 100;
+			std::nth_element(vValues.begin(), percentile, vValues.end());
+			scale = *percentile;
+		}
+		Mat res;
+		map.convertTo(res, CV_8UC1, scale > 0 ? 255.0 / scale : 0);
+		applyColorMap(res, res, COLORMAP_JET);
+		return res;
+	}
+	/**
+	 * @brief Writes every channel as a false-color image \b prefix_<channel>.png and as a raw float buffer \b prefix_<channel>.pfm
+	 * @param prefix The prefix of the file names, e.g. the file name of the rendered image without the extension
+	 * @retval true If all the files were written
+	 * @retval false Otherwise
+	 */
+	bool write(const std::string& prefix) const
+	{
+		bool res = true;
+		for (Channel channel : { Channel::nodes, Channel::prims, Channel::shadows, Channel::time }) {
+			const std::string fileName = prefix + "_" + getName(channel);
+			res &= imwrite(fileName + ".png", getHeatmap(channel));
+			res &= imwrite(fileName + ".pfm", get(channel));
+		}
+		return res;
+	}
+	/**
+	 * @brief Returns the name of a channel
+	 * @param channel The channel
+	 * @return The name of the channel
+	 */
+	static const char* getName(Channel channel)
+	{
+		switch (channel) {
+			case Channel::nodes:	return "nodes";
+			case Channel::prims:	return "prims";
+			case Channel::shadows:	return "shadows";
+			case Channel::time:		return "time";
+		}
+		return "";
+	}
+
+
+private:
+	std::array<Mat, 4>	m_vMaps;								///< The channels of the map
+};
@@ -0,0 +1,124 @@
+#include "CpuDispatch.h"
+#include <cstdio>
+#include <cstdlib>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_X86
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_X86
+#endif
+
+namespace {
+#ifdef CPU_X86
+	// Executes CPUID with the leaf and the sub-leaf and returns eax, ebx, ecx, edx
+	void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+	{
+#ifdef _MSC_VER
+		int res[4];
+		__cpuidex(res, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned>(res[i]);
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	// Returns the register state enabled by the operating system (XCR0)
+	unsigned long long xgetbv(void)
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+#endif
+}
+
+CCpuDispatch::CCpuDispatch(void)
+{
+	m_supported[static_cast<size_t>(ISA::baseline)] = true;
+#ifdef CPU_X86
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	const unsigned maxLeaf = regs[0];
+	cpuid(1, 0, regs);
+	const unsigned ecx1 = regs[2];
+	unsigned ebx7 = 0;
+	if (maxLeaf >= 7) {
+		cpuid(7, 0, regs);
+		ebx7 = regs[1];
+	}
+	// the wide registers must be saved by the operating system
+	const unsigned long long xcr0 = (ecx1 & (1u << 27)) ? xgetbv() : 0;		// OSXSAVE
+	const bool osAVX = (xcr0 & 0x06) == 0x06;									// XMM and YMM state
+	const bool osAVX512 = (xcr0 & 0xE6) == 0xE6;								// and opmask, ZMM_Hi256 and Hi16_ZMM state
+
+	const bool sse42 = (ecx1 & (1u << 20)) != 0;
+	const bool avx = (ecx1 & (1u << 28)) != 0;
+	const bool fma = (ecx1 & (1u << 12)) != 0;
+	const bool avx2 = (ebx7 & (1u << 5)) != 0;
+	const bool avx512f = (ebx7 & (1u << 16)) != 0;
+
+	m_supported[static_cast<size_t>(ISA::sse42)] = sse42;
+	m_supported[static_cast<size_t>(ISA::avx2)] = sse42 && avx && fma && avx2 && osAVX;
+	m_supported[static_cast<size_t>(ISA::avx512)] = m_supported[static_cast<size_t>(ISA::avx2)] && avx512f && osAVX512;
+#endif
+
+	// the widest variant, which is compiled and supported
+	size_t limit = nISAs - 1;
+	const char* pOverride = getenv("EYDEN_ISA");
+	if (pOverride && *pOverride) {
+		m_override = pOverride;
+		size_t i = 0;
+		while (i < nISAs && m_override != getName(static_cast<ISA>(i))) i++;
+		if (i == nISAs)
+			printf("WARNING: Unknown instruction set EYDEN_ISA=%s, expected baseline, sse4.2, avx2 or avx512\n", pOverride);
+		else {
+			if (!isSupported(static_cast<ISA>(i)) || !isCompiled(static_cast<ISA>(i)))
+				printf("WARNING: The instruction set EYDEN_ISA=%s is not %s, using a narrower one\n", pOverride, isSupported(static_cast<ISA>(i)) ? "compiled in this build" : "supported by the CPU");
+			limit = i;
+		}
+	}
+	for (size_t i = 0; i <= limit; i++)
+		if (isSupported(static_cast<ISA>(i)) && isCompiled(static_cast<ISA>(i)))
+			m_isa = static_cast<ISA>(i);
+	m_pKernels = getTable(m_isa);
+}
+
+std::string CCpuDispatch::getReport(void) const
+{
+	std::string res = getName(m_isa);
+	res += " (CPU:";
+	for (size_t i = 1; i < nISAs; i++)
+		if (isSupported(static_cast<ISA>(i))) res += std::string(" ") + getName(static_cast<ISA>(i));
+	if (!isSupported(ISA::sse42)) res += " baseline";
+	res += ", compiled:";
+	for (size_t i = 0; i < nISAs; i++)
+		if (isCompiled(static_cast<ISA>(i))) res += std::string(" ") + getName(static_cast<ISA>(i));
+	if (!m_override.empty()) res += ", EYDEN_ISA=" + m_override;
+	res += ")";
+	return res;
+}
+
+const char* CCpuDispatch::getName(ISA isa)
+{
+	switch (isa) {
+		case ISA::sse42:	return "sse4.2";
+		case ISA::avx2:		return "avx2";
+		case ISA::avx512:	return "avx512";
+		default:			return "baseline";
+	}
+}
+
+const KernelTable* CCpuDispatch::getTable(ISA isa)
+{
+	switch (isa) {
+		case ISA::sse42:	return getKernelsSSE42();
+		case ISA::avx2:		return getKernelsAVX2();
+		case ISA::avx512:	return getKernelsAVX512();
+		default:			return getKernelsBaseline();
+	}
+}
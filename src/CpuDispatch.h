@@ -0,0 +1,84 @@
+// Run-time selection of the instruction set for the hot kernels
+#pragma once
+
+#include "Kernels.h"
+#include <string>
+
+// ================================ CPU Dispatch Class ================================
+/**
+ * @brief Run-time CPU feature dispatch class
+ * @details The hot kernels (see @ref KernelTable) are compiled for several instruction sets, so that a single binary runs the best code
+ * on every machine. At the first use the class queries the CPU with CPUID (and the operating system with XGETBV for the AVX register state)
+ * and selects the widest variant, which is both compiled and supported. The choice may be lowered with the environment variable
+ * \b EYDEN_ISA (baseline, sse4.2, avx2 or avx512); a variant, which the CPU does not support, is never selected.
+ * @code
+ * CCpuDispatch::getKernels().illuminate(samples, n, kd, ks, ke);
+ * printf("Kernels: %s\n", CCpuDispatch::instance().getReport().c_str());
+ * @endcode
+ */
+class CCpuDispatch
+{
+public:
+	/// Instruction sets with a variant of the kernels
+	enum class ISA : size_t {
+		baseline,	///< The baseline of the target (SSE2 on x86-64), no architecture flags
+		sse42,		///< SSE4.2
+		avx2,		///< AVX2 and FMA
+		avx512		///< AVX-512 Foundation
+	};
+	static constexpr size_t nISAs = 4;	///< The number of instruction sets
+
+	/**
+	 * @brief Returns the instance of the dispatcher
+	 * @details The CPU is queried and the kernels are selected at the first call
+	 */
+	static CCpuDispatch& instance(void)
+	{
+		static CCpuDispatch dispatch;
+		return dispatch;
+	}
+	/**
+	 * @brief Returns the selected kernels
+	 * @details The CPU is queried at the first call. Later calls pay only the check of the lazy initialization, which is cheap even for
+	 * the kernels called once per ray (see KernelTable::clip and KernelTable::intersectTriangle)
+	 * @return The kernel table of the selected instruction set
+	 */
+	static const KernelTable& getKernels(void) { return *instance().m_pKernels; }
+	/**
+	 * @brief Returns the selected instruction set
+	 */
+	ISA getISA(void) const { return m_isa; }
+	/**
+	 * @brief Checks whether the CPU and the operating system support the instruction set \b isa
+	 */
+	bool isSupported(ISA isa) const { return m_supported[static_cast<size_t>(isa)]; }
+	/**
+	 * @brief Checks whether the kernels were compiled for the instruction set \b isa
+	 */
+	bool isCompiled(ISA isa) const { return getTable(isa) != nullptr; }
+	/**
+	 * @brief Returns the description of the selected path
+	 * @return The selected instruction set, followed by the ones supported by the CPU and the compiled ones, e.g. "avx2 (CPU: sse4.2 avx2, compiled: baseline sse4.2 avx2 avx512)"
+	 */
+	std::string getReport(void) const;
+	/**
+	 * @brief Returns the name of the instruction set \b isa, as accepted by \b EYDEN_ISA
+	 */
+	static const char* getName(ISA isa);
+
+
+private:
+	CCpuDispatch(void);
+	CCpuDispatch(const CCpuDispatch&) = delete;
+	const CCpuDispatch& operator=(const CCpuDispatch&) = delete;
+
+	// Returns the kernels compiled for the instruction set isa or nullptr
+	static const KernelTable* getTable(ISA isa);
+
+
+private:
+	bool				m_supported[nISAs] = {};	///< The instruction sets supported by the CPU
+	ISA					m_isa = ISA::baseline;		///< The selected instruction set
+	std::string			m_override;					///< The value of EYDEN_ISA or an empty string
+	const KernelTable*	m_pKernels = nullptr;		///< The kernels of the selected instruction set
+};
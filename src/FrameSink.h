@@ -0,0 +1,220 @@
+// Frame Sink classes
+#pragma once
+
+#include "IFrameSink.h"
+#include <cstring>
+
+// ================================ Video Frame Sink Class ================================
+/**
+ * @brief Frame sink, which encodes the frames into a video file
+ */
+class CFrameSinkVideo : public IFrameSink
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param fileName The name of the video file
+	 * @param codec The four-character code of the codec (see VideoWriter::fourcc())
+	 * @param fps The frame rate
+	 * @param resolution The resolution of the frames
+	 */
+	CFrameSinkVideo(const std::string& fileName, int codec, double fps, Size resolution)
+	{
+		m_videoWriter.open(fileName, codec, fps, resolution);
+		if (!m_videoWriter.isOpened()) printf("ERROR: Can't open video file %s for writing\n", fileName.c_str());
+	}
+	virtual ~CFrameSinkVideo(void) = default;
+
+	virtual bool write(const Mat& img, size_t) override
+	{
+		if (!m_videoWriter.isOpened()) return false;
+		img.convertTo(m_frame, CV_8UC3, 255);
+		m_videoWriter << m_frame;
+		return true;
+	}
+	/**
+	 * @brief Checks whether the video file was opened for writing
+	 */
+	bool isOpened(void) const { return m_videoWriter.isOpened(); }
+
+
+private:
+	VideoWriter m_videoWriter;	///< The video encoder
+	Mat			m_frame;		///< The 8-bit frame buffer
+};
+
+// ================================ Display Frame Sink Class ================================
+/**
+ * @brief Frame sink, which shows the frames in a window
+ * @note Some platforms (e.g. MacOS) allow to create windows only in the main thread. Do not use this sink with @ref CFrameWriter there
+ */
+class CFrameSinkDisplay : public IFrameSink
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param windowName The name of the window
+	 * @param delay The time to wait after every frame in milliseconds
+	 */
+	CFrameSinkDisplay(const std::string& windowName = "frame", int delay = 5) : m_windowName(windowName), m_delay(delay) {}
+	virtual ~CFrameSinkDisplay(void) = default;
+
+	virtual bool write(const Mat& img, size_t) override
+	{
+		imshow(m_windowName, img);
+		waitKey(m_delay);
+		return true;
+	}
+
+
+private:
+	std::string m_windowName;	///< The name of the window
+	int			m_delay;		///< The time to wait after every frame in milliseconds
+};
+
+// ================================ File Frame Sink Class ================================
+/**
+ * @brief Frame sink, which stores every frame in its own file
+ * @details The frames are stored without quantization: as Portable Float Map (.pfm) or, if supported by OpenCV, as OpenEXR (.exr).
+ * Any other extension is passed to imwrite() as an 8-bit image
+ */
+class CFrameSinkFile : public IFrameSink
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param pattern The printf-like pattern of the file names, receiving the frame index, e.g. "frame_%04zu.pfm" (see isValidPattern())
+	 */
+	CFrameSinkFile(const std::string& pattern) : m_pattern(pattern) {}
+	virtual ~CFrameSinkFile(void) = default;
+
+	virtual bool write(const Mat& img, size_t frame) override
+	{
+		const std::string fileName = getFileName(m_pattern, frame);
+		if (fileName.empty()) {
+			printf("ERROR: Invalid pattern of the frame file names %s\n", m_pattern.c_str());
+			return false;
+		}
+		std::string ext = m_pattern.substr(m_pattern.find_last_of('.') + 1);
+		bool res;
+		if (ext == "pfm") res = writePFM(fileName, img);
+		else if (ext == "exr") res = imwrite(fileName, img);
+		else {
+			Mat frame_img;
+			img.convertTo(frame_img, CV_8UC3, 255);
+			res = imwrite(fileName, frame_img);
+		}
+		if (!res) printf("ERROR: Can't write file %s\n", fileName.c_str());
+		return res;
+	}
+	/**
+	 * @brief Checks whether \b pattern may be used as the pattern of the file names
+	 * @details The user-given pattern is never passed to printf() as is: it must contain exactly one integer conversion (d, i, u, o, x or X
+	 * with any flags, width, precision and length modifier, e.g. %04zu) and no other conversions except %%
+	 * @param pattern The printf-like pattern
+	 * @retval true If the pattern is valid
+	 * @retval false Otherwise
+	 */
+	static bool isValidPattern(const std::string& pattern) { return !normalize(pattern).empty(); }
+	/**
+	 * @brief Returns the file name with the index \b index
+	 * @param pattern The printf-like pattern of the file names (see isValidPattern())
+	 * @param index The index, e.g. of the frame or of the view
+	 * @return The file name or an empty string if the pattern is invalid
+	 */
+	static std::string getFileName(const std::string& pattern, size_t index)
+	{
+		const std::string format = normalize(pattern);
+		if (format.empty()) return format;
+		const unsigned long long value = index;
+		std::string res(static_cast<size_t>(snprintf(nullptr, 0, format.c_str(), value)), '\0');
+		snprintf(&res[0], res.size() + 1, format.c_str(), value);
+		return res;
+	}
+
+
+private:
+	// Returns the pattern, whose only integer conversion takes unsigned long long, or an empty string if the pattern is invalid
+	static std::string normalize(const std::string& pattern)
+	{
+		std::string res;
+		size_t nConversions = 0;
+		for (size_t i = 0; i < pattern.size(); i++) {
+			res += pattern[i];
+			if (pattern[i] != '%') continue;
+			if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+				res += pattern[++i];
+				continue;
+			}
+			size_t j = i + 1;
+			while (j < pattern.size() && pattern[j] && strchr("-+ #0", pattern[j])) j++;					// flags
+			while (j < pattern.size() && isdigit(static_cast<unsigned char>(pattern[j]))) j++;				// width
+			if (j < pattern.size() && pattern[j] == '.') j++;												// precision
+			while (j < pattern.size() && isdigit(static_cast<unsigned char>(pattern[j]))) j++;
+			res += pattern.substr(i + 1, j - i - 1);
+			while (j < pattern.size() && pattern[j] && strchr("hlzjt", pattern[j])) j++;					// length modifier, replaced by ll
+			if (j == pattern.size() || !pattern[j] || !strchr("diuoxX", pattern[j])) return std::string();
+			res += "ll";
+			res += pattern[j];
+			nConversions++;
+			i = j;
+		}
+		return nConversions == 1 ? res : std::string();
+	}
+	// Writes the color PFM file: the header is followed by the RGB floats, bottom row first
+	static bool writePFM(const std::string& fileName, const Mat& img)
+	{
+		FILE* pFile = fopen(fileName.c_str(), "wb");
+		if (!pFile) return false;
+		fprintf(pFile, "PF\n%d %d\n-1.0\n", img.cols, img.rows);			// negative scale: little-endian
+		std::vector<float> row(3 * img.cols);
+		for (int y = img.rows - 1; y >= 0; y--) {
+			const Vec3f* pImg = img.ptr<Vec3f>(y);
+			for (int x = 0; x < img.cols; x++) {
+				row[3 * x + 0] = pImg[x].val[2];
+				row[3 * x + 1] = pImg[x].val[1];
+				row[3 * x + 2] = pImg[x].val[0];
+			}
+			if (fwrite(row.data(), sizeof(float), row.size(), pFile) != row.size()) break;
+		}
+		const bool res = !ferror(pFile);
+		return fclose(pFile) == 0 && res;
+	}
+
+
+private:
+	std::string m_pattern;		///< The pattern of the file names
+};
+
+// ================================ Raw Frame Sink Class ================================
+/**
+ * @brief Frame sink, which writes the raw 8-bit BGR pixels into a stream
+ * @details Together with the standard output this allows to pipe the frames into an external encoder, e.g.:
+ * @code
+ * eyden-tracer | ffmpeg -f rawvideo -pix_fmt bgr24 -s 1280x720 -r 30 -i - video.mp4
+ * @endcode
+ * @note The console output of the application has to be redirected elsewhere in this case
+ */
+class CFrameSinkRaw : public IFrameSink
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param pStream The output stream
+	 */
+	CFrameSinkRaw(FILE* pStream = stdout) : m_pStream(pStream) {}
+	virtual ~CFrameSinkRaw(void) { fflush(m_pStream); }
+
+	virtual bool write(const Mat& img, size_t) override
+	{
+		img.convertTo(m_frame, CV_8UC3, 255);
+		for (int y = 0; y < m_frame.rows; y++)
+			if (fwrite(m_frame.ptr(y), 3, m_frame.cols, m_pStream) != static_cast<size_t>(m_frame.cols)) return false;
+		return true;
+	}
+
+
+private:
+	FILE*	m_pStream;		///< The output stream
+	Mat		m_frame;		///< The 8-bit frame buffer
+};
@@ -0,0 +1,151 @@
+// Asynchronous Frame Writer class
+#pragma once
+
+#include "IFrameSink.h"
+#include "Profiler.h"
+#include "MemoryStats.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <tuple>
+
+// ================================ Frame Writer Class ================================
+/**
+ * @brief Asynchronous frame writer class
+ * @details This class passes the rendered frames to the frame sinks (see @ref IFrameSink) in its own output thread. The frames wait in
+ * a bounded queue, thus the rendering of the next frame overlaps with the conversion, encoding and writing of the previous ones.
+ * If the queue is full, push() blocks until the output thread catches up, which limits the memory usage. The queued frames are accounted as
+ * the video subsystem of @ref CMemoryStats and the queue is also considered full, when a further frame would exceed the budget of the subsystem.
+ * @code
+ * CFrameWriter writer(4);
+ * writer.addSink(std::make_shared<CFrameSinkVideo>("video.avi", codec, 30, resolution));
+ * for (size_t frame = 0; frame < nFrames; frame++) {
+ *	engine.render(img);
+ *	writer.push(img, frame);	// returns as soon as the frame is copied into the queue
+ * }
+ * writer.flush();
+ * @endcode
+ */
+class CFrameWriter
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param capacity The maximal number of frames waiting in the queue
+	 */
+	CFrameWriter(size_t capacity = 4) : m_capacity(MAX(1, capacity)), m_thread([this] { run(); }) {}
+	CFrameWriter(const CFrameWriter&) = delete;
+	/**
+	 * @brief Destructor
+	 * @details Writes all the frames, which are still in the queue and joins the output thread
+	 */
+	~CFrameWriter(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_terminate = true;
+		}
+		m_cvNotEmpty.notify_one();
+		m_thread.join();
+	}
+	const CFrameWriter& operator=(const CFrameWriter&) = delete;
+
+	/**
+	 * @brief Adds a new frame sink
+	 * @note The sinks should be added before the first frame is pushed
+	 * @param pSink Pointer to the frame sink
+	 */
+	void addSink(const ptr_frame_sink_t pSink)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_vpSinks.push_back(pSink);
+	}
+	/**
+	 * @brief Adds a copy of the frame \b img to the queue
+	 * @details Blocks while the queue is full
+	 * @param img The rendered frame (type: CV_32FC3)
+	 * @param frame The index of the frame in the animation, which is passed to the sinks (see IFrameSink::write())
+	 */
+	void push(const Mat& img, size_t frame)
+	{
+		Mat copy = img.clone();
+		const size_t bytes = copy.total() * copy.elemSize();
+		auto& stats = CMemoryStats::instance();
+		int64 ticks = getTickCount();
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_cvNotFull.wait(lock, [&] { return m_qFrames.size() < m_capacity && (m_qFrames.empty() || !stats.isOverBudget(CMemoryStats::Subsystem::video, bytes)); });
+		m_stallTime += 1000.0 * (getTickCount() - ticks) / getTickFrequency();
+		stats.add(CMemoryStats::Subsystem::video, static_cast<int64>(bytes));
+		m_qFrames.emplace_back(copy, frame);
+		lock.unlock();
+		m_cvNotEmpty.notify_one();
+	}
+	/**
+	 * @brief Waits until all the frames in the queue are written
+	 */
+	void flush(void)
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_cvNotFull.wait(lock, [this] { return m_qFrames.empty() && !m_busy; });
+	}
+	/**
+	 * @brief Returns the time, which push() spent waiting for free space in the queue
+	 * @return The accumulated waiting time in milliseconds
+	 */
+	double getStallTime(void) const { return m_stallTime; }
+	/**
+	 * @brief Returns the number of frames, which at least one of the sinks could not write
+	 * @note Call flush() before, in order to account all the pushed frames
+	 */
+	size_t getNumFailed(void) const { return m_nFailed; }
+
+
+private:
+	// Output thread loop: passes the frames to the sinks until the writer is destroyed and the queue is empty
+	void run(void)
+	{
+		for (;;) {
+			Mat img;
+			size_t frame;
+			std::vector<ptr_frame_sink_t> vpSinks;
+			{
+				std::unique_lock<std::mutex> lock(m_mtx);
+				m_cvNotEmpty.wait(lock, [this] { return m_terminate || !m_qFrames.empty(); });
+				if (m_qFrames.empty()) return;
+				std::tie(img, frame) = m_qFrames.front();
+				m_qFrames.pop_front();
+				vpSinks = m_vpSinks;
+				m_busy = true;
+			}
+			m_cvNotFull.notify_one();
+			bool success = true;
+			{
+				PROFILE_ZONE("encode");
+				for (auto& pSink : vpSinks)
+					success &= pSink->write(img, frame);
+			}
+			CMemoryStats::instance().add(CMemoryStats::Subsystem::video, -static_cast<int64>(img.total() * img.elemSize()));
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				if (!success) m_nFailed++;
+				m_busy = false;
+			}
+			m_cvNotFull.notify_all();
+		}
+	}
+
+
+private:
+	size_t							m_capacity;				///< The maximal number of frames in the queue
+	std::deque<std::pair<Mat, size_t>>	m_qFrames;			///< The queue of frames to be written with their indices
+	std::vector<ptr_frame_sink_t>	m_vpSinks;				///< The frame sinks
+	std::mutex						m_mtx;					///< Mutex protecting the queue and the sinks
+	std::condition_variable			m_cvNotEmpty;			///< Condition variable notifying the output thread
+	std::condition_variable			m_cvNotFull;			///< Condition variable notifying the producer
+	double							m_stallTime = 0;		///< The time push() spent waiting in milliseconds
+	std::atomic<size_t>				m_nFailed = 0;			///< The number of frames, which were not written by all the sinks
+	bool							m_busy = false;			///< Flag indicating that the output thread is writing a frame
+	bool							m_terminate = false;	///< Flag indicating that the output thread should finish
+	std::thread						m_thread;				///< The output thread
+};
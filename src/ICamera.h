@@ -34,7 +34,39 @@ public:
      * @param[in] sample The x- and y-shifts to the center of the pixel (used for anti-aliasing).
      */
     virtual void InitRay(Ray& ray, int x, int y, const Vec2f& sample) = 0;
+    /**
+     * @brief Initializes the rays passing through the pixels of the region \b region
+     * @details The cameras may override this function in order to generate the rays without a virtual call per pixel.
+     * The default implementation calls InitRay() for every pixel
+     * @param[out] batch The batch of rays, resized to the region
+     * @param[in] region The region of the camera screen
+     * @param[in] sample The x- and y-shifts to the center of the pixels (see InitRay())
+     */
+    virtual void InitRays(RayBatch& batch, const Rect& region, const Vec2f& sample = Vec2f::all(0.5f))
+    {
+        batch.resize(region);
+        Ray ray;
+        size_t i = 0;
+        for (int y = region.y; y < region.y + region.height; y++)
+            for (int x = region.x; x < region.x + region.width; x++, i++) {
+                InitRay(ray, x, y, sample);
+                batch.orgX[i] = ray.org.val[0];
+                batch.orgY[i] = ray.org.val[1];
+                batch.orgZ[i] = ray.org.val[2];
+                batch.dirX[i] = ray.dir.val[0];
+                batch.dirY[i] = ray.dir.val[1];
+                batch.dirZ[i] = ray.dir.val[2];
+            }
+    }
 
+    /**
+     * @brief Projects the point \b point onto the camera screen
+     * @details This is the inverse of InitRay(): the ray through the returned pixel coordinates passes through the point
+     * @param point The point in WCS
+     * @return The continuous pixel coordinates x, y and the distance from the camera origin to the point, or std::nullopt
+     * if the point is behind the camera or the camera does not support the projection
+     */
+    virtual std::optional<Vec3f> project([[maybe_unused]] const Vec3f& point) const { return std::nullopt; }
     /**
      * @brief Retuns the camera resolution in pixels
      * @return The camera resolution in pixels
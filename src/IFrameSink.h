@@ -0,0 +1,29 @@
+#pragma once
+
+#include "types.h"
+
+// ================================ Frame Sink Interface Class ================================
+/**
+ * @brief Base frame sink abstract interface class
+ * @details A frame sink receives the rendered frames one after another, e.g. in order to encode them into a video, to show them on the screen
+ * or to store them in files. The sinks are called from the output thread of @ref CFrameWriter, one frame at a time
+ */
+class IFrameSink
+{
+public:
+	IFrameSink(void) = default;
+	IFrameSink(const IFrameSink&) = delete;
+	virtual ~IFrameSink(void) = default;
+	const IFrameSink& operator=(const IFrameSink&) = delete;
+
+	/**
+	 * @brief Consumes a frame
+	 * @param img The rendered frame (type: CV_32FC3) with the color values in range [0; 1]
+	 * @param frame The index of the frame
+	 * @retval true If the frame was consumed
+	 * @retval false If the frame could not be written
+	 */
+	virtual bool write(const Mat& img, size_t frame) = 0;
+};
+
+using ptr_frame_sink_t = std::shared_ptr<IFrameSink>;
@@ -47,6 +47,12 @@ public:
 	 * @param T Transformation matrix (size: 4 x 4; type: CV_32FC1)
 	 */
 	virtual void transform(const Mat& T) = 0;
+	/**
+	 * @brief Creates a copy of the primitive
+	 * @details The copy shares the shader with the original primitive
+	 * @return Pointer to the new primitive
+	 */
+	virtual std::shared_ptr<IPrim> clone(void) const = 0;
 	/**
 	 * @brief Returns the normalized normal vector of the primitive in the ray - primitive intercection point
 	 * @param ray Ray pointing at the surface
@@ -59,6 +65,15 @@ public:
 	 * @return The texture coordinates
 	 */
 	virtual Vec2f getTextureCoords(const Ray& ray) const = 0;
+	/**
+	 * @brief Returns the surface point with the surface coordinates \b u and \b v
+	 * @details The surface coordinates (see Ray::u and Ray::v) do not change, when the primitive is transformed, thus they allow to follow
+	 * a hit point from one frame of an animation to the next one
+	 * @param u The first surface coordinate
+	 * @param v The second surface coordinate
+	 * @return The point in WCS or std::nullopt if the primitive does not provide the surface coordinates
+	 */
+	virtual std::optional<Vec3f> getSurfacePoint([[maybe_unused]] float u, [[maybe_unused]] float v) const { return std::nullopt; }
 	/**
 	 * @brief Returns the minimum axis-aligned bounding box, which contain the primitive
 	 * @returns The bounding box, which contain the primitive
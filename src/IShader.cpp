@@ -0,0 +1,12 @@
+#include "IShader.h"
+#include "ShadowQuery.h"
+
+void IShader::shadeBatch(const Ray* const* ppRays, size_t n, Vec3f* pColors, std::vector<ShadowQuery>& vShadows) const
+{
+	for (size_t i = 0; i < n; i++) {
+		size_t nShadows = vShadows.size();
+		pColors[i] = shadeDeferred(*ppRays[i], vShadows);
+		for (size_t s = nShadows; s < vShadows.size(); s++)
+			vShadows[s].id = i;
+	}
+}
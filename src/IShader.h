@@ -5,6 +5,7 @@
 #include "types.h"
 
 struct Ray;
+struct ShadowQuery;
 // ================================ Shader Interface Class ================================
 /**
  * @brief Basic shader abstract interface class
@@ -24,6 +25,27 @@ public:
 	 * @return The color of the hit objesct
 	 */
 	virtual Vec3f shade(const Ray& ray) const = 0;
+	/**
+	 * @brief Calculates the color of the hit by the ray \b ray object, deferring the shadow tests
+	 * @details Instead of tracing the shadow rays immediately, the shader appends the light contributions, which depend on the visibility of the light sources,
+	 * to \b vShadows. The caller has to trace the shadow rays and add the contributions of the non-occluded queries to the returned color, clamping the sum to 1.
+	 * The default implementation does not use shadows and calls shade()
+	 * @param[in] ray The ray hitting the primitive. ray.hit must point to the primitive
+	 * @param[in,out] vShadows The container for the shadow queries
+	 * @return The color of the hit object without the contributions, which are deferred to \b vShadows
+	 */
+	virtual Vec3f shadeDeferred(const Ray& ray, [[maybe_unused]] std::vector<ShadowQuery>& vShadows) const { return shade(ray); }
+	/**
+	 * @brief Calculates the colors of a batch of hits, deferring the shadow tests
+	 * @details This is the batch version of shadeDeferred(), which allows the shaders to process many hits at once with SIMD instructions.
+	 * The identifiers of the appended shadow queries (ShadowQuery::id) are set to the indices of the corresponding hits in the batch.
+	 * The default implementation calls shadeDeferred() for every hit
+	 * @param[in] ppRays Array of pointers to the rays hitting the primitives with this shader
+	 * @param[in] n The number of rays in the batch
+	 * @param[out] pColors Array of \b n colors, which receive the colors of the hits without the deferred contributions
+	 * @param[in,out] vShadows The container for the shadow queries
+	 */
+	virtual void shadeBatch(const Ray* const* ppRays, size_t n, Vec3f* pColors, std::vector<ShadowQuery>& vShadows) const;
 };
 
 using ptr_shader_t = std::shared_ptr<IShader>;
@@ -0,0 +1,95 @@
+// Table of the hot kernels compiled for one instruction set
+#pragma once
+
+#include <cstddef>
+
+// ================================ Phong Arrays Structure ================================
+/**
+ * @brief Raw pointers to the arrays of the shading samples (see PhongSamples)
+ * @details The kernels see only plain floats, so that the translation units compiled for the wider instruction sets
+ * do not instantiate any inline function shared with the rest of the program
+ */
+struct PhongArrays
+{
+	const float*	normal[3];		///< Shading normal, turned to the front
+	const float*	reflect[3];		///< Normalized reflection vector of the primary ray
+	const float*	light[3];		///< Normalized direction from the surface point to the light source
+	const float*	intensity[3];	///< Intensity of the light source at the surface point (including the sampling weight)
+	const float*	color[3];		///< Base color of the surface
+	float*			result[3];		///< Contribution of the light source
+	float*			cosLN;			///< Cosine between the normal and the light direction
+};
+
+// ================================ Raster Span Structure ================================
+/**
+ * @brief The edge functions of a triangle along a row of pixels and raw pointers to the row of the visibility buffer (see CRasterizer)
+ * @details Every function f(x) = a * (x + 0.5) + b of the pixel x is stored as {a, b}. The visibility buffer is a structure of arrays,
+ * so that the kernels load and store whole blocks of pixels
+ */
+struct RasterSpan
+{
+	float			det[2];			///< The denominator of the barycentric coordinates
+	float			u[2];			///< The numerator of the barycentric coordinate u
+	float			v[2];			///< The numerator of the barycentric coordinate v
+	float			s;				///< The numerator of the ray parameter
+	int				prim;			///< The index of the triangle
+	const float*	dirLength;		///< The lengths of the unnormalized ray directions of the pixels
+	int*			hitPrim;		///< The indices of the visible triangles (-1 - none)
+	float*			hitU;			///< The barycentric coordinates of the visible hits
+	float*			hitV;
+	float*			hitT;			///< The hit distances
+};
+
+// ================================ Kernel Table Structure ================================
+/**
+ * @brief The hot kernels compiled for one instruction set
+ * @details Every variant is built from src/KernelsImpl.h in its own translation unit with the compiler flags of its instruction set.
+ * The table matching the CPU is selected once at startup (see @ref CCpuDispatch)
+ */
+struct KernelTable
+{
+	const char* name;	///< The name of the instruction set
+	/**
+	 * @brief Evaluates the diffuse and specular Phong terms for \b n samples (see PhongKernel::illuminate())
+	 */
+	void (*illuminate)(const PhongArrays& samples, size_t n, float kd, float ks, float ke);
+	/**
+	 * @brief Rasterizes the pixels [\b x0; \b x1) of the span with the depth test (see CRasterizer::rasterize())
+	 * @details A pixel is covered, if its determinant is not below \b eps times the length of its ray direction, the barycentric coordinates
+	 * lie inside the triangle and the hit distance lies in [\b eps; \b hitT)
+	 */
+	void (*rasterize)(const RasterSpan& span, int x0, int x1, float eps);
+	/**
+	 * @brief Clips the interval [\b t0; \b t1] of the ray to the slabs of the box (see CBoundingBox::clip())
+	 * @details The box and the ray are passed as arrays of 3 floats
+	 */
+	void (*clip)(const float* minPoint, const float* maxPoint, const float* org, const float* dir, double& t0, double& t1);
+	/**
+	 * @brief Möller–Trumbore test of the ray against the triangle with the vertex \b a and the edges \b edge1 and \b edge2 (see CPrimTriangle::intersect())
+	 * @details The depth test is left to the caller, so that all the arguments are passed in registers
+	 * @param[out] uv The barycentric coordinates of the hit
+	 * @return The hit distance or 0 if the ray misses the triangle or its determinant is below \b eps
+	 */
+	float (*intersectTriangle)(const float* a, const float* edge1, const float* edge2, const float* org, const float* dir, float eps, float* uv);
+};
+
+/**
+ * @brief Returns the kernels compiled for the baseline instruction set of the target
+ * @return The kernel table, which is always available
+ */
+const KernelTable* getKernelsBaseline(void);
+/**
+ * @brief Returns the kernels compiled for SSE4.2
+ * @return The kernel table or nullptr if the compiler did not build the variant
+ */
+const KernelTable* getKernelsSSE42(void);
+/**
+ * @brief Returns the kernels compiled for AVX2 and FMA
+ * @return The kernel table or nullptr if the compiler did not build the variant
+ */
+const KernelTable* getKernelsAVX2(void);
+/**
+ * @brief Returns the kernels compiled for AVX-512
+ * @return The kernel table or nullptr if the compiler did not build the variant
+ */
+const KernelTable* getKernelsAVX512(void);
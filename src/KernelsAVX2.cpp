@@ -0,0 +1,17 @@
+// AVX2 variant of the hot kernels, compiled with -mavx2 -mfma -ffp-contract=off (see CMakeLists.txt)
+#include "Kernels.h"
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))	// MSVC implies FMA with /arch:AVX2
+#define KERNELS_ISA "avx2"
+#include "KernelsImpl.h"
+
+const KernelTable* getKernelsAVX2(void)
+{
+	return &table;
+}
+#else
+const KernelTable* getKernelsAVX2(void)
+{
+	return nullptr;
+}
+#endif
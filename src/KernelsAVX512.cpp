@@ -0,0 +1,17 @@
+// AVX-512 variant of the hot kernels, compiled with -mavx512f (see CMakeLists.txt)
+#include "Kernels.h"
+
+#if defined(__AVX512F__)
+#define KERNELS_ISA "avx512"
+#include "KernelsImpl.h"
+
+const KernelTable* getKernelsAVX512(void)
+{
+	return &table;
+}
+#else
+const KernelTable* getKernelsAVX512(void)
+{
+	return nullptr;
+}
+#endif
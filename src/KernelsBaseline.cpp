@@ -0,0 +1,14 @@
+// Baseline variant of the hot kernels, compiled without any architecture flags
+#include "PhongKernel.h"
+#define KERNELS_ISA "baseline"
+#include "KernelsImpl.h"
+
+const KernelTable* getKernelsBaseline(void)
+{
+	return &table;
+}
+
+float PhongKernel::fastPow(float x, float e)
+{
+	return ::fastPow(x, e);
+}
@@ -0,0 +1,401 @@
+// Implementation of the hot kernels for the instruction set of the including translation unit
+// This file is included only by the src/Kernels*.cpp files, each of them compiled with the flags of its instruction set (see CMakeLists.txt).
+// Everything here has internal linkage and uses only plain floats and compiler intrinsics, so that no code compiled for a wider
+// instruction set may be merged by the linker into the functions used by the rest of the program
+#pragma once
+
+#include "Kernels.h"
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE4_1__) || defined(KERNELS_SSE4)
+#include <immintrin.h>
+#endif
+
+namespace {
+	// Polynomial approximation of log2(1 + t), t in [0; 1)
+	constexpr float L0 = 3.1807274e-05f;
+	constexpr float L1 = 1.4412689f;
+	constexpr float L2 = -0.70571098f;
+	constexpr float L3 = 0.40873417f;
+	constexpr float L4 = -0.18773214f;
+	constexpr float L5 = 0.043431324f;
+	// Polynomial approximation of 2^f, f in [0; 1)
+	constexpr float E0 = 0.99999983f;
+	constexpr float E1 = 0.69315473f;
+	constexpr float E2 = 0.24014653f;
+	constexpr float E3 = 0.055835902f;
+	constexpr float E4 = 0.0089872969f;
+	constexpr float E5 = 0.0018753732f;
+	// The range of the exponent, where 2^y is a normalized float
+	constexpr float ExpMin = -126.0f;
+	constexpr float ExpMax = 126.0f;
+
+	// Scalar approximation of x^e (see PhongKernel::fastPow())
+	inline float fastPow(float x, float e)
+	{
+		if (x <= 0) return 0;
+		int32_t bits;
+		memcpy(&bits, &x, sizeof(bits));
+		float exponent = static_cast<float>(((bits >> 23) & 0xFF) - 127);
+		int32_t mantissaBits = (bits & 0x007FFFFF) | 0x3F800000;
+		float t;
+		memcpy(&t, &mantissaBits, sizeof(t));
+		t -= 1;
+		float y = e * (exponent + (L0 + t * (L1 + t * (L2 + t * (L3 + t * (L4 + t * L5))))));
+
+		y = y < ExpMin ? ExpMin : y > ExpMax ? ExpMax : y;
+		float i = floorf(y);
+		float f = y - i;
+		int32_t scaleBits = (static_cast<int32_t>(i) + 127) << 23;
+		float scale;
+		memcpy(&scale, &scaleBits, sizeof(scale));
+		return (E0 + f * (E1 + f * (E2 + f * (E3 + f * (E4 + f * E5))))) * scale;
+	}
+
+	// Scalar evaluation of a single sample
+	inline void illuminateSample(const PhongArrays& s, size_t i, float kd, float ks, float ke)
+	{
+		float cosLN = s.light[0][i] * s.normal[0][i] + s.light[1][i] * s.normal[1][i] + s.light[2][i] * s.normal[2][i];
+		float cosLR = s.light[0][i] * s.reflect[0][i] + s.light[1][i] * s.reflect[1][i] + s.light[2][i] * s.reflect[2][i];
+		float diffuse = cosLN > 0 ? kd * cosLN : 0;
+		float specular = cosLR > 0 ? ks * fastPow(cosLR, ke) : 0;
+		for (int c = 0; c < 3; c++)
+			s.result[c][i] = (diffuse * s.color[c][i] + specular) * s.intensity[c][i];
+		s.cosLN[i] = cosLN;
+	}
+
+	// Scalar rasterization of the pixel x
+	inline void rasterizePixel(const RasterSpan& r, int x, float eps)
+	{
+		const float px = x + 0.5f;
+		const float det = r.det[0] * px + r.det[1];
+		if (fabsf(det) < eps * r.dirLength[x]) return;
+		const float inv_det = 1.0f / det;
+		const float u = (r.u[0] * px + r.u[1]) * inv_det;
+		const float v = (r.v[0] * px + r.v[1]) * inv_det;
+		const float t = r.s * inv_det * r.dirLength[x];
+		if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < eps || t >= r.hitT[x]) return;
+		r.hitPrim[x] = r.prim;
+		r.hitU[x] = u;
+		r.hitV[x] = v;
+		r.hitT[x] = t;
+	}
+
+	// Clips [t0; t1] to the slab of the dimension dim; returns false if the interval is empty
+	inline bool clipSlab(const float* minPoint, const float* maxPoint, const float* org, const float* dir, int dim, double& t0, double& t1)
+	{
+		if (dir[dim] == 0) return true;
+		const float den = 1.0f / dir[dim];
+		const float dMin = (minPoint[dim] - org[dim]) * den;
+		const float dMax = (maxPoint[dim] - org[dim]) * den;
+		const float dNear = dir[dim] > 0 ? dMin : dMax;
+		const float dFar = dir[dim] > 0 ? dMax : dMin;
+		if (dNear > t0) t0 = dNear;
+		if (dFar < t1) t1 = dFar;
+		return t0 <= t1;
+	}
+
+	// The ray-box and the ray-triangle tests work on single rays, thus every variant runs the same scalar code, which the compiler
+	// encodes with the instructions of its translation unit. FMA contraction is disabled for these files (see CMakeLists.txt),
+	// so that all the variants are bit-exact with the baseline
+	void clip(const float* minPoint, const float* maxPoint, const float* org, const float* dir, double& t0, double& t1)
+	{
+		if (!clipSlab(minPoint, maxPoint, org, dir, 0, t0, t1)) return;
+		if (!clipSlab(minPoint, maxPoint, org, dir, 1, t0, t1)) return;
+		clipSlab(minPoint, maxPoint, org, dir, 2, t0, t1);
+	}
+
+	float intersectTriangle(const float* a, const float* edge1, const float* edge2, const float* org, const float* dir, float eps, float* uv)
+	{
+		const float pvec[3] = { dir[1] * edge2[2] - dir[2] * edge2[1], dir[2] * edge2[0] - dir[0] * edge2[2], dir[0] * edge2[1] - dir[1] * edge2[0] };
+
+		const float det = edge1[0] * pvec[0] + edge1[1] * pvec[1] + edge1[2] * pvec[2];
+		if (fabsf(det) < eps) return 0;
+
+		const float inv_det = 1.0f / det;
+
+		const float tvec[3] = { org[0] - a[0], org[1] - a[1], org[2] - a[2] };
+		float lambda = tvec[0] * pvec[0] + tvec[1] * pvec[1] + tvec[2] * pvec[2];
+		lambda *= inv_det;
+
+		if (lambda < 0.0f || lambda > 1.0f) return 0;
+
+		const float qvec[3] = { tvec[1] * edge1[2] - tvec[2] * edge1[1], tvec[2] * edge1[0] - tvec[0] * edge1[2], tvec[0] * edge1[1] - tvec[1] * edge1[0] };
+		float mue = dir[0] * qvec[0] + dir[1] * qvec[1] + dir[2] * qvec[2];
+		mue *= inv_det;
+
+		if (mue < 0.0f || mue + lambda > 1.0f) return 0;
+
+		float f = edge2[0] * qvec[0] + edge2[1] * qvec[1] + edge2[2] * qvec[2];
+		f *= inv_det;
+		uv[0] = lambda;
+		uv[1] = mue;
+		return f;
+	}
+
+	// The vector variants below evaluate the edge functions with separate multiplications and additions (no FMA),
+	// so that the visibility buffer is bit-exact with rasterizePixel()
+#if defined(__AVX512F__)
+	constexpr size_t Lanes = 16;
+
+	inline __m512 log2(__m512 x)
+	{
+		__m512i bits = _mm512_castps_si512(x);
+		__m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+		__m512 t = _mm512_sub_ps(_mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F800000))), _mm512_set1_ps(1));
+		__m512 p = _mm512_fmadd_ps(t, _mm512_set1_ps(L5), _mm512_set1_ps(L4));
+		p = _mm512_fmadd_ps(t, p, _mm512_set1_ps(L3));
+		p = _mm512_fmadd_ps(t, p, _mm512_set1_ps(L2));
+		p = _mm512_fmadd_ps(t, p, _mm512_set1_ps(L1));
+		p = _mm512_fmadd_ps(t, p, _mm512_set1_ps(L0));
+		return _mm512_add_ps(e, p);
+	}
+
+	inline __m512 exp2(__m512 y)
+	{
+		y = _mm512_min_ps(_mm512_max_ps(y, _mm512_set1_ps(ExpMin)), _mm512_set1_ps(ExpMax));
+		__m512 i = _mm512_roundscale_ps(y, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		__m512 f = _mm512_sub_ps(y, i);
+		__m512 p = _mm512_fmadd_ps(f, _mm512_set1_ps(E5), _mm512_set1_ps(E4));
+		p = _mm512_fmadd_ps(f, p, _mm512_set1_ps(E3));
+		p = _mm512_fmadd_ps(f, p, _mm512_set1_ps(E2));
+		p = _mm512_fmadd_ps(f, p, _mm512_set1_ps(E1));
+		p = _mm512_fmadd_ps(f, p, _mm512_set1_ps(E0));
+		__m512i scale = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(i), _mm512_set1_epi32(127)), 23);
+		return _mm512_mul_ps(p, _mm512_castsi512_ps(scale));
+	}
+
+	// Evaluates 16 samples starting with sample i
+	inline void illuminateLanes(const PhongArrays& s, size_t i, float kd, float ks, float ke)
+	{
+		__m512 cosLN = _mm512_mul_ps(_mm512_loadu_ps(&s.light[0][i]), _mm512_loadu_ps(&s.normal[0][i]));
+		cosLN = _mm512_fmadd_ps(_mm512_loadu_ps(&s.light[1][i]), _mm512_loadu_ps(&s.normal[1][i]), cosLN);
+		cosLN = _mm512_fmadd_ps(_mm512_loadu_ps(&s.light[2][i]), _mm512_loadu_ps(&s.normal[2][i]), cosLN);
+		__m512 cosLR = _mm512_mul_ps(_mm512_loadu_ps(&s.light[0][i]), _mm512_loadu_ps(&s.reflect[0][i]));
+		cosLR = _mm512_fmadd_ps(_mm512_loadu_ps(&s.light[1][i]), _mm512_loadu_ps(&s.reflect[1][i]), cosLR);
+		cosLR = _mm512_fmadd_ps(_mm512_loadu_ps(&s.light[2][i]), _mm512_loadu_ps(&s.reflect[2][i]), cosLR);
+
+		__mmask16 diffuseMask = _mm512_cmp_ps_mask(cosLN, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__mmask16 specularMask = _mm512_cmp_ps_mask(cosLR, _mm512_setzero_ps(), _CMP_GT_OQ);
+		__m512 diffuse = _mm512_maskz_mul_ps(diffuseMask, cosLN, _mm512_set1_ps(kd));
+		__m512 specular = _mm512_setzero_ps();
+		if (ks != 0 && specularMask)
+			specular = _mm512_maskz_mul_ps(specularMask, exp2(_mm512_mul_ps(_mm512_set1_ps(ke), log2(cosLR))), _mm512_set1_ps(ks));
+
+		for (int c = 0; c < 3; c++) {
+			__m512 res = _mm512_fmadd_ps(diffuse, _mm512_loadu_ps(&s.color[c][i]), specular);
+			_mm512_storeu_ps(&s.result[c][i], _mm512_mul_ps(res, _mm512_loadu_ps(&s.intensity[c][i])));
+		}
+		_mm512_storeu_ps(&s.cosLN[i], cosLN);
+	}
+
+	// Rasterizes 16 pixels starting with pixel x
+	inline void rasterizeLanes(const RasterSpan& r, int x, float eps)
+	{
+		__m512 px = _mm512_add_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(x), _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0))), _mm512_set1_ps(0.5f));
+		__m512 len = _mm512_loadu_ps(&r.dirLength[x]);
+		__m512 det = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r.det[0]), px), _mm512_set1_ps(r.det[1]));
+		__mmask16 mask = _mm512_cmp_ps_mask(_mm512_abs_ps(det), _mm512_mul_ps(_mm512_set1_ps(eps), len), _CMP_NLT_UQ);
+		if (!mask) return;
+		__m512 inv_det = _mm512_div_ps(_mm512_set1_ps(1.0f), det);
+		__m512 u = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r.u[0]), px), _mm512_set1_ps(r.u[1])), inv_det);
+		__m512 v = _mm512_mul_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(r.v[0]), px), _mm512_set1_ps(r.v[1])), inv_det);
+		__m512 t = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(r.s), inv_det), len);
+		mask = _mm512_mask_cmp_ps_mask(mask, u, _mm512_setzero_ps(), _CMP_NLT_UQ);
+		mask = _mm512_mask_cmp_ps_mask(mask, v, _mm512_setzero_ps(), _CMP_NLT_UQ);
+		mask = _mm512_mask_cmp_ps_mask(mask, _mm512_add_ps(u, v), _mm512_set1_ps(1.0f), _CMP_NGT_UQ);
+		mask = _mm512_mask_cmp_ps_mask(mask, t, _mm512_set1_ps(eps), _CMP_NLT_UQ);
+		mask = _mm512_mask_cmp_ps_mask(mask, t, _mm512_loadu_ps(&r.hitT[x]), _CMP_NGE_UQ);
+		_mm512_mask_storeu_epi32(&r.hitPrim[x], mask, _mm512_set1_epi32(r.prim));
+		_mm512_mask_storeu_ps(&r.hitU[x], mask, u);
+		_mm512_mask_storeu_ps(&r.hitV[x], mask, v);
+		_mm512_mask_storeu_ps(&r.hitT[x], mask, t);
+	}
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+	constexpr size_t Lanes = 8;
+
+	inline __m256 log2(__m256 x)
+	{
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+		__m256 t = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000))), _mm256_set1_ps(1));
+		__m256 p = _mm256_fmadd_ps(t, _mm256_set1_ps(L5), _mm256_set1_ps(L4));
+		p = _mm256_fmadd_ps(t, p, _mm256_set1_ps(L3));
+		p = _mm256_fmadd_ps(t, p, _mm256_set1_ps(L2));
+		p = _mm256_fmadd_ps(t, p, _mm256_set1_ps(L1));
+		p = _mm256_fmadd_ps(t, p, _mm256_set1_ps(L0));
+		return _mm256_add_ps(e, p);
+	}
+
+	inline __m256 exp2(__m256 y)
+	{
+		y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(ExpMin)), _mm256_set1_ps(ExpMax));
+		__m256 i = _mm256_floor_ps(y);
+		__m256 f = _mm256_sub_ps(y, i);
+		__m256 p = _mm256_fmadd_ps(f, _mm256_set1_ps(E5), _mm256_set1_ps(E4));
+		p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(E3));
+		p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(E2));
+		p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(E1));
+		p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(E0));
+		__m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(i), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+	}
+
+	// Evaluates 8 samples starting with sample i
+	inline void illuminateLanes(const PhongArrays& s, size_t i, float kd, float ks, float ke)
+	{
+		__m256 cosLN = _mm256_mul_ps(_mm256_loadu_ps(&s.light[0][i]), _mm256_loadu_ps(&s.normal[0][i]));
+		cosLN = _mm256_fmadd_ps(_mm256_loadu_ps(&s.light[1][i]), _mm256_loadu_ps(&s.normal[1][i]), cosLN);
+		cosLN = _mm256_fmadd_ps(_mm256_loadu_ps(&s.light[2][i]), _mm256_loadu_ps(&s.normal[2][i]), cosLN);
+		__m256 cosLR = _mm256_mul_ps(_mm256_loadu_ps(&s.light[0][i]), _mm256_loadu_ps(&s.reflect[0][i]));
+		cosLR = _mm256_fmadd_ps(_mm256_loadu_ps(&s.light[1][i]), _mm256_loadu_ps(&s.reflect[1][i]), cosLR);
+		cosLR = _mm256_fmadd_ps(_mm256_loadu_ps(&s.light[2][i]), _mm256_loadu_ps(&s.reflect[2][i]), cosLR);
+
+		__m256 diffuseMask = _mm256_cmp_ps(cosLN, _mm256_setzero_ps(), _CMP_GT_OQ);
+		__m256 specularMask = _mm256_cmp_ps(cosLR, _mm256_setzero_ps(), _CMP_GT_OQ);
+		__m256 diffuse = _mm256_and_ps(diffuseMask, _mm256_mul_ps(cosLN, _mm256_set1_ps(kd)));
+		__m256 specular = _mm256_setzero_ps();
+		if (ks != 0 && _mm256_movemask_ps(specularMask))
+			specular = _mm256_and_ps(specularMask, _mm256_mul_ps(exp2(_mm256_mul_ps(_mm256_set1_ps(ke), log2(cosLR))), _mm256_set1_ps(ks)));
+
+		for (int c = 0; c < 3; c++) {
+			__m256 res = _mm256_fmadd_ps(diffuse, _mm256_loadu_ps(&s.color[c][i]), specular);
+			_mm256_storeu_ps(&s.result[c][i], _mm256_mul_ps(res, _mm256_loadu_ps(&s.intensity[c][i])));
+		}
+		_mm256_storeu_ps(&s.cosLN[i], cosLN);
+	}
+
+	// Rasterizes 8 pixels starting with pixel x
+	inline void rasterizeLanes(const RasterSpan& r, int x, float eps)
+	{
+		__m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))), _mm256_set1_ps(0.5f));
+		__m256 len = _mm256_loadu_ps(&r.dirLength[x]);
+		__m256 det = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r.det[0]), px), _mm256_set1_ps(r.det[1]));
+		__m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), det), _mm256_mul_ps(_mm256_set1_ps(eps), len), _CMP_NLT_UQ);
+		if (!_mm256_movemask_ps(mask)) return;
+		__m256 inv_det = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r.u[0]), px), _mm256_set1_ps(r.u[1])), inv_det);
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(r.v[0]), px), _mm256_set1_ps(r.v[1])), inv_det);
+		__m256 t = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(r.s), inv_det), len);
+		__m256 depth = _mm256_loadu_ps(&r.hitT[x]);
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_NLT_UQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NLT_UQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_NGT_UQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(eps), _CMP_NLT_UQ));
+		mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, depth, _CMP_NGE_UQ));
+		if (!_mm256_movemask_ps(mask)) return;
+		__m256 prim = _mm256_castsi256_ps(_mm256_set1_epi32(r.prim));
+		float* pHitPrim = reinterpret_cast<float*>(&r.hitPrim[x]);
+		_mm256_storeu_ps(pHitPrim, _mm256_blendv_ps(_mm256_loadu_ps(pHitPrim), prim, mask));
+		_mm256_storeu_ps(&r.hitU[x], _mm256_blendv_ps(_mm256_loadu_ps(&r.hitU[x]), u, mask));
+		_mm256_storeu_ps(&r.hitV[x], _mm256_blendv_ps(_mm256_loadu_ps(&r.hitV[x]), v, mask));
+		_mm256_storeu_ps(&r.hitT[x], _mm256_blendv_ps(depth, t, mask));
+	}
+#elif defined(__SSE4_1__) || defined(KERNELS_SSE4)
+	constexpr size_t Lanes = 4;
+
+	inline __m128 log2(__m128 x)
+	{
+		__m128i bits = _mm_castps_si128(x);
+		__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+		__m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))), _mm_set1_ps(1));
+		__m128 p = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(L5)), _mm_set1_ps(L4));
+		p = _mm_add_ps(_mm_mul_ps(t, p), _mm_set1_ps(L3));
+		p = _mm_add_ps(_mm_mul_ps(t, p), _mm_set1_ps(L2));
+		p = _mm_add_ps(_mm_mul_ps(t, p), _mm_set1_ps(L1));
+		p = _mm_add_ps(_mm_mul_ps(t, p), _mm_set1_ps(L0));
+		return _mm_add_ps(e, p);
+	}
+
+	inline __m128 exp2(__m128 y)
+	{
+		y = _mm_min_ps(_mm_max_ps(y, _mm_set1_ps(ExpMin)), _mm_set1_ps(ExpMax));
+		__m128 i = _mm_floor_ps(y);
+		__m128 f = _mm_sub_ps(y, i);
+		__m128 p = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(E5)), _mm_set1_ps(E4));
+		p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(E3));
+		p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(E2));
+		p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(E1));
+		p = _mm_add_ps(_mm_mul_ps(f, p), _mm_set1_ps(E0));
+		__m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(i), _mm_set1_epi32(127)), 23);
+		return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+	}
+
+	// Evaluates 4 samples starting with sample i
+	inline void illuminateLanes(const PhongArrays& s, size_t i, float kd, float ks, float ke)
+	{
+		__m128 cosLN = _mm_mul_ps(_mm_loadu_ps(&s.light[0][i]), _mm_loadu_ps(&s.normal[0][i]));
+		cosLN = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.light[1][i]), _mm_loadu_ps(&s.normal[1][i])), cosLN);
+		cosLN = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.light[2][i]), _mm_loadu_ps(&s.normal[2][i])), cosLN);
+		__m128 cosLR = _mm_mul_ps(_mm_loadu_ps(&s.light[0][i]), _mm_loadu_ps(&s.reflect[0][i]));
+		cosLR = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.light[1][i]), _mm_loadu_ps(&s.reflect[1][i])), cosLR);
+		cosLR = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s.light[2][i]), _mm_loadu_ps(&s.reflect[2][i])), cosLR);
+
+		__m128 diffuseMask = _mm_cmpgt_ps(cosLN, _mm_setzero_ps());
+		__m128 specularMask = _mm_cmpgt_ps(cosLR, _mm_setzero_ps());
+		__m128 diffuse = _mm_and_ps(diffuseMask, _mm_mul_ps(cosLN, _mm_set1_ps(kd)));
+		__m128 specular = _mm_setzero_ps();
+		if (ks != 0 && _mm_movemask_ps(specularMask))
+			specular = _mm_and_ps(specularMask, _mm_mul_ps(exp2(_mm_mul_ps(_mm_set1_ps(ke), log2(cosLR))), _mm_set1_ps(ks)));
+
+		for (int c = 0; c < 3; c++) {
+			__m128 res = _mm_add_ps(_mm_mul_ps(diffuse, _mm_loadu_ps(&s.color[c][i])), specular);
+			_mm_storeu_ps(&s.result[c][i], _mm_mul_ps(res, _mm_loadu_ps(&s.intensity[c][i])));
+		}
+		_mm_storeu_ps(&s.cosLN[i], cosLN);
+	}
+
+	// Rasterizes 4 pixels starting with pixel x
+	inline void rasterizeLanes(const RasterSpan& r, int x, float eps)
+	{
+		__m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(0.5f));
+		__m128 len = _mm_loadu_ps(&r.dirLength[x]);
+		__m128 det = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r.det[0]), px), _mm_set1_ps(r.det[1]));
+		__m128 mask = _mm_cmpnlt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_mul_ps(_mm_set1_ps(eps), len));
+		if (!_mm_movemask_ps(mask)) return;
+		__m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r.u[0]), px), _mm_set1_ps(r.u[1])), inv_det);
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r.v[0]), px), _mm_set1_ps(r.v[1])), inv_det);
+		__m128 t = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(r.s), inv_det), len);
+		__m128 depth = _mm_loadu_ps(&r.hitT[x]);
+		mask = _mm_and_ps(mask, _mm_cmpnlt_ps(u, _mm_setzero_ps()));
+		mask = _mm_and_ps(mask, _mm_cmpnlt_ps(v, _mm_setzero_ps()));
+		mask = _mm_and_ps(mask, _mm_cmpngt_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		mask = _mm_and_ps(mask, _mm_cmpnlt_ps(t, _mm_set1_ps(eps)));
+		mask = _mm_and_ps(mask, _mm_cmpnge_ps(t, depth));
+		if (!_mm_movemask_ps(mask)) return;
+		__m128 prim = _mm_castsi128_ps(_mm_set1_epi32(r.prim));
+		float* pHitPrim = reinterpret_cast<float*>(&r.hitPrim[x]);
+		_mm_storeu_ps(pHitPrim, _mm_blendv_ps(_mm_loadu_ps(pHitPrim), prim, mask));
+		_mm_storeu_ps(&r.hitU[x], _mm_blendv_ps(_mm_loadu_ps(&r.hitU[x]), u, mask));
+		_mm_storeu_ps(&r.hitV[x], _mm_blendv_ps(_mm_loadu_ps(&r.hitV[x]), v, mask));
+		_mm_storeu_ps(&r.hitT[x], _mm_blendv_ps(depth, t, mask));
+	}
+#else
+	constexpr size_t Lanes = 1;
+
+	inline void illuminateLanes(const PhongArrays& s, size_t i, float kd, float ks, float ke) { illuminateSample(s, i, kd, ks, ke); }
+	inline void rasterizeLanes(const RasterSpan& r, int x, float eps) { rasterizePixel(r, x, eps); }
+#endif
+
+	void illuminate(const PhongArrays& samples, size_t n, float kd, float ks, float ke)
+	{
+		size_t i = 0;
+		for (; i + Lanes <= n; i += Lanes)
+			illuminateLanes(samples, i, kd, ks, ke);
+		for (; i < n; i++)
+			illuminateSample(samples, i, kd, ks, ke);
+	}
+
+	void rasterize(const RasterSpan& span, int x0, int x1, float eps)
+	{
+		int x = x0;
+		for (; x + static_cast<int>(Lanes) <= x1; x += static_cast<int>(Lanes))
+			rasterizeLanes(span, x, eps);
+		for (; x < x1; x++)
+			rasterizePixel(span, x, eps);
+	}
+
+	const KernelTable table = { KERNELS_ISA, illuminate, rasterize, clip, intersectTriangle };
+}
@@ -0,0 +1,18 @@
+// SSE4.2 variant of the hot kernels, compiled with -msse4.2 (see CMakeLists.txt)
+#include "Kernels.h"
+
+#if defined(__SSE4_2__) || (defined(_MSC_VER) && defined(_M_X64))	// MSVC has no flag for SSE4.2, but accepts its intrinsics
+#define KERNELS_ISA "sse4.2"
+#define KERNELS_SSE4
+#include "KernelsImpl.h"
+
+const KernelTable* getKernelsSSE42(void)
+{
+	return &table;
+}
+#else
+const KernelTable* getKernelsSSE42(void)
+{
+	return nullptr;
+}
+#endif
@@ -39,6 +39,16 @@ public:
 	 * @param org The position (origin) of the light source
 	 */
 	virtual void	setOrigin(const Vec3f& org) { m_org = org; }
+	/**
+	 * @brief Returns light source position (origin)
+	 * @return The position (origin) of the light source
+	 */
+	Vec3f			getOrigin(void) const { return m_org; }
+	/**
+	 * @brief Returns the emission of the light source
+	 * @return The emission color and strength of the light source
+	 */
+	Vec3f			getIntensity(void) const { return m_intensity; }
 
 
 private:
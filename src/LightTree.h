@@ -0,0 +1,254 @@
+// Light Tree class
+#pragma once
+
+#include "LightOmni.h"
+#include "BoundingBox.h"
+#include "random.h"
+
+// ================================ Light Tree Class ================================
+/**
+ * @brief Light tree class
+ * @details This is a bounding volume hierarchy over the point light sources of the scene. Every node of the tree stores the bounding box
+ * of its light sources together with their total power, which gives an upper bound on the \f$ 1/r^2 \f$ attenuated contribution of the node
+ * to a surface point. The tree supports two modes:
+ * - \a Exact mode (default): all the light sources are visited, except those whose attenuated contribution falls below the culling threshold.
+ * Whole sub-trees are culled at once, thus the shading cost grows sublinearly with the number of lights.
+ * - \a Stochastic mode: a fixed number of light sources is chosen per shading point with probabilities proportional to their importance.
+ * The contributions are weighted with the inverse probabilities, thus the estimation stays unbiased.
+ *
+ * The light sources which are not point lights can not be bounded and are always visited.
+ * @note The tree stores the light positions at the moment of the build; if the light sources are moved, the tree must be re-built
+ */
+class CLightTree
+{
+public:
+	CLightTree(void) = default;
+	CLightTree(const CLightTree&) = delete;
+	~CLightTree(void) = default;
+	const CLightTree& operator=(const CLightTree&) = delete;
+
+	/**
+	 * @brief Builds the tree for the light sources provided via \b vpLights
+	 * @param vpLights The vector of pointers to the light sources in the scene
+	 */
+	void build(const std::vector<ptr_light_t>& vpLights)
+	{
+		m_vNodes.clear();
+		m_vpLights.clear();
+		m_vpOtherLights.clear();
+		m_vOrigins.clear();
+		m_vPowers.clear();
+
+		for (auto& pLight : vpLights) {
+			auto pOmni = std::dynamic_pointer_cast<CLightOmni>(pLight);
+			if (pOmni) {
+				Vec3f intensity = pOmni->getIntensity();
+				m_vpLights.push_back(pLight);
+				m_vOrigins.push_back(pOmni->getOrigin());
+				m_vPowers.push_back(MAX(intensity.val[0], MAX(intensity.val[1], intensity.val[2])));
+			}
+			else
+				m_vpOtherLights.push_back(pLight);
+		}
+
+		if (!m_vpLights.empty()) {
+			std::vector<size_t> vIdx(m_vpLights.size());
+			for (size_t i = 0; i < vIdx.size(); i++) vIdx[i] = i;
+			build(vIdx, 0, vIdx.size());
+
+			// reorder the lights to match the leaf ranges
+			std::vector<ptr_light_t> vpLights(vIdx.size());
+			std::vector<Vec3f> vOrigins(vIdx.size());
+			std::vector<float> vPowers(vIdx.size());
+			for (size_t i = 0; i < vIdx.size(); i++) {
+				vpLights[i] = m_vpLights[vIdx[i]];
+				vOrigins[i] = m_vOrigins[vIdx[i]];
+				vPowers[i] = m_vPowers[vIdx[i]];
+			}
+			m_vpLights.swap(vpLights);
+			m_vOrigins.swap(vOrigins);
+			m_vPowers.swap(vPowers);
+		}
+	}
+	/**
+	 * @brief Visits the light sources, which illuminate the point \b p
+	 * @details The callback function \b fn is called for every selected light source as fn(ILight& light, float weight).
+	 * The light's contribution should be multiplied with the \a weight, which is 1 in the exact mode.
+	 * @param p The point to be illuminated
+	 * @param fn The callback function
+	 */
+	template <typename F>
+	void forEachLight(const Vec3f& p, F&& fn) const
+	{
+		for (auto& pLight : m_vpOtherLights)
+			fn(*pLight, 1.0f);
+		if (m_vNodes.empty()) return;
+
+		if (m_nSamples == 0) visit(0, p, fn);
+		else {
+			const float weight = 1.0f / m_nSamples;
+			for (size_t s = 0; s < m_nSamples; s++) {
+				float pdf;
+				size_t l = sample(p, pdf);
+				if (pdf > 0) fn(*m_vpLights[l], weight / pdf);
+			}
+		}
+	}
+	/**
+	 * @brief Sets the culling threshold for the exact mode
+	 * @param threshold The light sources, whose attenuated intensity (intensity / distance^2) at the shading point is below this threshold, are skipped.
+	 * Zero value disables culling
+	 */
+	void setThreshold(float threshold) { m_threshold = threshold; }
+	/**
+	 * @brief Sets the number of light samples per shading point
+	 * @param nSamples The number of stochastically chosen light sources per shading point. Zero value enables the exact mode
+	 */
+	void setNumSamples(size_t nSamples) { m_nSamples = nSamples; }
+	/**
+	 * @brief Returns the culling threshold
+	 * @return The culling threshold
+	 */
+	float getThreshold(void) const { return m_threshold; }
+	/**
+	 * @brief Returns the number of stochastically chosen light sources per shading point
+	 * @return The number of light samples (zero in the exact mode)
+	 */
+	size_t getNumSamples(void) const { return m_nSamples; }
+
+
+private:
+	struct Node {
+		CBoundingBox	box;			///< The bounding box of the lights' positions
+		float			power;			///< The total power of the lights
+		size_t			begin;			///< Index of the first light (leaf nodes)
+		size_t			end;			///< Index after the last light (leaf nodes)
+		size_t			left = 0;		///< Index of the left child (0 for leaf nodes)
+		size_t			right = 0;		///< Index of the right child (0 for leaf nodes)
+
+		bool isLeaf(void) const { return left == 0; }
+	};
+
+	// Builds the sub-tree for lights vIdx[begin; end) and returns the index of its root node
+	size_t build(std::vector<size_t>& vIdx, size_t begin, size_t end)
+	{
+		Node node;
+		node.power = 0;
+		node.begin = begin;
+		node.end = end;
+		for (size_t i = begin; i < end; i++) {
+			node.box.extend(m_vOrigins[vIdx[i]]);
+			node.power += m_vPowers[vIdx[i]];
+		}
+		size_t res = m_vNodes.size();
+		m_vNodes.push_back(node);
+		if (end - begin <= m_maxLeafLights) return res;
+
+		// split at the median along the widest dimension
+		Vec3f extent = node.box.getMaxPoint() - node.box.getMinPoint();
+		int dim = (extent.val[0] > extent.val[1]) ? ((extent.val[0] > extent.val[2]) ? 0 : 2) : ((extent.val[1] > extent.val[2]) ? 1 : 2);
+		size_t mid = (begin + end) / 2;
+		std::nth_element(vIdx.begin() + begin, vIdx.begin() + mid, vIdx.begin() + end, [&](size_t a, size_t b) {
+			return m_vOrigins[a].val[dim] < m_vOrigins[b].val[dim];
+		});
+
+		size_t left = build(vIdx, begin, mid);
+		size_t right = build(vIdx, mid, end);
+		m_vNodes[res].left = left;
+		m_vNodes[res].right = right;
+		return res;
+	}
+
+	// Exact mode: visits all the lights, which pass the culling threshold
+	template <typename F>
+	void visit(size_t n, const Vec3f& p, F& fn) const
+	{
+		const Node& node = m_vNodes[n];
+		if (m_threshold > 0 && node.power < m_threshold * minDist2(node.box, p)) return;
+		if (node.isLeaf()) {
+			for (size_t i = node.begin; i < node.end; i++) {
+				if (m_threshold > 0) {
+					Vec3f d = m_vOrigins[i] - p;
+					if (m_vPowers[i] < m_threshold * d.dot(d)) continue;
+				}
+				fn(*m_vpLights[i], 1.0f);
+			}
+		}
+		else {
+			visit(node.left, p, fn);
+			visit(node.right, p, fn);
+		}
+	}
+
+	// Stochastic mode: chooses one light with probability proportional to its importance; returns its index and the probability
+	size_t sample(const Vec3f& p, float& pdf) const
+	{
+		pdf = 1;
+		size_t n = 0;
+		while (!m_vNodes[n].isLeaf()) {
+			const Node& node = m_vNodes[n];
+			float wl = importance(m_vNodes[node.left], p);
+			float wr = importance(m_vNodes[node.right], p);
+			if (wl + wr <= 0) { pdf = 0; return 0; }
+			float pl = wl / (wl + wr);
+			if (Random::U<float>() < pl) {
+				n = node.left;
+				pdf *= pl;
+			}
+			else {
+				n = node.right;
+				pdf *= 1 - pl;
+			}
+		}
+
+		// choose the light within the leaf
+		const Node& leaf = m_vNodes[n];
+		float sum = 0;
+		float w[m_maxLeafLights];
+		for (size_t i = leaf.begin; i < leaf.end; i++) {
+			Vec3f d = m_vOrigins[i] - p;
+			w[i - leaf.begin] = m_vPowers[i] / MAX(d.dot(d), Epsilon);
+			sum += w[i - leaf.begin];
+		}
+		if (sum <= 0) { pdf = 0; return 0; }
+		float u = Random::U<float>() * sum;
+		size_t i = leaf.begin;
+		for (; i < leaf.end - 1; i++) {
+			u -= w[i - leaf.begin];
+			if (u < 0) break;
+		}
+		pdf *= w[i - leaf.begin] / sum;
+		return i;
+	}
+
+	// Returns the importance of the node \b node for point \b p, i.e. its power divided by the (bounded from below) squared distance
+	static float importance(const Node& node, const Vec3f& p)
+	{
+		Vec3f center = 0.5f * (node.box.getMinPoint() + node.box.getMaxPoint());
+		Vec3f half = 0.5f * (node.box.getMaxPoint() - node.box.getMinPoint());
+		Vec3f d = center - p;
+		return node.power / MAX(MAX(d.dot(d), half.dot(half)), Epsilon);
+	}
+
+	// Returns the squared distance from point \b p to the box \b box (zero if p is inside)
+	static float minDist2(const CBoundingBox& box, const Vec3f& p)
+	{
+		float res = 0;
+		for (int i = 0; i < 3; i++) {
+			float d = MAX(box.getMinPoint().val[i] - p.val[i], MAX(0.0f, p.val[i] - box.getMaxPoint().val[i]));
+			res += d * d;
+		}
+		return res;
+	}
+
+
+private:
+	static constexpr size_t		m_maxLeafLights = 2;	///< The maximum number of lights in a leaf node
+	std::vector<Node>			m_vNodes;				///< The tree nodes, the root node is the first one
+	std::vector<ptr_light_t>	m_vpLights;				///< The point lights, ordered according to the leaf nodes
+	std::vector<Vec3f>			m_vOrigins;				///< The positions of the point lights
+	std::vector<float>			m_vPowers;				///< The powers (maximal intensity channel) of the point lights
+	std::vector<ptr_light_t>	m_vpOtherLights;		///< The lights, which can not be bounded
+	float						m_threshold = 0;		///< The culling threshold for the exact mode
+	size_t						m_nSamples = 0;			///< The number of light samples per shading point (0 for the exact mode)
+};
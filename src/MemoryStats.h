@@ -0,0 +1,398 @@
+// Memory Accounting class
+#pragma once
+
+#include "types.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+
+// ================================ Memory Statistics Class ================================
+/**
+ * @brief Memory accounting class
+ * @details The components of the renderer report the bytes they allocate and free per subsystem (see @ref Subsystem): the primitives
+ * through the @ref CMemoryTracked base class, the arenas of the BSP trees, the textures, the framebuffers of the render engines and
+ * the frames waiting in the video writer explicitly with add(). The accounting keeps the current bytes and the high-water mark of every
+ * subsystem, also per named phase of the rendering (see @ref CMemoryPhase and MEMORY_PHASE()), which shows what was alive at the peak.
+ * Every subsystem may be given a budget (see setBudget()): the textures are downsampled and the BSP trees are rebuilt coarser, so that
+ * they stay within their budgets; the other subsystems are reported by checkBudgets().
+ * @code
+ * CMemoryStats::instance().setBudget(CMemoryStats::Subsystem::textures, 256 << 20);
+ * {
+ *	MEMORY_PHASE("bsp build");
+ *	scene.buildAccelStructure(20, 3);
+ * }
+ * CMemoryStats::instance().printSummary();
+ * @endcode
+ * @note The bytes are estimated from the sizes of the objects and their buffers, the overhead of the heap allocator is not included
+ */
+class CMemoryStats
+{
+public:
+	/// Accounted subsystems
+	enum class Subsystem : size_t {
+		primitives,		///< The primitives and their shared_ptr control blocks
+		bspNodes,		///< The node arenas and the build buffers of the BSP trees
+		bspLeaves,		///< The primitive pointers of the BSP leaves
+		textures,		///< The texture buffers
+		framebuffers,	///< The images and the per-pixel buffers of the render engines
+		video			///< The frames waiting in the queue of the frame writer
+	};
+	static constexpr size_t nSubsystems = 6;	///< The number of subsystems
+	/// Estimated size of the control block of std::make_shared: the virtual table pointer and the use and weak counts
+	static constexpr size_t controlBlockSize = sizeof(void*) + 2 * sizeof(int);
+
+	/// Bytes of all the subsystems
+	struct Bytes {
+		std::array<qword, nSubsystems> values = {};		///< The bytes indexed by @ref Subsystem
+
+		/// Returns the bytes of the subsystem \b subsystem
+		qword operator[](Subsystem subsystem) const { return values[static_cast<size_t>(subsystem)]; }
+		/// Returns the sum over the subsystems
+		qword getTotal(void) const
+		{
+			qword res = 0;
+			for (qword value : values) res += value;
+			return res;
+		}
+	};
+	/// High-water marks of a phase
+	struct Phase {
+		std::string	name;			///< The name of the phase
+		size_t		count = 0;		///< The number of times the phase was entered
+		Bytes		peak;			///< The high-water marks of the subsystems during the phase
+		qword		total = 0;		///< The high-water mark of the sum over the subsystems during the phase
+	};
+
+	CMemoryStats(const CMemoryStats&) = delete;
+	~CMemoryStats(void) = default;
+	const CMemoryStats& operator=(const CMemoryStats&) = delete;
+
+	/**
+	 * @brief Returns the memory accounting of the application
+	 * @return The memory accounting
+	 */
+	static CMemoryStats& instance(void)
+	{
+		static CMemoryStats stats;
+		return stats;
+	}
+	/**
+	 * @brief Returns the name of the subsystem \b subsystem
+	 * @param subsystem The subsystem
+	 * @return The name, e.g. "bsp_nodes"
+	 */
+	static const char* getName(Subsystem subsystem)
+	{
+		static const char* names[nSubsystems] = { "primitives", "bsp_nodes", "bsp_leaves", "textures", "framebuffers", "video" };
+		return names[static_cast<size_t>(subsystem)];
+	}
+	/**
+	 * @brief Adds \b bytes to the subsystem \b subsystem
+	 * @details This method is thread-safe and lock-free
+	 * @param subsystem The subsystem
+	 * @param bytes The allocated bytes (negative - freed)
+	 */
+	void add(Subsystem subsystem, int64 bytes)
+	{
+		const size_t s = static_cast<size_t>(subsystem);
+		qword current = m_current[s].fetch_add(static_cast<qword>(bytes), std::memory_order_relaxed) + static_cast<qword>(bytes);
+		if (bytes > 0) updatePeaks(s, current, static_cast<qword>(bytes));
+		else m_total.fetch_add(static_cast<qword>(bytes), std::memory_order_relaxed);
+	}
+	/**
+	 * @brief Adds \b bytes to the subsystem \b subsystem, if they fit into its budget
+	 * @details The check and the addition are one atomic operation, thus concurrent allocations can not exceed the budget together,
+	 * as they could with isOverBudget() followed by add()
+	 * @param subsystem The subsystem
+	 * @param bytes The bytes to be allocated
+	 * @retval true If the bytes were added
+	 * @retval false If the subsystem has a budget and it would be exceeded; nothing is added in this case
+	 */
+	bool tryAdd(Subsystem subsystem, qword bytes)
+	{
+		const size_t s = static_cast<size_t>(subsystem);
+		const qword budget = getBudget(subsystem);
+		qword current = m_current[s].load(std::memory_order_relaxed);
+		do {
+			if (budget && current + bytes > budget) return false;
+		} while (!m_current[s].compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+		updatePeaks(s, current + bytes, bytes);
+		return true;
+	}
+	/**
+	 * @brief Returns the bytes, which are currently allocated
+	 * @return The bytes of the subsystems
+	 */
+	Bytes getCurrent(void) const { return load(m_current); }
+	/**
+	 * @brief Returns the high-water marks since the start of the application
+	 * @return The peak bytes of the subsystems
+	 */
+	Bytes getPeak(void) const { return load(m_peak); }
+	/**
+	 * @brief Returns the high-water mark of the sum over the subsystems since the start of the application
+	 * @return The peak bytes
+	 */
+	qword getPeakTotal(void) const { return m_peakTotal.load(std::memory_order_relaxed); }
+	/**
+	 * @brief Returns the high-water marks of the phases
+	 * @return The phases in the order they were first entered
+	 */
+	std::vector<Phase> getPhases(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_vPhases;
+	}
+
+	/**
+	 * @brief Sets the budget of the subsystem \b subsystem
+	 * @param subsystem The subsystem
+	 * @param bytes The maximal number of bytes (0 - unlimited)
+	 */
+	void setBudget(Subsystem subsystem, qword bytes) { m_budget[static_cast<size_t>(subsystem)].store(bytes, std::memory_order_relaxed); }
+	/**
+	 * @brief Returns the budget of the subsystem \b subsystem
+	 * @param subsystem The subsystem
+	 * @return The maximal number of bytes (0 - unlimited)
+	 */
+	qword getBudget(Subsystem subsystem) const { return m_budget[static_cast<size_t>(subsystem)].load(std::memory_order_relaxed); }
+	/**
+	 * @brief Checks whether the subsystem \b subsystem would exceed its budget, if \b bytes were added
+	 * @param subsystem The subsystem
+	 * @param bytes The bytes to be allocated
+	 * @retval true If the subsystem has a budget and it would be exceeded
+	 * @retval false Otherwise
+	 */
+	bool isOverBudget(Subsystem subsystem, qword bytes = 0) const
+	{
+		qword budget = getBudget(subsystem);
+		return budget && m_current[static_cast<size_t>(subsystem)].load(std::memory_order_relaxed) + bytes > budget;
+	}
+	/**
+	 * @brief Parses and sets the budgets from the string \b budgets
+	 * @param budgets The comma-separated budgets in megabytes, e.g. "textures=256,bsp_nodes=64"
+	 * @retval true If all the budgets were parsed
+	 * @retval false If a subsystem name or a value is invalid
+	 */
+	bool parseBudgets(const std::string& budgets)
+	{
+		std::stringstream ss(budgets);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			if (item.empty()) continue;
+			size_t eq = item.find('=');
+			if (eq == std::string::npos) return false;
+			const std::string name = item.substr(0, eq);
+			char* end = nullptr;
+			double mb = strtod(item.c_str() + eq + 1, &end);
+			if (end == item.c_str() + eq + 1 || *end || mb < 0) return false;
+			size_t s = 0;
+			while (s < nSubsystems && name != getName(static_cast<Subsystem>(s))) s++;
+			if (s == nSubsystems) return false;
+			setBudget(static_cast<Subsystem>(s), static_cast<qword>(mb * (1 << 20)));
+		}
+		return true;
+	}
+	/**
+	 * @brief Prints a warning for every subsystem, whose high-water mark exceeded its budget for the first time
+	 * @return The number of subsystems over their budgets
+	 */
+	size_t checkBudgets(void)
+	{
+		size_t res = 0;
+		for (size_t s = 0; s < nSubsystems; s++) {
+			qword budget = m_budget[s].load(std::memory_order_relaxed);
+			qword peak = m_peak[s].load(std::memory_order_relaxed);
+			if (!budget || peak <= budget) continue;
+			res++;
+			if (!m_warned[s].exchange(true))
+				fprintf(stderr, "WARNING: The %s used %.1f MB, over the budget of %.1f MB\n", getName(static_cast<Subsystem>(s)), toMB(peak), toMB(budget));
+		}
+		return res;
+	}
+
+	/**
+	 * @brief Enters the phase \b name
+	 * @details The phases may be nested. They should be entered and left from one thread, the bytes may be added from any thread
+	 * @param name The name of the phase
+	 */
+	void beginPhase(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		Bytes outer = load(m_phasePeak);
+		m_vStack.push_back({ name, outer, m_phasePeakTotal.load(std::memory_order_relaxed) });
+		for (size_t s = 0; s < nSubsystems; s++) m_phasePeak[s].store(m_current[s].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		m_phasePeakTotal.store(m_total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	/**
+	 * @brief Leaves the innermost phase and stores its high-water marks
+	 */
+	void endPhase(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_vStack.empty()) return;
+		const StackEntry entry = m_vStack.back();
+		m_vStack.pop_back();
+		Bytes inner = load(m_phasePeak);
+		qword innerTotal = m_phasePeakTotal.load(std::memory_order_relaxed);
+
+		auto it = std::find_if(m_vPhases.begin(), m_vPhases.end(), [&entry](const Phase& phase) { return phase.name == entry.name; });
+		if (it == m_vPhases.end()) it = m_vPhases.insert(m_vPhases.end(), Phase{ entry.name, 0, Bytes(), 0 });
+		it->count++;
+		for (size_t s = 0; s < nSubsystems; s++) it->peak.values[s] = MAX(it->peak.values[s], inner.values[s]);
+		it->total = MAX(it->total, innerTotal);
+
+		// the high-water marks of the inner phase belong to the outer phase as well
+		for (size_t s = 0; s < nSubsystems; s++) {
+			m_phasePeak[s].store(entry.outer.values[s], std::memory_order_relaxed);
+			updateMax(m_phasePeak[s], inner.values[s]);
+		}
+		m_phasePeakTotal.store(entry.outerTotal, std::memory_order_relaxed);
+		updateMax(m_phasePeakTotal, innerTotal);
+	}
+
+	/**
+	 * @brief Prints the high-water marks of the subsystems and of the phases
+	 */
+	void printSummary(void) const
+	{
+		Bytes peak = getPeak();
+		printf("Memory: peak %.1f MB (", toMB(getPeakTotal()));
+		for (size_t s = 0; s < nSubsystems; s++)
+			printf("%s%s %.1f", s ? ", " : "", getName(static_cast<Subsystem>(s)), toMB(peak.values[s]));
+		printf(" MB)\n");
+		std::vector<Phase> vPhases = getPhases();
+		if (vPhases.empty()) return;
+		printf("Memory peak per phase (MB):");
+		for (size_t p = 0; p < vPhases.size(); p++)
+			printf("%s %s %.1f", p ? "," : "", vPhases[p].name.c_str(), toMB(vPhases[p].total));
+		printf("\n");
+	}
+	/**
+	 * @brief Writes the current bytes, the high-water marks and the budgets as a JSON object
+	 * @param pFile The opened file
+	 * @param indent The indentation of the nested lines
+	 */
+	void writeJson(FILE* pFile, const std::string& indent = "  ") const
+	{
+		auto writeBytes = [pFile](const Bytes& bytes) {
+			fprintf(pFile, "{");
+			for (size_t s = 0; s < nSubsystems; s++)
+				fprintf(pFile, "%s\"%s\": %llu", s ? ", " : "", getName(static_cast<Subsystem>(s)), static_cast<unsigned long long>(bytes.values[s]));
+			fprintf(pFile, "}");
+		};
+		fprintf(pFile, "{\n%s  \"current_bytes\": ", indent.c_str());
+		writeBytes(getCurrent());
+		fprintf(pFile, ",\n%s  \"peak_bytes\": ", indent.c_str());
+		writeBytes(getPeak());
+		fprintf(pFile, ",\n%s  \"peak_total_bytes\": %llu,\n%s  \"budget_bytes\": ", indent.c_str(), static_cast<unsigned long long>(getPeakTotal()), indent.c_str());
+		writeBytes(load(m_budget));
+		fprintf(pFile, ",\n%s  \"phases\": [", indent.c_str());
+		std::vector<Phase> vPhases = getPhases();
+		for (size_t p = 0; p < vPhases.size(); p++) {
+			fprintf(pFile, "%s\n%s    {\"name\": \"%s\", \"count\": %zu, \"peak_total_bytes\": %llu, \"peak_bytes\": ", p ? "," : "", indent.c_str(),
+				vPhases[p].name.c_str(), vPhases[p].count, static_cast<unsigned long long>(vPhases[p].total));
+			writeBytes(vPhases[p].peak);
+			fprintf(pFile, "}");
+		}
+		fprintf(pFile, "%s]\n%s}", vPhases.empty() ? "" : ("\n" + indent + "  ").c_str(), indent.c_str());
+	}
+
+
+private:
+	/// Entered phase
+	struct StackEntry {
+		std::string	name;			///< The name of the phase
+		Bytes		outer;			///< The high-water marks of the outer phase, when the phase was entered
+		qword		outerTotal;		///< The high-water mark of the sum of the outer phase, when the phase was entered
+	};
+
+	CMemoryStats(void) = default;
+
+	// Adds the allocated \b bytes to the total and raises the high-water marks with the \b current bytes of the subsystem \b s
+	void updatePeaks(size_t s, qword current, qword bytes)
+	{
+		qword total = m_total.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		updateMax(m_peak[s], current);
+		updateMax(m_phasePeak[s], current);
+		updateMax(m_peakTotal, total);
+		updateMax(m_phasePeakTotal, total);
+	}
+	// Raises the atomic \b value to \b x
+	static void updateMax(std::atomic<qword>& value, qword x)
+	{
+		qword old = value.load(std::memory_order_relaxed);
+		while (old < x && !value.compare_exchange_weak(old, x, std::memory_order_relaxed));
+	}
+	// Returns the values of the atomic counters
+	static Bytes load(const std::array<std::atomic<qword>, nSubsystems>& values)
+	{
+		Bytes res;
+		for (size_t s = 0; s < nSubsystems; s++) res.values[s] = values[s].load(std::memory_order_relaxed);
+		return res;
+	}
+	// Converts bytes to megabytes
+	static double toMB(qword bytes) { return bytes / (1024.0 * 1024.0); }
+
+
+private:
+	std::array<std::atomic<qword>, nSubsystems>	m_current = {};			///< The currently allocated bytes
+	std::array<std::atomic<qword>, nSubsystems>	m_peak = {};			///< The high-water marks since the start of the application
+	std::array<std::atomic<qword>, nSubsystems>	m_phasePeak = {};		///< The high-water marks of the innermost phase
+	std::array<std::atomic<qword>, nSubsystems>	m_budget = {};			///< The budgets (0 - unlimited)
+	std::array<std::atomic<bool>, nSubsystems>	m_warned = {};			///< The flags of the subsystems, which were reported over their budgets
+	std::atomic<qword>							m_total = 0;			///< The currently allocated bytes of all the subsystems
+	std::atomic<qword>							m_peakTotal = 0;		///< The high-water mark of m_total
+	std::atomic<qword>							m_phasePeakTotal = 0;	///< The high-water mark of m_total in the innermost phase
+	mutable std::mutex							m_mtx;					///< Mutex protecting the phases
+	std::vector<StackEntry>						m_vStack;				///< The entered phases
+	std::vector<Phase>							m_vPhases;				///< The high-water marks of the left phases
+};
+
+// ================================ Memory Tracked Class ================================
+/**
+ * @brief Empty base class accounting the objects of the class \b T in the subsystem \b subsystem
+ * @details The size of the object and of the control block of std::make_shared are added, when the object is constructed and subtracted,
+ * when it is destroyed. Being empty, the base adds nothing to the size of the derived class.
+ * @code
+ * class CPrimTriangle : public IPrim, private CMemoryTracked<CPrimTriangle, CMemoryStats::Subsystem::primitives>
+ * @endcode
+ */
+template <class T, CMemoryStats::Subsystem subsystem>
+class CMemoryTracked
+{
+protected:
+	CMemoryTracked(void) { CMemoryStats::instance().add(subsystem, getBytes()); }
+	CMemoryTracked(const CMemoryTracked&) : CMemoryTracked() {}
+	~CMemoryTracked(void) { CMemoryStats::instance().add(subsystem, -getBytes()); }
+	const CMemoryTracked& operator=(const CMemoryTracked&) { return *this; }
+
+
+private:
+	// Returns the accounted bytes per object (T is complete only in the bodies of the member functions)
+	static int64 getBytes(void) { return static_cast<int64>(sizeof(T) + CMemoryStats::controlBlockSize); }
+};
+
+// ================================ Memory Phase Class ================================
+/**
+ * @brief Scoped memory phase class
+ * @details Enters the phase in the constructor and leaves it in the destructor (see CMemoryStats::beginPhase())
+ */
+class CMemoryPhase
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param name The name of the phase
+	 */
+	explicit CMemoryPhase(const char* name) { CMemoryStats::instance().beginPhase(name); }
+	CMemoryPhase(const CMemoryPhase&) = delete;
+	~CMemoryPhase(void) { CMemoryStats::instance().endPhase(); }
+	const CMemoryPhase& operator=(const CMemoryPhase&) = delete;
+};
+
+#define MEMORY_CONCAT_(a, b)	a##b
+#define MEMORY_CONCAT(a, b)		MEMORY_CONCAT_(a, b)
+/// Records the high-water marks of the rest of the enclosing scope as the phase \b name (see @ref CMemoryPhase)
+#define MEMORY_PHASE(name)		CMemoryPhase MEMORY_CONCAT(memoryPhase_, __LINE__)(name)
@@ -0,0 +1,70 @@
+// Occluder Cache class
+#pragma once
+
+#include "types.h"
+#include <unordered_map>
+
+class ILight;
+class IPrim;
+
+// ================================ Occluder Cache Class ================================
+/**
+ * @brief Shadow occluder cache class
+ * @details This class remembers for every light source the primitive, which blocked the last shadow ray towards this light source.
+ * Since the neighbouring surface points are usually blocked by the same primitive, testing this primitive first avoids most of the
+ * full traversals of the acceleration structure. The occluders are hashed by the light source, thus a lookup costs O(1) also in the scenes
+ * with hundreds of light sources. The cache is not thread-safe and is meant to be owned by a single thread.
+ * The cached primitives are invalidated, when the scene rebuilds its acceleration structure (see CScene::occluded())
+ */
+class COccluderCache
+{
+public:
+	COccluderCache(void) = default;
+	COccluderCache(const COccluderCache&) = delete;
+	~COccluderCache(void) = default;
+	const COccluderCache& operator=(const COccluderCache&) = delete;
+
+	/**
+	 * @brief Returns the last occluder for the light source \b pLight
+	 * @param pLight Pointer to the light source
+	 * @return Reference to the last occluder, which may be updated. The initial value is \a nullptr
+	 */
+	const IPrim*& get(const ILight* pLight) { return m_mOccluders[pLight]; }
+	/**
+	 * @brief Clears the cache if it was filled for another version of the scene geometry
+	 * @param generation The identifier of the current version of the scene geometry
+	 */
+	void validate(size_t generation)
+	{
+		if (generation != m_generation) {
+			m_mOccluders.clear();
+			m_generation = generation;
+		}
+	}
+	/**
+	 * @brief Counts a cache lookup
+	 * @param hit Flag indicating whether the cached occluder blocked the shadow ray
+	 */
+	void count(bool hit)
+	{
+		m_nLookups++;
+		if (hit) m_nHits++;
+	}
+	/**
+	 * @brief Returns the number of lookups, where the cached occluder blocked the shadow ray
+	 * @return The number of cache hits
+	 */
+	size_t getNumHits(void) const { return m_nHits; }
+	/**
+	 * @brief Returns the number of lookups
+	 * @return The number of lookups
+	 */
+	size_t getNumLookups(void) const { return m_nLookups; }
+
+
+private:
+	std::unordered_map<const ILight*, const IPrim*>	m_mOccluders;		///< The last occluders of the light sources
+	size_t											m_generation = 0;	///< The version of the scene geometry
+	size_t											m_nLookups = 0;		///< The number of lookups
+	size_t											m_nHits = 0;		///< The number of cache hits
+};
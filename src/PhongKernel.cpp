@@ -0,0 +1,26 @@
+#include "PhongKernel.h"
+#include "CpuDispatch.h"
+
+void PhongKernel::illuminate(PhongSamples& samples, float kd, float ks, float ke)
+{
+	const size_t n = samples.size();
+	for (int c = 0; c < 3; c++) samples.result[c].resize(n);
+	samples.cosLN.resize(n);
+
+	PhongArrays arrays;
+	for (int c = 0; c < 3; c++) {
+		arrays.normal[c] = samples.normal[c].data();
+		arrays.reflect[c] = samples.reflect[c].data();
+		arrays.light[c] = samples.light[c].data();
+		arrays.intensity[c] = samples.intensity[c].data();
+		arrays.color[c] = samples.color[c].data();
+		arrays.result[c] = samples.result[c].data();
+	}
+	arrays.cosLN = samples.cosLN.data();
+	CCpuDispatch::getKernels().illuminate(arrays, n, kd, ks, ke);
+}
+
+const char* PhongKernel::getISA(void)
+{
+	return CCpuDispatch::getKernels().name;
+}
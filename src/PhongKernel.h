@@ -0,0 +1,101 @@
+// Vectorized Phong shading kernel
+#pragma once
+
+#include "types.h"
+
+class ILight;
+
+// ================================ Phong Samples Structure ================================
+/**
+ * @brief Structure of arrays (SoA) holding the shading samples of a batch
+ * @details Every sample is a pair (hit, light source). The geometric values are stored as separate arrays for every component,
+ * so that the kernel may process 4 (SSE4.2), 8 (AVX2) or 16 (AVX-512) samples at once
+ */
+struct PhongSamples
+{
+	// input
+	std::vector<float>	normal[3];		///< Shading normal, turned to the front
+	std::vector<float>	reflect[3];		///< Normalized reflection vector of the primary ray
+	std::vector<float>	light[3];		///< Normalized direction from the surface point to the light source
+	std::vector<float>	intensity[3];	///< Intensity of the light source at the surface point (including the sampling weight)
+	std::vector<float>	color[3];		///< Base color of the surface
+	// output
+	std::vector<float>	result[3];		///< Contribution of the light source
+	std::vector<float>	cosLN;			///< Cosine between the normal and the light direction
+	// bookkeeping
+	std::vector<size_t>			hit;	///< Index of the hit in the batch
+	std::vector<const ILight*>	pLight;	///< The light source
+	std::vector<float>			dist;	///< The distance to the light source
+
+	/**
+	 * @brief Returns the number of samples
+	 * @return The number of samples
+	 */
+	size_t size(void) const { return hit.size(); }
+	/**
+	 * @brief Removes all the samples
+	 */
+	void clear(void)
+	{
+		for (int c = 0; c < 3; c++) {
+			normal[c].clear();
+			reflect[c].clear();
+			light[c].clear();
+			intensity[c].clear();
+			color[c].clear();
+		}
+		hit.clear();
+		pLight.clear();
+		dist.clear();
+	}
+	/**
+	 * @brief Adds a new sample
+	 */
+	void push_back(size_t h, const ILight* l, float d, const Vec3f& n, const Vec3f& r, const Vec3f& ld, const Vec3f& i, const Vec3f& c)
+	{
+		for (int k = 0; k < 3; k++) {
+			normal[k].push_back(n.val[k]);
+			reflect[k].push_back(r.val[k]);
+			light[k].push_back(ld.val[k]);
+			intensity[k].push_back(i.val[k]);
+			color[k].push_back(c.val[k]);
+		}
+		hit.push_back(h);
+		pLight.push_back(l);
+		dist.push_back(d);
+	}
+};
+
+// ================================ Phong Kernel Namespace ================================
+/**
+ * @brief Vectorized Phong shading kernel
+ */
+namespace PhongKernel
+{
+	/**
+	 * @brief Evaluates the diffuse and specular terms for all the samples
+	 * @details For every sample it calculates:
+	 * \f[ result = (k_d \max(0, \vec{l}\cdot\vec{n})\,color + k_s \max(0, \vec{l}\cdot\vec{r})^{k_e}) \cdot intensity \f]
+	 * The kernel uses the widest instruction set supported by the CPU (see @ref CCpuDispatch) and a scalar loop on the baseline.
+	 * The specular exponent is evaluated with the fast approximation fastPow()
+	 * @param[in,out] samples The shading samples. The \a result and \a cosLN arrays are filled
+	 * @param kd The diffuse reflection coefficient
+	 * @param ks The specular reflection coefficient
+	 * @param ke The shininess exponent
+	 */
+	void illuminate(PhongSamples& samples, float kd, float ks, float ke);
+	/**
+	 * @brief Fast approximation of \f$ x^e \f$ for \f$ x > 0 \f$
+	 * @details Calculates \f$ 2^{e \log_2 x} \f$ with polynomial approximations of \f$ \log_2 \f$ and \f$ 2^x \f$ (relative error below \f$ 10^{-4}\,e \f$).
+	 * This is the scalar version of the approximation used in the vectorized kernel
+	 * @param x The base
+	 * @param e The exponent
+	 * @return The approximated value of \f$ x^e \f$
+	 */
+	float fastPow(float x, float e);
+	/**
+	 * @brief Returns the name of the instruction set selected for the kernel at run time
+	 * @return The name of the instruction set
+	 */
+	const char* getISA(void);
+}
@@ -3,12 +3,14 @@
 #pragma once
 
 #include "IPrim.h"
+#include "Transform.h"
+#include "MemoryStats.h"
 
 // ================================ Infinite Plane Primitive Class ================================
 /**
  * @brief The Plane Geometrical Primitive class
  */
-class CPrimPlane : public IPrim
+class CPrimPlane : public IPrim, private CMemoryTracked<CPrimPlane, CMemoryStats::Subsystem::primitives>
 {
 public:
 	/**
@@ -36,6 +38,12 @@ public:
 		return true;
 	}
 
+	virtual void transform(const Mat& t) override
+	{
+		m_origin = CTransform::point(m_origin, t);
+		m_normal = CTransform::normal(m_normal, t);
+	}
+
 	virtual Vec3f getNormal(const Ray& ray) const override
 	{
 		return m_normal;
@@ -59,6 +67,11 @@ public:
 		return CBoundingBox(minPoint, maxPoint);
 	}
 
+	virtual ptr_prim_t clone(void) const override
+	{
+		return std::make_shared<CPrimPlane>(getShader(), m_origin, m_normal);
+	}
+
 private:
 	Vec3f m_normal;	///< Point on the plane
 	Vec3f m_origin;	///< Normal to the plane
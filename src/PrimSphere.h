@@ -3,12 +3,14 @@
 #pragma once
 
 #include "IPrim.h"
+#include "Transform.h"
+#include "MemoryStats.h"
 
 // ================================ Sphere Primitive Class ================================
 /**
  * @brief Sphere Geaometrical Primitive class
  */
-class CPrimSphere : public IPrim
+class CPrimSphere : public IPrim, private CMemoryTracked<CPrimSphere, CMemoryStats::Subsystem::primitives>
 {
 public:
 	/**
@@ -56,6 +58,17 @@ public:
 		return true;
 	}
 
+	virtual void transform(const Mat& t) override
+	{
+		// the radius is scaled with the mean scaling factor, which is exact for uniform scaling
+		Vec3f r0(t.at<float>(0, 0), t.at<float>(0, 1), t.at<float>(0, 2));
+		Vec3f r1(t.at<float>(1, 0), t.at<float>(1, 1), t.at<float>(1, 2));
+		Vec3f r2(t.at<float>(2, 0), t.at<float>(2, 1), t.at<float>(2, 2));
+		float det = r0.dot(r1.cross(r2));
+		m_origin = CTransform::point(m_origin, t);
+		m_radius *= cbrtf(fabsf(det));
+	}
+
 	virtual Vec3f getNormal(const Ray& ray) const override
 	{
 		Vec3f hit = ray.org + ray.t * ray.dir;
@@ -80,6 +93,11 @@ public:
 		return CBoundingBox(m_origin - Vec3f::all(m_radius), m_origin + Vec3f::all(m_radius));
 	}
 
+	virtual ptr_prim_t clone(void) const override
+	{
+		return std::make_shared<CPrimSphere>(getShader(), m_origin, m_radius);
+	}
+
 
 private:
 	Vec3f m_origin;	///< Position of the center of the sphere
@@ -3,12 +3,16 @@
 #pragma once
 
 #include "IPrim.h"
+#include "Transform.h"
+#include "MemoryStats.h"
+#include "RayStats.h"
+#include "CpuDispatch.h"
 
 // ================================ Triangle Primitive Class ================================
 /**
  * @brief Triangle Geometrical Primitive class
  */
-class CPrimTriangle : public IPrim
+class CPrimTriangle : public IPrim, private CMemoryTracked<CPrimTriangle, CMemoryStats::Subsystem::primitives>
 {
 public:
 	/**
@@ -46,42 +50,33 @@ public:
 
 	virtual bool intersect(Ray& ray) const override
 	{
-		const Vec3f edge1 = m_b - m_a;
-		const Vec3f edge2 = m_c - m_a;
-
-		const Vec3f pvec = ray.dir.cross(edge2);
-
-		const float det = edge1.dot(pvec);
-		if (fabs(det) < Epsilon) return false;
-
-		const float inv_det = 1.0f / det;
-
-		const Vec3f tvec = ray.org - m_a;
-		float lambda = tvec.dot(pvec);
-		lambda *= inv_det;
-
-		if (lambda < 0.0f || lambda > 1.0f) return false;
-
-		const Vec3f qvec = tvec.cross(edge1);
-		float mue = ray.dir.dot(qvec);
-		mue *= inv_det;
-
-		if (mue < 0.0f || mue + lambda > 1.0f) return false;
-
-		float f = edge2.dot(qvec);
-		f *= inv_det;
+		STATS_ADD(triangleTests, 1);
+		float uv[2];
+		const float f = CCpuDispatch::getKernels().intersectTriangle(m_a.val, m_edge1.val, m_edge2.val, ray.org.val, ray.dir.val, Epsilon, uv);
 		if (ray.t <= f || f < Epsilon) return false;
 
 		ray.t = f;
 		ray.hit = shared_from_this();
-		ray.u = lambda;
-		ray.v = mue;
+		ray.u = uv[0];
+		ray.v = uv[1];
 
 		return true;
 	}
 
 	virtual void transform(const Mat& t) override {
-		// --- PUT YOUR CODE HERE ---
+		m_a = CTransform::point(m_a, t);
+		m_b = CTransform::point(m_b, t);
+		m_c = CTransform::point(m_c, t);
+		m_edge1 = m_b - m_a;
+		m_edge2 = m_c - m_a;
+		if (m_na) m_na = CTransform::normal(m_na.value(), t);
+		if (m_nb) m_nb = CTransform::normal(m_nb.value(), t);
+		if (m_nc) m_nc = CTransform::normal(m_nc.value(), t);
+	}
+
+	virtual ptr_prim_t clone(void) const override
+	{
+		return std::make_shared<CPrimTriangle>(getShader(), m_a, m_b, m_c, m_ta, m_tb, m_tc, m_na, m_nb, m_nc);
 	}
 
 	virtual Vec3f getNormal(const Ray& ray) const override
@@ -98,6 +93,11 @@ public:
 		return (1.0f - ray.u - ray.v) * m_ta + ray.u * m_tb + ray.v * m_tc;
 	}
 
+	virtual std::optional<Vec3f> getSurfacePoint(float u, float v) const override
+	{
+		return (1.0f - u - v) * m_a + u * m_b + v * m_c;
+	}
+
 	virtual CBoundingBox getBoundingBox(void) const override
 	{
 		CBoundingBox res;
@@ -107,6 +107,13 @@ public:
 		return res;
 	}
 
+	/**
+	 * @brief Returns the position of a vertex
+	 * @param i The index of the vertex: 0 - a, 1 - b, 2 - c
+	 * @return The position of the vertex
+	 */
+	const Vec3f& getVertex(size_t i) const { return i == 0 ? m_a : i == 1 ? m_b : m_c; }
+
 
 private:
 	Vec3f m_a;						///< Position of the first vertex
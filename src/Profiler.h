@@ -0,0 +1,241 @@
+// Hierarchical Profiler class
+#pragma once
+
+#include "types.h"
+#include <mutex>
+#include <map>
+
+// ================================ Profiler Class ================================
+/**
+ * @brief Hierarchical scoped profiler class
+ * @details The profiled code is marked with scoped zones (see @ref CProfileZone and PROFILE_ZONE()), which may be nested.
+ * When a zone is left, its name, start and end times and nesting level are stored in the ring buffer of the calling thread, thus
+ * the threads never wait for each other and the memory usage is bounded (the oldest zones are overwritten). After the profiled work,
+ * the zones are aggregated into a table of phases (see getPhases()) or exported in the Chrome trace format (see writeChromeTrace()),
+ * which may be opened in chrome://tracing or in Perfetto.
+ * @code
+ * {
+ *	PROFILE_ZONE("bsp build");
+ *	scene.buildAccelStructure(20, 3);
+ * }
+ * CProfiler::instance().printPhases();
+ * CProfiler::instance().writeChromeTrace("trace.json");
+ * @endcode
+ * @note The PROFILE_ZONE() macro is empty, unless the project is configured with ENABLE_PROFILER
+ */
+class CProfiler
+{
+public:
+	/// Profiled zone
+	struct Event {
+		const char*	name = nullptr;		///< The name of the zone (a string literal)
+		int64		begin = 0;			///< The start time in ticks (see getTickCount())
+		int64		end = 0;			///< The end time in ticks
+		dword		depth = 0;			///< The nesting level of the zone in its thread
+	};
+	/// Aggregated statistics of the zones with the same name
+	struct Phase {
+		std::string	name;				///< The name of the zones
+		size_t		count = 0;			///< The number of the zones
+		double		total = 0;			///< The inclusive time in milliseconds, summed over all the threads
+		double		self = 0;			///< The exclusive time in milliseconds, i.e. without the nested zones
+		double		max = 0;			///< The longest zone in milliseconds
+	};
+
+	CProfiler(const CProfiler&) = delete;
+	~CProfiler(void) = default;
+	const CProfiler& operator=(const CProfiler&) = delete;
+
+	/**
+	 * @brief Returns the profiler of the application
+	 * @return The profiler
+	 */
+	static CProfiler& instance(void)
+	{
+		static CProfiler profiler;
+		return profiler;
+	}
+	/**
+	 * @brief Stores the zone \b event in the ring buffer of the calling thread
+	 * @param event The zone
+	 */
+	void record(const Event& event)
+	{
+		if (!t_pBuffer) t_pBuffer = addBuffer();
+		ThreadBuffer& buffer = *t_pBuffer;
+		buffer.vEvents[buffer.count % buffer.vEvents.size()] = event;
+		buffer.count++;
+	}
+	/**
+	 * @brief Aggregates the recorded zones by name
+	 * @note The recording threads should be idle
+	 * @return The phases sorted by the inclusive time in descending order
+	 */
+	std::vector<Phase> getPhases(void) const
+	{
+		std::map<std::string, Phase> mPhases;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		for (auto& pBuffer : m_vpBuffers) {
+			std::vector<Event> vEvents = pBuffer->getEvents();
+			std::sort(vEvents.begin(), vEvents.end(), [](const Event& a, const Event& b) { return a.begin < b.begin || (a.begin == b.begin && a.depth < b.depth); });
+			std::vector<std::pair<const Event*, double>> vStack;		// the open zones and the time of their children
+			auto close = [&]() {
+				auto [pEvent, children] = vStack.back();
+				vStack.pop_back();
+				double time = ms(pEvent->end - pEvent->begin);
+				Phase& phase = mPhases[pEvent->name];
+				phase.name = pEvent->name;
+				phase.count++;
+				phase.total += time;
+				phase.self += time - children;
+				phase.max = MAX(phase.max, time);
+				if (!vStack.empty()) vStack.back().second += time;
+			};
+			for (const Event& event : vEvents) {
+				while (!vStack.empty() && (vStack.back().first->end <= event.begin || vStack.back().first->depth >= event.depth))
+					close();
+				vStack.emplace_back(&event, 0.0);
+			}
+			while (!vStack.empty()) close();
+		}
+		std::vector<Phase> res;
+		for (auto& [name, phase] : mPhases) res.push_back(phase);
+		std::sort(res.begin(), res.end(), [](const Phase& a, const Phase& b) { return a.total > b.total; });
+		return res;
+	}
+	/**
+	 * @brief Prints the table of the phases (see getPhases())
+	 */
+	void printPhases(void) const
+	{
+		printf("%-16s %8s %12s %12s %10s\n", "phase", "count", "total (ms)", "self (ms)", "max (ms)");
+		for (const Phase& phase : getPhases())
+			printf("%-16s %8zu %12.2f %12.2f %10.2f\n", phase.name.c_str(), phase.count, phase.total, phase.self, phase.max);
+	}
+	/**
+	 * @brief Writes the recorded zones in the Chrome trace event format
+	 * @note The recording threads should be idle
+	 * @param fileName The name of the JSON file
+	 * @retval true If the file was written
+	 * @retval false If the file could not be opened
+	 */
+	bool writeChromeTrace(const std::string& fileName) const
+	{
+		FILE* pFile = fopen(fileName.c_str(), "w");
+		if (!pFile) return false;
+		std::lock_guard<std::mutex> lock(m_mtx);
+		int64 origin = std::numeric_limits<int64>::max();			// the start of the first zone
+		for (auto& pBuffer : m_vpBuffers)
+			for (const Event& event : pBuffer->getEvents())
+				origin = MIN(origin, event.begin);
+
+		fprintf(pFile, "{\"traceEvents\":[\n");
+		bool first = true;
+		for (size_t t = 0; t < m_vpBuffers.size(); t++)
+			for (const Event& event : m_vpBuffers[t]->getEvents()) {
+				fprintf(pFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",\n", event.name, t, 1000 * ms(event.begin - origin), 1000 * ms(event.end - event.begin));
+				first = false;
+			}
+		fprintf(pFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(pFile);
+		return true;
+	}
+	/**
+	 * @brief Discards all the recorded zones
+	 * @note The recording threads should be idle
+	 */
+	void clear(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		for (auto& pBuffer : m_vpBuffers) pBuffer->count = 0;
+	}
+	/**
+	 * @brief Returns the number of zones, which were overwritten in the ring buffers
+	 * @return The number of lost zones
+	 */
+	size_t getNumDropped(void) const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		size_t res = 0;
+		for (auto& pBuffer : m_vpBuffers) res += pBuffer->count - MIN(pBuffer->count, pBuffer->vEvents.size());
+		return res;
+	}
+
+
+private:
+	/// Ring buffer of the zones of one thread
+	struct ThreadBuffer {
+		std::vector<Event>	vEvents;		///< The zones
+		size_t				count = 0;		///< The number of recorded zones
+
+		// Returns the zones, which were not overwritten, from the oldest to the newest
+		std::vector<Event> getEvents(void) const
+		{
+			std::vector<Event> res;
+			for (size_t i = count - MIN(count, vEvents.size()); i < count; i++)
+				res.push_back(vEvents[i % vEvents.size()]);
+			return res;
+		}
+	};
+
+	CProfiler(size_t capacity = 1 << 16) : m_capacity(capacity) {}
+
+	// Creates the ring buffer of the calling thread
+	ThreadBuffer* addBuffer(void)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_vpBuffers.push_back(std::make_unique<ThreadBuffer>());
+		m_vpBuffers.back()->vEvents.resize(m_capacity);
+		return m_vpBuffers.back().get();
+	}
+	static double ms(int64 ticks) { return 1000.0 * ticks / getTickFrequency(); }
+
+
+private:
+	friend class CProfileZone;
+
+	mutable std::mutex							m_mtx;			///< Mutex protecting the list of the buffers
+	std::vector<std::unique_ptr<ThreadBuffer>>	m_vpBuffers;	///< The ring buffers of the threads, which recorded zones
+	size_t										m_capacity;		///< The number of zones per ring buffer
+
+	static inline thread_local ThreadBuffer*	t_pBuffer = nullptr;	///< The ring buffer of the calling thread
+	static inline thread_local dword			t_depth = 0;			///< The number of open zones of the calling thread
+};
+
+// ================================ Profile Zone Class ================================
+/**
+ * @brief Scoped profile zone class
+ * @details The zone starts with the construction of the object and ends with its destruction, when it is recorded by @ref CProfiler
+ */
+class CProfileZone
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param name The name of the zone. It must be a string literal, since only the pointer is stored
+	 */
+	explicit CProfileZone(const char* name) : m_name(name), m_depth(CProfiler::t_depth++), m_begin(getTickCount()) {}
+	CProfileZone(const CProfileZone&) = delete;
+	~CProfileZone(void)
+	{
+		CProfiler::instance().record({ m_name, m_begin, getTickCount(), m_depth });
+		CProfiler::t_depth--;
+	}
+	const CProfileZone& operator=(const CProfileZone&) = delete;
+
+
+private:
+	const char*	m_name;		///< The name of the zone
+	dword		m_depth;	///< The nesting level of the zone
+	int64		m_begin;	///< The start time in ticks
+};
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT_(a, b)
+/// Profiles the rest of the enclosing scope as the zone \b name (see @ref CProfileZone)
+#define PROFILE_ZONE(name)		CProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,233 @@
+// Visibility Buffer Rasterizer class
+#pragma once
+
+#include "Scene.h"
+#include "CameraPerspective.h"
+#include "PrimTriangle.h"
+#include "Profiler.h"
+#include "CpuDispatch.h"
+#include "ThreadPool.h"
+
+// ================================ Rasterizer Class ================================
+/**
+ * @brief Visibility buffer rasterizer class
+ * @details The primary rays of a perspective camera share one origin, thus the primary visibility of the triangles may be resolved by
+ * rasterization instead of ray tracing. The direction of the primary ray is a linear function of the pixel coordinates
+ * (see CCameraPerspective::getRayDirection()), therefore the denominator and the numerators of the barycentric coordinates
+ * of the ray - triangle intersection are linear functions of the pixel coordinates too. The three edge functions u, v and 1 - u - v
+ * are evaluated in the pixel centers (half-space rasterization), and the resulting visibility buffer holds exactly the hits,
+ * the primary rays would find: the primitive, the barycentric coordinates and the hit distance.
+ *
+ * The triangles are binned into screen tiles, which are rasterized in parallel by the workers of the render engine. The visibility buffer is a structure of arrays and
+ * every span of pixels is rasterized by the SIMD kernel of the CPU (see KernelTable::rasterize), which evaluates the edge functions
+ * and the depth test for blocks of 4 to 16 pixels at once. Thus the primary visibility costs O(triangles + pixels)
+ * instead of O(pixels x traversal). The primitives, which are not triangles, are not rasterized (see getTracedPrims()).
+ * @code
+ * CRasterizer rasterizer;
+ * rasterizer.rasterize(scene, pool);
+ * camera.InitRay(ray, x, y);
+ * rasterizer.getHit(x, y, ray);		// as if scene.intersect(ray) was called for the triangles
+ * @endcode
+ */
+class CRasterizer
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param tileSize The size of the screen tiles in pixels
+	 */
+	CRasterizer(int tileSize = 32) : m_tileSize(MAX(1, tileSize)) {}
+	CRasterizer(const CRasterizer&) = delete;
+	~CRasterizer(void) = default;
+	const CRasterizer& operator=(const CRasterizer&) = delete;
+
+	/**
+	 * @brief Rasterizes the triangles of the scene with its active camera into the visibility buffer
+	 * @param scene The scene
+	 * @param pool The worker threads, which rasterize the screen tiles
+	 * @retval true If the visibility buffer was filled
+	 * @retval false If the active camera is not a perspective camera
+	 */
+	bool rasterize(const CScene& scene, CThreadPool& pool)
+	{
+		PROFILE_ZONE("rasterize");
+		auto pCamera = std::dynamic_pointer_cast<CCameraPerspective>(scene.getActiveCamera());
+		if (!pCamera) return false;
+		m_resolution = pCamera->getResolution();
+		const Vec3f org = pCamera->getPosition();
+		Vec3f d0, dx, dy;
+		pCamera->getRayDirection(d0, dx, dy);
+
+		// set up the edge functions of the triangles
+		m_vpTriangles.clear();
+		m_vpTracedPrims.clear();
+		std::vector<Setup> vSetups;
+		for (auto& pPrim : scene.getPrims()) {
+			auto pTriangle = std::dynamic_pointer_cast<const CPrimTriangle>(pPrim);
+			if (!pTriangle) {
+				m_vpTracedPrims.push_back(pPrim);
+				continue;
+			}
+			Setup setup;
+			if (this->setup(*pTriangle, *pCamera, org, d0, dx, dy, setup)) {
+				setup.prim = static_cast<int>(m_vpTriangles.size());
+				m_vpTriangles.push_back(pPrim);
+				vSetups.push_back(setup);
+			}
+		}
+
+		// bin the triangles into the screen tiles
+		const int nx = (m_resolution.width + m_tileSize - 1) / m_tileSize;
+		const int ny = (m_resolution.height + m_tileSize - 1) / m_tileSize;
+		std::vector<std::vector<int>> vBins(nx * ny);
+		for (size_t s = 0; s < vSetups.size(); s++) {
+			const Rect& box = vSetups[s].box;
+			for (int ty = box.y / m_tileSize; ty <= (box.y + box.height - 1) / m_tileSize; ty++)
+				for (int tx = box.x / m_tileSize; tx <= (box.x + box.width - 1) / m_tileSize; tx++)
+					vBins[ty * nx + tx].push_back(static_cast<int>(s));
+		}
+
+		// the lengths of the ray directions convert the ray parameter into the hit distance
+		const size_t nPixels = m_resolution.area();
+		m_vHitPrims.assign(nPixels, -1);
+		m_vHitU.assign(nPixels, 0.0f);
+		m_vHitV.assign(nPixels, 0.0f);
+		m_vHitT.assign(nPixels, std::numeric_limits<float>::infinity());
+		m_vDirLengths.resize(nPixels);
+		std::vector<std::future<void>> vFutures;
+		vFutures.reserve(nx * ny);
+		for (int t = 0; t < nx * ny; t++)
+			vFutures.push_back(pool.enqueue([&, t] {
+				Rect tile = Rect((t % nx) * m_tileSize, (t / nx) * m_tileSize, m_tileSize, m_tileSize) & Rect(0, 0, m_resolution.width, m_resolution.height);
+				for (int y = tile.y; y < tile.y + tile.height; y++)
+					for (int x = tile.x; x < tile.x + tile.width; x++)
+						m_vDirLengths[y * m_resolution.width + x] = static_cast<float>(norm(d0 + (x + 0.5f) * dx + (y + 0.5f) * dy));
+				for (int s : vBins[t])
+					rasterizeTriangle(vSetups[s], vSetups[s].box & tile);
+			}));
+		for (auto& future : vFutures) future.get();
+		return true;
+	}
+	/**
+	 * @brief Fills the hit of the primary ray through the center of the pixel (x, y) from the visibility buffer
+	 * @param x The x-coordinate of the pixel
+	 * @param y The y-coordinate of the pixel
+	 * @param[in,out] ray The primary ray. Ray::t, Ray::hit, Ray::u and Ray::v are set if a triangle covers the pixel
+	 * @retval true If a triangle covers the pixel
+	 * @retval false Otherwise
+	 */
+	bool getHit(int x, int y, Ray& ray) const
+	{
+		const size_t idx = y * m_resolution.width + x;
+		if (m_vHitPrims[idx] < 0) return false;
+		ray.t = m_vHitT[idx];
+		ray.hit = m_vpTriangles[m_vHitPrims[idx]];
+		ray.u = m_vHitU[idx];
+		ray.v = m_vHitV[idx];
+		return true;
+	}
+	/**
+	 * @brief Returns the primitives, which are not rasterized
+	 * @details These primitives have to be intersected with the primary rays after getHit()
+	 * @return The primitives of the scene, which are not triangles
+	 */
+	const std::vector<ptr_prim_t>& getTracedPrims(void) const { return m_vpTracedPrims; }
+	/**
+	 * @brief Returns the size of the visibility buffer and of the primitive lists
+	 * @return The size in bytes
+	 */
+	size_t getMemory(void) const
+	{
+		return m_vHitPrims.capacity() * sizeof(int) + (m_vHitU.capacity() + m_vHitV.capacity() + m_vHitT.capacity() + m_vDirLengths.capacity()) * sizeof(float) + (m_vpTriangles.capacity() + m_vpTracedPrims.capacity()) * sizeof(ptr_prim_t);
+	}
+
+
+private:
+	/// Edge functions of a triangle: every function f(x, y) = a * x + b * y + c is stored as Vec3f(a, b, c)
+	struct Setup {
+		Vec3f	det;		///< The denominator of the barycentric coordinates
+		Vec3f	u;			///< The numerator of the barycentric coordinate u
+		Vec3f	v;			///< The numerator of the barycentric coordinate v
+		float	s;			///< The numerator of the ray parameter (constant)
+		Rect	box;		///< The screen bounding box
+		int		prim;		///< The index of the triangle
+	};
+
+	// Sets up the edge functions of the Moeller-Trumbore test for the ray org + s * (d0 + x * dx + y * dy) and the screen bounding box
+	bool setup(const CPrimTriangle& triangle, const ICamera& camera, const Vec3f& org, const Vec3f& d0, const Vec3f& dx, const Vec3f& dy, Setup& res) const
+	{
+		const Vec3f& a = triangle.getVertex(0);
+		const Vec3f edge1 = triangle.getVertex(1) - a;
+		const Vec3f edge2 = triangle.getVertex(2) - a;
+		const Vec3f tvec = org - a;
+		// det = D . (edge2 x edge1), u = D . (edge2 x tvec) / det, v = D . (tvec x edge1) / det, s = edge2 . (tvec x edge1) / det
+		const Vec3f nDet = edge2.cross(edge1);
+		const Vec3f nU = edge2.cross(tvec);
+		const Vec3f qvec = tvec.cross(edge1);
+		auto linear = [&](const Vec3f& n) { return Vec3f(dx.dot(n), dy.dot(n), d0.dot(n)); };
+		res.det = linear(nDet);
+		res.u = linear(nU);
+		res.v = linear(qvec);
+		res.s = edge2.dot(qvec);
+
+		// screen bounding box; a triangle crossing the camera plane may cover the whole screen
+		const Rect screen(0, 0, m_resolution.width, m_resolution.height);
+		float x0 = std::numeric_limits<float>::max(), y0 = x0, x1 = -x0, y1 = -x0;
+		for (size_t i = 0; i < 3; i++) {
+			auto p = camera.project(triangle.getVertex(i));
+			if (!p) {
+				res.box = screen;
+				return true;
+			}
+			x0 = MIN(x0, p.value().val[0]);
+			y0 = MIN(y0, p.value().val[1]);
+			x1 = MAX(x1, p.value().val[0]);
+			y1 = MAX(y1, p.value().val[1]);
+		}
+		if (x1 < 0 || y1 < 0 || x0 > m_resolution.width || y0 > m_resolution.height) return false;
+		// the pixel (x, y) is covered, if its center (x + 0.5, y + 0.5) lies inside; one pixel of margin absorbs the rounding
+		const int left = MAX(0, static_cast<int>(floorf(x0)) - 1);
+		const int top = MAX(0, static_cast<int>(floorf(y0)) - 1);
+		const int right = MIN(m_resolution.width, static_cast<int>(ceilf(x1)) + 1);
+		const int bottom = MIN(m_resolution.height, static_cast<int>(ceilf(y1)) + 1);
+		res.box = Rect(left, top, right - left, bottom - top);
+		return !res.box.empty();
+	}
+	// Rasterizes the triangle into the region of the visibility buffer with the depth test
+	void rasterizeTriangle(const Setup& setup, const Rect& region)
+	{
+		const KernelTable& kernels = CCpuDispatch::getKernels();
+		RasterSpan span;
+		span.det[0] = setup.det.val[0];
+		span.u[0] = setup.u.val[0];
+		span.v[0] = setup.v.val[0];
+		span.s = setup.s;
+		span.prim = setup.prim;
+		for (int y = region.y; y < region.y + region.height; y++) {
+			const float py = y + 0.5f;
+			span.det[1] = setup.det.val[1] * py + setup.det.val[2];
+			span.u[1] = setup.u.val[1] * py + setup.u.val[2];
+			span.v[1] = setup.v.val[1] * py + setup.v.val[2];
+			const size_t row = y * m_resolution.width;
+			span.dirLength = &m_vDirLengths[row];
+			span.hitPrim = &m_vHitPrims[row];
+			span.hitU = &m_vHitU[row];
+			span.hitV = &m_vHitV[row];
+			span.hitT = &m_vHitT[row];
+			// the same threshold of the determinant as CPrimTriangle::intersect() for the normalized direction
+			kernels.rasterize(span, region.x, region.x + region.width, Epsilon);
+		}
+	}
+
+
+private:
+	int							m_tileSize;			///< The size of the screen tiles in pixels
+	Size						m_resolution;		///< The resolution of the visibility buffer
+	std::vector<ptr_prim_t>		m_vpTriangles;		///< The rasterized triangles
+	std::vector<ptr_prim_t>		m_vpTracedPrims;	///< The primitives, which are not rasterized
+	std::vector<int>			m_vHitPrims;		///< The visibility buffer: the indices of the triangles (-1 - none)
+	std::vector<float>			m_vHitU;			///< The visibility buffer: the barycentric coordinates
+	std::vector<float>			m_vHitV;
+	std::vector<float>			m_vHitT;			///< The visibility buffer: the hit distances
+	std::vector<float>			m_vDirLengths;		///< The lengths of the unnormalized ray directions of the pixels
+};
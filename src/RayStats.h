@@ -0,0 +1,216 @@
+// Ray Throughput Statistics class
+#pragma once
+
+#include "ray.h"
+#include <array>
+#include <atomic>
+
+// ================================ Ray Statistics Class ================================
+/**
+ * @brief Lock-free ray throughput counters class
+ * @details Every thread counts the traced rays, the triangle tests, the BSP node visits and the hits and misses of the primary rays in its own
+ * plain thread-local counters, thus counting an event costs a single increment without any synchronization. After a unit of work
+ * (e.g. a tile) the thread publishes its counters into its slot (see publish()). A slot occupies exactly one cache line and has only one
+ * writer, thus the values are stored with relaxed atomic stores and the threads never share a cache line. The slots are linked into
+ * a lock-free list, when a thread publishes for the first time, and they are never removed, so that the counts of the finished threads are kept.
+ * At the end of a frame collect() sums the slots without locks. The counters are cumulative since the start of the application;
+ * the throughput of a frame is the difference of two collected values divided by the frame time.
+ * @code
+ * CRayStats::Counters before = CRayStats::instance().collect();
+ * engine.render(img);
+ * CRayStats::Counters frame = CRayStats::instance().collect() - before;
+ * printf("%.2f Mrays/s\n", frame.getMrays(ms));
+ * @endcode
+ * @note The counters are incremented and published with the STATS_ADD(), STATS_PRIMARY() and STATS_PUBLISH() macros, which are empty,
+ * unless the project is configured with ENABLE_STATS
+ */
+class CRayStats
+{
+public:
+	/// Counted events
+	enum class Counter : size_t {
+		primaryRays,	///< The number of primary rays
+		shadowRays,		///< The number of shadow rays
+		triangleTests,	///< The number of ray - triangle intersection tests
+		nodeVisits,		///< The number of visited BSP nodes
+		hits,			///< The number of primary rays hitting a primitive
+		misses,			///< The number of primary rays leaving the scene
+		primTests		///< The number of ray - primitive intersection tests in the BSP leaves, the occluder caches and the brute-force search
+	};
+	static constexpr size_t nCounters = 7;	///< The number of counters
+
+	/// Values of all the counters
+	struct Counters {
+		std::array<qword, nCounters> values = {};	///< The values indexed by @ref Counter
+
+		/// Returns the value of the counter \b counter
+		qword operator[](Counter counter) const { return values[static_cast<size_t>(counter)]; }
+		/// Returns the counts, which happened since \b before was collected
+		Counters operator-(const Counters& before) const
+		{
+			Counters res;
+			for (size_t c = 0; c < nCounters; c++) res.values[c] = values[c] - before.values[c];
+			return res;
+		}
+		/// Returns the number of the traced rays
+		qword getRays(void) const { return (*this)[Counter::primaryRays] + (*this)[Counter::shadowRays]; }
+		/// Returns the throughput in millions of rays per second for the time \b ms in milliseconds
+		double getMrays(double ms) const { return ms > 0 ? getRays() / (1000 * ms) : 0; }
+	};
+
+	CRayStats(const CRayStats&) = delete;
+	~CRayStats(void) = default;
+	const CRayStats& operator=(const CRayStats&) = delete;
+
+	/**
+	 * @brief Returns the statistics of the application
+	 * @return The statistics
+	 */
+	static CRayStats& instance(void)
+	{
+		static CRayStats stats;
+		return stats;
+	}
+	/**
+	 * @brief Adds \b n to the counter \b counter of the calling thread
+	 * @param counter The counter
+	 * @param n The increment
+	 */
+	static void add(Counter counter, qword n = 1) { t_values[static_cast<size_t>(counter)] += n; }
+	/**
+	 * @brief Counts the primary ray \b ray after its closest hit was found
+	 * @param ray The primary ray
+	 */
+	static void addPrimary(const Ray& ray)
+	{
+		add(Counter::primaryRays);
+		add(ray.hit ? Counter::hits : Counter::misses);
+	}
+	/**
+	 * @brief Returns the counters of the calling thread, including the ones, which are not published yet
+	 * @details The difference of two values is the cost of the work done by the thread in between (see @ref CCostMap)
+	 * @return The cumulative counters of the calling thread
+	 */
+	static Counters getLocal(void)
+	{
+		Counters res;
+		for (size_t c = 0; c < nCounters; c++) res.values[c] = t_values[c];
+		return res;
+	}
+	/**
+	 * @brief Publishes the counters of the calling thread, so that they are included in collect()
+	 */
+	static void publish(void)
+	{
+		if (!t_pSlot) t_pSlot = instance().addSlot();
+		for (size_t c = 0; c < nCounters; c++)
+			t_pSlot->values[c].store(t_values[c], std::memory_order_relaxed);		// the calling thread is the only writer
+	}
+	/**
+	 * @brief Sums the published counters of all the threads
+	 * @return The cumulative counters
+	 */
+	Counters collect(void) const
+	{
+		Counters res;
+		for (const Slot* pSlot = m_pSlots.load(std::memory_order_acquire); pSlot; pSlot = pSlot->pNext)
+			for (size_t c = 0; c < nCounters; c++)
+				res.values[c] += pSlot->values[c].load(std::memory_order_relaxed);
+		return res;
+	}
+	/**
+	 * @brief Returns the number of threads, which counted any event
+	 * @return The number of slots
+	 */
+	size_t getNumThreads(void) const
+	{
+		size_t res = 0;
+		for (const Slot* pSlot = m_pSlots.load(std::memory_order_acquire); pSlot; pSlot = pSlot->pNext) res++;
+		return res;
+	}
+	/**
+	 * @brief Writes the counters in the Prometheus text exposition format
+	 * @details The file is written under a temporary name and renamed, so that a scraping agent (e.g. the textfile collector of the
+	 * node exporter) never reads a partially written file
+	 * @param fileName The name of the file, e.g. eyden.prom
+	 * @param counters The cumulative counters (see collect())
+	 * @param ms The cumulative render time in milliseconds
+	 * @param lastFrame The counters of the last frame
+	 * @param lastFrameMs The time of the last frame in milliseconds
+	 * @retval true If the file was written
+	 * @retval false Otherwise
+	 */
+	static bool writePrometheus(const std::string& fileName, const Counters& counters, double ms, const Counters& lastFrame, double lastFrameMs)
+	{
+		const std::string tmpName = fileName + ".tmp";
+		FILE* pFile = fopen(tmpName.c_str(), "w");
+		if (!pFile) return false;
+		auto counter = [pFile](const char* name, const char* help) {
+			fprintf(pFile, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+		};
+		auto gauge = [pFile](const char* name, const char* help) {
+			fprintf(pFile, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+		};
+		counter("eyden_rays_total", "Traced rays");
+		fprintf(pFile, "eyden_rays_total{type=\"primary\"} %llu\n", static_cast<unsigned long long>(counters[Counter::primaryRays]));
+		fprintf(pFile, "eyden_rays_total{type=\"shadow\"} %llu\n", static_cast<unsigned long long>(counters[Counter::shadowRays]));
+		counter("eyden_primary_rays_total", "Primary rays by result");
+		fprintf(pFile, "eyden_primary_rays_total{result=\"hit\"} %llu\n", static_cast<unsigned long long>(counters[Counter::hits]));
+		fprintf(pFile, "eyden_primary_rays_total{result=\"miss\"} %llu\n", static_cast<unsigned long long>(counters[Counter::misses]));
+		counter("eyden_triangle_tests_total", "Ray - triangle intersection tests");
+		fprintf(pFile, "eyden_triangle_tests_total %llu\n", static_cast<unsigned long long>(counters[Counter::triangleTests]));
+		counter("eyden_primitive_tests_total", "Ray - primitive intersection tests");
+		fprintf(pFile, "eyden_primitive_tests_total %llu\n", static_cast<unsigned long long>(counters[Counter::primTests]));
+		counter("eyden_bsp_node_visits_total", "Visited BSP nodes");
+		fprintf(pFile, "eyden_bsp_node_visits_total %llu\n", static_cast<unsigned long long>(counters[Counter::nodeVisits]));
+		counter("eyden_render_seconds_total", "Time spent on rendering the frames");
+		fprintf(pFile, "eyden_render_seconds_total %.6f\n", ms / 1000);
+		gauge("eyden_mrays_per_second", "Ray throughput in millions of rays per second");
+		fprintf(pFile, "eyden_mrays_per_second{window=\"frame\"} %.4f\n", lastFrame.getMrays(lastFrameMs));
+		fprintf(pFile, "eyden_mrays_per_second{window=\"total\"} %.4f\n", counters.getMrays(ms));
+		bool res = fclose(pFile) == 0;
+#ifdef _WIN32
+		remove(fileName.c_str());								// rename() does not replace the existing files on Windows
+#endif
+		return res && rename(tmpName.c_str(), fileName.c_str()) == 0;
+	}
+
+
+private:
+	/// Counters of one thread, aligned to a cache line
+	struct alignas(64) Slot {
+		std::array<std::atomic<qword>, nCounters>	values = {};		///< The counters
+		Slot*										pNext = nullptr;	///< The next slot in the list
+	};
+
+	CRayStats(void) = default;
+
+	// Creates the slot of the calling thread and pushes it to the front of the list
+	Slot* addSlot(void)
+	{
+		Slot* pSlot = new Slot();
+		pSlot->pNext = m_pSlots.load(std::memory_order_relaxed);
+		while (!m_pSlots.compare_exchange_weak(pSlot->pNext, pSlot, std::memory_order_release, std::memory_order_relaxed));
+		return pSlot;
+	}
+
+
+private:
+	std::atomic<Slot*>	m_pSlots = nullptr;		///< The list of the slots of the threads (never freed, like the counts they hold)
+
+	static inline thread_local qword t_values[nCounters] = {};	///< The counters of the calling thread
+	static inline thread_local Slot* t_pSlot = nullptr;			///< The slot of the calling thread
+};
+
+#ifdef ENABLE_STATS
+/// Adds \b n to the counter CRayStats::Counter::counter of the calling thread
+#define STATS_ADD(counter, n)	CRayStats::add(CRayStats::Counter::counter, n)
+/// Counts the primary ray \b ray and its result (see CRayStats::addPrimary())
+#define STATS_PRIMARY(ray)		CRayStats::addPrimary(ray)
+/// Publishes the counters of the calling thread (see CRayStats::publish())
+#define STATS_PUBLISH()			CRayStats::publish()
+#else
+#define STATS_ADD(counter, n)
+#define STATS_PRIMARY(ray)
+#define STATS_PUBLISH()
+#endif
@@ -0,0 +1,519 @@
+// Tile-based Render Engine class
+#pragma once
+
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Sampler.h"
+#include "Rasterizer.h"
+#include "CostMap.h"
+#include "Profiler.h"
+#include "MemoryStats.h"
+#include <unordered_map>
+
+// ================================ Render Engine Class ================================
+/**
+ * @brief Tile-based render engine class
+ * @details This class splits the image into square tiles and renders them on its own work-stealing thread pool (see @ref CThreadPool).
+ * The tiles are ordered along a space-filling curve and every worker receives a contiguous run of this order, thus the neighbouring
+ * tiles (and the nodes of the acceleration structure they touch) are usually processed by the same thread. The workers, which
+ * finish their run early (e.g. those rendering the black background), steal the remaining tiles from the busy ones.
+ * The random number generator is reseeded for every pixel sample (see @ref CSampler), thus the image does not depend on the thread schedule.
+ * The time spent on every tile of the last frame may be retrieved with getTileTimes().
+ *
+ * By default every pixel is sampled once in its center. With setAdaptiveSampling() the engine starts every pixel with a few well-distributed
+ * samples and adds more samples only to the pixels, where the estimated error of the pixel color stays above a threshold
+ * (e.g. at the silhouettes, at the terminator and in the high-frequency textures). The number of samples spent on every pixel
+ * may be retrieved with getSampleMap() and visualized with getSampleHeatmap().
+ *
+ * In animations, where consecutive frames differ by small motions, setReprojection() lets the engine reuse the primary hits of the previous
+ * frame. Every hit is stored as the primitive index and its surface coordinates, which follow the primitive, when it moves. The hits are
+ * projected into the new frame and every primary ray is first tested against the primitive reprojected to its pixel only. The full traversal
+ * of the acceleration structure is needed only where this test fails or where no hit was reprojected (disocclusions and the first frame).
+ *
+ * With setRasterization() the primary hits of the triangles are taken from a visibility buffer (see @ref CRasterizer) instead of
+ * traversing the acceleration structure for every pixel; the shadow rays are still traced.
+ *
+ * With setCostMap() the engine records, what every pixel of the frame cost: the visited BSP nodes, the primitive tests, the shadow rays
+ * and the time (see @ref CCostMap).
+ * @code
+ * CRenderEngine engine(scene, 0, 32, CRenderEngine::TileOrder::morton);
+ * engine.render(img);
+ * @endcode
+ */
+class CRenderEngine
+{
+public:
+	/// Order, in which the tiles are distributed over the workers
+	enum class TileOrder {
+		scanline,	///< Row by row
+		morton,		///< Along the Z-order (Morton) curve
+		spiral		///< From the center of the image outwards
+	};
+	/// Rendering statistics of a tile
+	struct TileTime {
+		Rect	tile;			///< The region of the image
+		double	time = 0;		///< The rendering time in milliseconds
+		int		worker = -1;	///< The index of the worker thread, which rendered the tile
+		size_t	view = 0;		///< The index of the view in the multi-view rendering (see render(std::vector<Mat>&, const CScene&, const std::vector<size_t>&))
+	};
+	/// Statistics of the temporal reprojection of a frame
+	struct ReprojectionStats {
+		size_t	reused = 0;		///< The number of pixels, where the reprojected primitive was confirmed by the primary ray
+		size_t	rejected = 0;	///< The number of pixels, where the primary ray missed the reprojected primitive
+		size_t	traced = 0;		///< The number of pixels without a reprojected primitive
+		/// Returns the ratio of the pixels, which did not need the full traversal
+		double getHitRate(void) const { return static_cast<double>(reused) / MAX(1, reused + rejected + traced); }
+	};
+
+	/**
+	 * @brief Constructor
+	 * @param scene Reference to the scene
+	 * @param nThreads The number of worker threads. If zero, the number of concurrent threads supported by the hardware is used
+	 * @param tileSize The size of the tiles in pixels
+	 * @param order The order of the tiles
+	 */
+	CRenderEngine(CScene& scene, size_t nThreads = 0, int tileSize = 32, TileOrder order = TileOrder::morton)
+		: m_scene(scene)
+		, m_pool(nThreads)
+		, m_tileSize(MAX(1, tileSize))
+		, m_order(order)
+	{}
+	CRenderEngine(const CRenderEngine&) = delete;
+	~CRenderEngine(void) { CMemoryStats::instance().add(CMemoryStats::Subsystem::framebuffers, -static_cast<int64>(m_memory)); }
+	const CRenderEngine& operator=(const CRenderEngine&) = delete;
+
+	/**
+	 * @brief Renders the scene with the active camera
+	 * @param[out] img The image (type: CV_32FC3) of the camera resolution
+	 */
+	void render(Mat& img) { render(img, m_scene); }
+	/**
+	 * @brief Renders another scene with its active camera
+	 * @details This allows to render e.g. the snapshots of an animation (see @ref CAnimation) with the same worker threads
+	 * @param[out] img The image (type: CV_32FC3) of the camera resolution
+	 * @param scene The scene to be rendered
+	 */
+	void render(Mat& img, const CScene& scene) { render(img, scene, Rect(0, 0, img.cols, img.rows)); }
+	/**
+	 * @brief Renders a region of the image
+	 * @details This allows to split a single frame between several render processes (see @ref CWorker)
+	 * @param[in,out] img The image (type: CV_32FC3) of the camera resolution. Only the pixels inside the region \b region are written
+	 * @param scene The scene to be rendered
+	 * @param region The region of the image
+	 */
+	void render(Mat& img, const CScene& scene, const Rect& region)
+	{
+		std::vector<Rect> vTiles = getTiles(region.size(), m_tileSize, m_order);
+		for (auto& tile : vTiles) {
+			tile.x += region.x;
+			tile.y += region.y;
+		}
+		m_vTileTimes.assign(vTiles.size(), TileTime());
+		m_sampleMap = Mat(img.size(), CV_32SC1, Scalar(1));
+		m_rasterized = m_pRasterizer && m_maxSamples < 2 && m_pRasterizer->rasterize(scene, m_pool);
+		m_reprojected = m_reprojection && !m_rasterized;
+		if (m_reprojected) reproject(scene, img.size());
+		m_vTileReprojection.assign(vTiles.size(), ReprojectionStats());
+		if (m_pCostMap) m_pCostMap->clear(img.size());
+
+		auto pCamera = scene.getActiveCamera();
+		dispatch(vTiles.size(), [&](size_t t) { renderTile(scene, *pCamera, img, m_sampleMap, vTiles[t], m_vTileTimes[t], m_vTileReprojection[t], m_pCostMap.get()); });
+		m_reprojectionStats = ReprojectionStats();
+		for (auto& stats : m_vTileReprojection) {
+			m_reprojectionStats.reused += stats.reused;
+			m_reprojectionStats.rejected += stats.rejected;
+			m_reprojectionStats.traced += stats.traced;
+		}
+		accountMemory(img.total() * img.elemSize());
+		m_frame++;
+	}
+	/**
+	 * @brief Renders the scene with several cameras in one pass
+	 * @details The tiles of all the views are rendered as one job by the same workers over the same acceleration structure, thus
+	 * the workers, which finish a cheap view, help with the expensive ones. The rasterization and the reprojection of the primary hits
+	 * (see setRasterization() and setReprojection()) are not applied and no cost map is recorded (see setCostMap()).
+	 * After this call getSampleMap() returns the samples of the first view
+	 * @param[out] vImgs The images (type: CV_32FC3) of the camera resolutions, one per view
+	 * @param scene The scene to be rendered
+	 * @param vCameras The indices of the cameras of the scene to be rendered. If empty, all the cameras are rendered
+	 */
+	void render(std::vector<Mat>& vImgs, const CScene& scene, const std::vector<size_t>& vCameras = {})
+	{
+		std::vector<ptr_camera_t> vpCameras;
+		for (size_t c = 0; c < (vCameras.empty() ? scene.getCameras().size() : vCameras.size()); c++)
+			vpCameras.push_back(scene.getCameras().at(vCameras.empty() ? c : vCameras[c]));
+
+		vImgs.resize(vpCameras.size());
+		std::vector<Mat> vSampleMaps(vpCameras.size());
+		m_vTileTimes.clear();
+		for (size_t v = 0; v < vpCameras.size(); v++) {
+			vImgs[v] = Mat(vpCameras[v]->getResolution(), CV_32FC3, Scalar::all(0));
+			vSampleMaps[v] = Mat(vpCameras[v]->getResolution(), CV_32SC1, Scalar(1));
+			for (const Rect& tile : getTiles(vpCameras[v]->getResolution(), m_tileSize, m_order)) {
+				TileTime tileTime;
+				tileTime.tile = tile;
+				tileTime.view = v;
+				m_vTileTimes.push_back(tileTime);
+			}
+		}
+		m_rasterized = false;
+		m_reprojected = false;
+		m_vTileReprojection.assign(m_vTileTimes.size(), ReprojectionStats());
+
+		dispatch(m_vTileTimes.size(), [&](size_t t) {
+			const size_t v = m_vTileTimes[t].view;
+			renderTile(scene, *vpCameras[v], vImgs[v], vSampleMaps[v], Rect(m_vTileTimes[t].tile), m_vTileTimes[t], m_vTileReprojection[t], nullptr);
+		});
+		if (!vSampleMaps.empty()) m_sampleMap = vSampleMaps.front();
+		m_reprojectionStats = ReprojectionStats();
+		size_t bytes = 0;
+		for (size_t v = 0; v < vImgs.size(); v++) {
+			bytes += vImgs[v].total() * vImgs[v].elemSize();
+			if (v) bytes += vSampleMaps[v].total() * vSampleMaps[v].elemSize();		// the first one is m_sampleMap
+		}
+		accountMemory(bytes);
+		m_frame++;
+	}
+	/**
+	 * @brief Returns the rendering statistics of the tiles of the last frame
+	 * @return The statistics for every tile
+	 */
+	const std::vector<TileTime>& getTileTimes(void) const { return m_vTileTimes; }
+	/**
+	 * @brief Returns the number of worker threads
+	 * @return The number of worker threads
+	 */
+	size_t getNumThreads(void) const { return m_pool.getNumThreads(); }
+	/**
+	 * @brief Returns the number of tiles, which were stolen by another worker
+	 * @return The number of stolen tiles since the creation of the engine
+	 */
+	size_t getNumSteals(void) const { return m_pool.getNumSteals(); }
+	/**
+	 * @brief Sets the index of the next rendered frame
+	 * @details The frame index seeds the samplers, thus the processes rendering different regions of the same frame should agree on it
+	 * @param frame The frame index
+	 */
+	void setFrame(dword frame) { m_frame = frame; }
+	/**
+	 * @brief Sets the size of the tiles
+	 * @param tileSize The size of the tiles in pixels
+	 */
+	void setTileSize(int tileSize) { m_tileSize = MAX(1, tileSize); }
+	/**
+	 * @brief Sets the order of the tiles
+	 * @param order The order of the tiles
+	 */
+	void setTileOrder(TileOrder order) { m_order = order; }
+	/**
+	 * @brief Enables the adaptive anti-aliasing
+	 * @details Every pixel starts with \b minSamples samples. While the standard error of the mean pixel color
+	 * (in any of the color channels) exceeds \b threshold, another round of \b minSamples samples is added, until
+	 * \b maxSamples are reached. The sample positions are taken from the low-discrepancy sequence of @ref CSampler
+	 * @param minSamples The initial number of samples per pixel, limited to \b maxSamples
+	 * @param maxSamples The maximal number of samples per pixel. If smaller than 2, every pixel is sampled once in its center
+	 * @param threshold The maximal acceptable standard error of the pixel color
+	 */
+	void setAdaptiveSampling(size_t minSamples, size_t maxSamples, float threshold)
+	{
+		m_minSamples = MAX(1, MIN(minSamples, maxSamples));
+		m_maxSamples = maxSamples;
+		m_threshold = threshold;
+	}
+	/**
+	 * @brief Enables the temporal reprojection of the primary hits
+	 * @details The reprojection is applied, when every pixel is sampled once (see setAdaptiveSampling()) and the frames keep the resolution
+	 * and the primitives in the same order, e.g. the snapshots of an animation (see @ref CAnimation) or a scene with primitives transformed in place.
+	 * Only the primitives providing the surface coordinates (see IPrim::getSurfacePoint()) and the cameras supporting the projection
+	 * (see ICamera::project()) take part.
+	 * @note Geometry, which was hidden in the previous frame and appears in front of a confirmed primitive, is missed. The reprojection
+	 * is therefore meant for the small motions between consecutive frames
+	 * @param enable True in order to enable the reprojection, false in order to trace every primary ray from scratch
+	 */
+	void setReprojection(bool enable)
+	{
+		m_reprojection = enable;
+		m_vHits.clear();
+	}
+	/**
+	 * @brief Enables the rasterization of the primary visibility
+	 * @details The rasterization is applied, when every pixel is sampled once (see setAdaptiveSampling()) with a perspective camera.
+	 * It replaces the temporal reprojection (see setReprojection())
+	 * @param enable True in order to rasterize the triangles into a visibility buffer, false in order to trace the primary rays
+	 */
+	void setRasterization(bool enable) { m_pRasterizer = enable ? std::make_unique<CRasterizer>(m_tileSize) : nullptr; }
+	/**
+	 * @brief Enables the recording of the render cost of every pixel
+	 * @details The per-pixel time includes the overhead of the time measurement itself, thus it is meant for the comparison of the pixels
+	 * rather than for the absolute timing
+	 * @param enable True in order to record the cost map of every frame (see getCostMap())
+	 */
+	void setCostMap(bool enable) { m_pCostMap = enable ? std::make_unique<CCostMap>() : nullptr; }
+	/**
+	 * @brief Returns the render cost of every pixel of the last frame
+	 * @return The pointer to the cost map or nullptr if the recording is not enabled (see setCostMap())
+	 */
+	const CCostMap* getCostMap(void) const { return m_pCostMap.get(); }
+	/**
+	 * @brief Returns the statistics of the temporal reprojection of the last frame
+	 * @return The numbers of pixels, which reused the reprojected hits or needed the full traversal
+	 */
+	const ReprojectionStats& getReprojectionStats(void) const { return m_reprojectionStats; }
+	/**
+	 * @brief Returns the number of samples spent on every pixel of the last frame
+	 * @return The sample map (type: CV_32SC1)
+	 */
+	const Mat& getSampleMap(void) const { return m_sampleMap; }
+	/**
+	 * @brief Returns the number of samples spent on every pixel of the last frame as a heatmap
+	 * @return The color-coded sample map (type: CV_8UC3), where the maximal number of samples per pixel is mapped to red
+	 */
+	Mat getSampleHeatmap(void) const
+	{
+		Mat res;
+		m_sampleMap.convertTo(res, CV_8UC1, 255.0 / MAX(1, m_maxSamples));
+		applyColorMap(res, res, COLORMAP_JET);
+		return res;
+	}
+	/**
+	 * @brief Splits the image into tiles
+	 * @param resolution The resolution of the image
+	 * @param tileSize The size of the tiles in pixels. The tiles at the right and bottom borders may be smaller
+	 * @param order The order of the tiles
+	 * @return The regions of the tiles in the given order
+	 */
+	static std::vector<Rect> getTiles(Size resolution, int tileSize, TileOrder order)
+	{
+		const int nx = (resolution.width + tileSize - 1) / tileSize;
+		const int ny = (resolution.height + tileSize - 1) / tileSize;
+
+		std::vector<Point> vCells;
+		vCells.reserve(nx * ny);
+		for (int y = 0; y < ny; y++)
+			for (int x = 0; x < nx; x++)
+				vCells.emplace_back(x, y);
+
+		switch (order) {
+			case TileOrder::scanline: break;
+			case TileOrder::morton:
+				std::sort(vCells.begin(), vCells.end(), [](const Point& a, const Point& b) { return morton(a) < morton(b); });
+				break;
+			case TileOrder::spiral: {
+				// rings of growing Chebyshev distance from the center, every ring is walked by angle
+				const Point2f center(0.5f * (nx - 1), 0.5f * (ny - 1));
+				auto ring = [&center](const Point& p) { return MAX(fabsf(p.x - center.x), fabsf(p.y - center.y)); };
+				auto angle = [&center](const Point& p) { return atan2f(p.y - center.y, p.x - center.x); };
+				std::sort(vCells.begin(), vCells.end(), [&](const Point& a, const Point& b) {
+					float ra = ring(a), rb = ring(b);
+					return ra != rb ? ra < rb : angle(a) < angle(b);
+				});
+				break;
+			}
+		}
+
+		std::vector<Rect> vTiles;
+		vTiles.reserve(vCells.size());
+		const Rect image(0, 0, resolution.width, resolution.height);
+		for (const Point& cell : vCells)
+			vTiles.push_back(Rect(cell.x * tileSize, cell.y * tileSize, tileSize, tileSize) & image);
+		return vTiles;
+	}
+
+
+private:
+	// Accounts the images of \b imgBytes bytes and the per-pixel buffers of the engine as framebuffers (see CMemoryStats)
+	void accountMemory(size_t imgBytes)
+	{
+		size_t bytes = imgBytes + m_sampleMap.total() * m_sampleMap.elemSize() + m_vHits.capacity() * sizeof(Hit) + m_vCandidates.capacity() * sizeof(int);
+		if (m_pRasterizer) bytes += m_pRasterizer->getMemory();
+		if (m_pCostMap) bytes += m_pCostMap->getMemory();
+		CMemoryStats::instance().add(CMemoryStats::Subsystem::framebuffers, static_cast<int64>(bytes) - static_cast<int64>(m_memory));
+		m_memory = bytes;
+	}
+	// Runs the jobs 0 .. nJobs - 1 on the workers and waits for them
+	void dispatch(size_t nJobs, const std::function<void(size_t)>& fnJob)
+	{
+		// every worker receives a contiguous run of jobs, which is enqueued in reverse order,
+		// so that the owner takes the jobs in the curve order and the thieves take them from the end of the run
+		const size_t nWorkers = m_pool.getNumThreads();
+		std::vector<std::future<void>> vFutures;
+		vFutures.reserve(nJobs);
+		for (size_t w = 0; w < nWorkers; w++) {
+			size_t begin = w * nJobs / nWorkers;
+			size_t end = (w + 1) * nJobs / nWorkers;
+			for (size_t j = end; j > begin; j--)
+				vFutures.push_back(m_pool.enqueue([&fnJob, j] { fnJob(j - 1); }, w));
+		}
+		for (auto& future : vFutures)
+			future.get();
+	}
+	// Renders one tile and measures the time; the cost of every pixel is stored in the cost map \b pCostMap, if it is given
+	void renderTile(const CScene& scene, ICamera& camera, Mat& img, Mat& sampleMap, const Rect& tile, TileTime& stats, ReprojectionStats& reprojection, CCostMap* pCostMap)
+	{
+		PROFILE_ZONE("trace");
+		int64 ticks = getTickCount();
+		Ray ray;												// primary ray
+		RayBatch batch;											// primary rays through the pixel centers
+		if (m_maxSamples < 2) camera.InitRays(batch, tile);
+		size_t i = 0;
+		for (int y = tile.y; y < tile.y + tile.height; y++) {
+			Vec3f* pImg = img.ptr<Vec3f>(y);					// fast processing via pointers
+			int* pSamples = sampleMap.ptr<int>(y);
+			for (int x = tile.x; x < tile.x + tile.width; x++, i++) {
+				int64 pixelTicks = 0;
+				CRayStats::Counters pixelCounters;
+				if (pCostMap) {
+					pixelCounters = CRayStats::getLocal();
+					pixelTicks = getTickCount();
+				}
+				if (m_maxSamples < 2) {
+					Random::seed(CSampler(x, y, m_frame).getSeed(0));
+					batch.getRay(i, ray);						// initialize ray
+					if (m_rasterized) pImg[x] = shadeRasterized(scene, ray, x, y);
+					else pImg[x] = m_reprojected ? traceReprojected(scene, ray, y * img.cols + x, reprojection) : scene.RayTrace(ray);
+					STATS_PRIMARY(ray);
+				}
+				else
+					pImg[x] = samplePixel(scene, camera, ray, x, y, pSamples[x]);
+				if (pCostMap)
+					pCostMap->set(x, y, CRayStats::getLocal() - pixelCounters, static_cast<float>(1e9 * (getTickCount() - pixelTicks) / getTickFrequency()));
+			} // x
+		} // y
+		stats.tile = tile;
+		stats.time = 1000.0 * (getTickCount() - ticks) / getTickFrequency();
+		stats.worker = CThreadPool::getWorkerIndex();
+		STATS_PUBLISH();
+	}
+	// Moves the primary hits of the previous frame to the pixels, where they appear in the current frame
+	void reproject(const CScene& scene, Size resolution)
+	{
+		PROFILE_ZONE("reproject");
+		const auto& vpPrims = scene.getPrims();
+		m_mPrimIndices.clear();
+		for (size_t i = 0; i < vpPrims.size(); i++)
+			m_mPrimIndices[vpPrims[i].get()] = static_cast<int>(i);
+
+		const size_t nPixels = static_cast<size_t>(resolution.area());
+		m_vCandidates.assign(nPixels, -1);
+		if (m_vHits.size() == nPixels && m_nHitPrims == vpPrims.size()) {
+			auto pCamera = scene.getActiveCamera();
+			std::vector<float> vDepths(nPixels, std::numeric_limits<float>::infinity());
+			for (const Hit& hit : m_vHits) {
+				if (hit.prim < 0) continue;
+				auto point = vpPrims[hit.prim]->getSurfacePoint(hit.u, hit.v);
+				auto projection = point ? pCamera->project(point.value()) : std::nullopt;
+				if (!projection) continue;
+				const Vec3f& p = projection.value();
+				if (p.val[0] < 0 || p.val[1] < 0 || p.val[0] >= resolution.width || p.val[1] >= resolution.height) continue;
+				size_t idx = static_cast<size_t>(p.val[1]) * resolution.width + static_cast<size_t>(p.val[0]);
+				if (p.val[2] < vDepths[idx]) {						// the nearest reprojected hit wins
+					vDepths[idx] = p.val[2];
+					m_vCandidates[idx] = hit.prim;
+				}
+			}
+		}
+		m_vHits.assign(nPixels, Hit());
+		m_nHitPrims = vpPrims.size();
+	}
+	// Traces the primary ray against the reprojected primitive first and stores the hit for the next frame
+	Vec3f traceReprojected(const CScene& scene, Ray& ray, size_t idx, ReprojectionStats& stats)
+	{
+		Vec3f res;
+		ray.hit = nullptr;
+		const int candidate = m_vCandidates[idx];
+		if (candidate >= 0 && scene.getPrims()[candidate]->intersect(ray)) {
+			auto active = scene.activate();
+			res = ray.hit->getShader()->shade(ray);
+			stats.reused++;
+		}
+		else {
+			if (candidate >= 0) stats.rejected++;
+			else stats.traced++;
+			res = scene.RayTrace(ray);
+		}
+		if (ray.hit) m_vHits[idx] = { m_mPrimIndices.at(ray.hit.get()), ray.u, ray.v };
+		return res;
+	}
+	// Takes the primary hit from the visibility buffer, intersects the primitives, which were not rasterized, and shades the hit
+	Vec3f shadeRasterized(const CScene& scene, Ray& ray, int x, int y) const
+	{
+		ray.hit = nullptr;
+		m_pRasterizer->getHit(x, y, ray);
+		for (auto& pPrim : m_pRasterizer->getTracedPrims())
+			pPrim->intersect(ray);
+		auto active = scene.activate();
+		return ray.hit ? ray.hit->getShader()->shade(ray) : scene.getBackgroundColor();
+	}
+	// Samples the pixel (x, y) adaptively and returns the mean color
+	Vec3f samplePixel(const CScene& scene, ICamera& camera, Ray& ray, int x, int y, int& nSamples) const
+	{
+		CSampler sampler(x, y, m_frame);
+		Vec3f mean = Vec3f::all(0);
+		Vec3f m2 = Vec3f::all(0);								// sum of squared differences from the mean (Welford's algorithm)
+		size_t n = 0;
+		for (;;) {
+			for (size_t k = 0; k < m_minSamples; k++) {
+				Random::seed(sampler.getSeed(n));
+				camera.InitRay(ray, x, y, sampler.get2D(n));
+				Vec3f color = scene.RayTrace(ray);
+				STATS_PRIMARY(ray);
+				n++;
+				Vec3f delta = color - mean;
+				mean += delta / static_cast<float>(n);
+				m2 += delta.mul(color - mean);
+			}
+			if (n + m_minSamples > m_maxSamples) break;
+			if (n < 2) continue;
+
+			// standard error of the mean
+			float error = 0;
+			for (int c = 0; c < 3; c++)
+				error = MAX(error, sqrtf(m2.val[c] / ((n - 1) * n)));
+			if (error <= m_threshold) break;
+		}
+		nSamples = static_cast<int>(n);
+		return mean;
+	}
+	// Interleaves the bits of the cell coordinates
+	static uint64_t morton(const Point& cell)
+	{
+		uint64_t res = 0;
+		for (int b = 0; b < 16; b++) {
+			res |= static_cast<uint64_t>((cell.x >> b) & 1) << (2 * b);
+			res |= static_cast<uint64_t>((cell.y >> b) & 1) << (2 * b + 1);
+		}
+		return res;
+	}
+
+
+private:
+	CScene&					m_scene;				///< The scene
+	CThreadPool				m_pool;					///< The worker threads
+	int						m_tileSize;				///< The size of the tiles in pixels
+	TileOrder				m_order;				///< The order of the tiles
+	std::vector<TileTime>	m_vTileTimes;			///< The rendering statistics of the tiles of the last frame
+	size_t					m_minSamples = 1;		///< The number of samples per pixel in every sampling round
+	size_t					m_maxSamples = 1;		///< The maximal number of samples per pixel
+	float					m_threshold = 0;		///< The maximal acceptable standard error of the pixel color
+	Mat						m_sampleMap;			///< The number of samples spent on every pixel of the last frame
+	dword					m_frame = 0;			///< The index of the current frame, used as the seed of the samplers
+	size_t					m_memory = 0;			///< The size of the framebuffers of the last frame accounted in @ref CMemoryStats
+
+	/// Primary hit of a pixel
+	struct Hit {
+		int		prim = -1;		///< The index of the primitive in the scene (-1 - background)
+		float	u = 0;			///< The surface coordinates of the hit point
+		float	v = 0;
+	};
+	std::unique_ptr<CRasterizer>	m_pRasterizer;	///< The rasterizer of the primary visibility (nullptr - ray tracing)
+	std::unique_ptr<CCostMap>		m_pCostMap;		///< The render cost of the pixels of the last frame (nullptr - not recorded)
+	bool					m_rasterized = false;	///< Flag indicating that the current frame uses the visibility buffer
+	bool					m_reprojection = false;	///< Flag indicating the temporal reprojection
+	bool					m_reprojected = false;	///< Flag indicating that the current frame uses the reprojected hits
+	std::vector<Hit>		m_vHits;				///< The primary hits of the last frame
+	size_t					m_nHitPrims = 0;		///< The number of primitives in the scene of the last frame
+	std::vector<int>		m_vCandidates;			///< The primitives reprojected to the pixels of the current frame
+	std::unordered_map<const IPrim*, int>	m_mPrimIndices;	///< The indices of the primitives of the current frame
+	std::vector<ReprojectionStats>	m_vTileReprojection;	///< The reprojection statistics of the tiles of the current frame
+	ReprojectionStats		m_reprojectionStats;	///< The reprojection statistics of the last frame
+};
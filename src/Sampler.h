@@ -0,0 +1,92 @@
+// Sampler class
+#pragma once
+
+#include "random.h"
+
+// ================================ Sampler Class ================================
+/**
+ * @brief Deterministic sampler class
+ * @details This class generates the sample positions for a single pixel. The samples are the points of the R2 low-discrepancy sequence
+ * (the 2-dimensional generalization of the golden ratio sequence, see <a href="http://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/">M. Roberts</a>),
+ * which fill the pixel much more evenly than independent random points. Every pixel and every dimension uses the sequence with its own
+ * random offset (Cranley-Patterson rotation), so that the neighbouring pixels are decorrelated.
+ * All values depend only on the pixel coordinates, the sample index, the dimension and the seed; they do not depend on the thread
+ * rendering the pixel or on the order, in which the pixels are rendered. The sequences are evaluated in 32-bit fixed point arithmetic,
+ * thus a sample costs one multiplication and one addition.
+ * @code
+ * CSampler sampler(x, y, frame);
+ * for (size_t s = 0; s < nSamples; s++) {
+ *	Random::seed(sampler.getSeed(s));		// the random decisions in the shaders become reproducible too
+ *	camera.InitRay(ray, x, y, sampler.get2D(s));
+ *	...
+ * }
+ * @endcode
+ */
+class CSampler
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param x The x-coordinate of the pixel
+	 * @param y The y-coordinate of the pixel
+	 * @param seed The seed, e.g. the frame number
+	 */
+	CSampler(int x, int y, dword seed = 0) : m_hash(hash(static_cast<dword>(x) ^ hash(static_cast<dword>(y) ^ hash(seed)))) {}
+	~CSampler(void) = default;
+
+	/**
+	 * @brief Returns a 2-dimensional sample from the R2 sequence
+	 * @param index The index of the sample
+	 * @param dim The index of the dimension pair. Different pairs are decorrelated
+	 * @return The sample from the interval [0; 1)<sup>2</sup>
+	 */
+	Vec2f get2D(size_t index, dword dim = 0) const
+	{
+		const dword i = static_cast<dword>(index);
+		dword x = hash(m_hash ^ (2 * dim + 0)) + i * R2_A1;
+		dword y = hash(m_hash ^ (2 * dim + 1)) + i * R2_A2;
+		return Vec2f(toFloat(x), toFloat(y));
+	}
+	/**
+	 * @brief Returns a 1-dimensional sample from the golden ratio sequence
+	 * @param index The index of the sample
+	 * @param dim The index of the dimension. Different dimensions are decorrelated
+	 * @return The sample from the interval [0; 1)
+	 */
+	float get1D(size_t index, dword dim = 0) const
+	{
+		return toFloat(hash(m_hash ^ ~dim) + static_cast<dword>(index) * R1_A);
+	}
+	/**
+	 * @brief Returns the seed for the random number generator for the sample \b index
+	 * @details This seed may be passed to Random::seed() before tracing the sample, in order to make the random
+	 * decisions made during the shading (e.g. the stochastic light selection) deterministic
+	 * @param index The index of the sample
+	 * @return The seed
+	 */
+	qword getSeed(size_t index) const { return (static_cast<qword>(m_hash) << 32) | hash(m_hash + static_cast<dword>(index)); }
+	/**
+	 * @brief Integer hash function
+	 * @details The output permutation of the PCG generator applied to one LCG step. It is cheap and has a good avalanche behaviour
+	 * @param value The value
+	 * @return The hash of \b value
+	 */
+	static dword hash(dword value)
+	{
+		dword state = value * 747796405u + 2891336453u;
+		dword word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+		return (word >> 22) ^ word;
+	}
+
+
+private:
+	static float toFloat(dword x) { return static_cast<float>(x >> 8) * (1.0f / 16777216.0f); }
+
+
+private:
+	static constexpr dword R1_A = 2654435769u;		///< 2<sup>32</sup> / &phi; (golden ratio)
+	static constexpr dword R2_A1 = 3242174889u;		///< 2<sup>32</sup> / &phi;<sub>2</sub> (plastic number)
+	static constexpr dword R2_A2 = 2447445414u;		///< 2<sup>32</sup> / &phi;<sub>2</sub><sup>2</sup>
+
+	dword m_hash;	///< The hash of the pixel coordinates and the seed
+};
@@ -6,6 +6,12 @@
 #include "IPrim.h"
 #include "ICamera.h"
 #include "Solid.h"
+#include "LightTree.h"
+#include "OccluderCache.h"
+#include "RayStats.h"
+#include <atomic>
+#include <future>
+#include "Profiler.h"
 #ifdef ENABLE_BSP
 #include "BSPTree.h"
 #endif
@@ -45,6 +51,8 @@ public:
 	void add(const ptr_light_t pLight)
 	{
 		m_vpLights.push_back(pLight);
+		m_lightTreeValid = false;			// the tree is re-built at the next call of buildAccelStructure()
+		if (pLight->shadow()) m_nShadowLights++;
 	}
 	/**
 	 * @brief Adds a new camera to the scene and makes it to ba active
@@ -64,6 +72,31 @@ public:
 		for (const auto& pPrim : solid.getPrims())
 			add(pPrim);
 	}
+	/**
+	 * @brief Adds a solid, which is still being loaded, to the scene
+	 * @details The solid is resolved lazily, \a i.e. at the next call of buildAccelStructure()
+	 * @param solid The future holding the pointer to the solid (see @ref CAssetLoader)
+	 */
+	void add(const std::shared_future<ptr_solid_t>& solid)
+	{
+		m_vPendingSolids.push_back(solid);
+	}
+	/**
+	 * @brief Removes the primitives, the lights and the cameras from the scene
+	 * @details The acceleration structure keeps its arenas, so that re-filling and re-building the scene, e.g. for the next frame of
+	 * an animation (see CAnimation::snapshot()), allocates only if the scene grows. The scene may be rendered only after the next
+	 * call of buildAccelStructure()
+	 */
+	void clear(void)
+	{
+		m_vpPrims.clear();
+		m_vpLights.clear();
+		m_lightTreeValid = false;
+		m_nShadowLights = 0;
+		m_vpCameras.clear();
+		m_activeCamera = 0;
+		m_vPendingSolids.clear();
+	}
 	/**
 	 * @brief Sets the active camera
 	 * @param activeCamera The new active camera index
@@ -75,25 +108,112 @@ public:
 	/**
 	 * @brief (Re-) Build the BSP tree for the current geometry present in scene
 	 * @details This function takes into accound all the primitives in scene and builds the BSP tree with the root node in \b m_pBSPTree variable.
-	 * If the geometry in the scene was updated the BSP tree should be re-built
+	 * If the geometry in the scene was updated the BSP tree should be re-built. The solids added via futures are resolved here.
+	 * This function also (re-) builds the light tree, see @ref CLightTree
 	 * @param maxDepth The maximum allowed depth of the tree.
 	 * Increasing the depth of the tree may speed-up rendering, but increse the memory consumption.
 	 * @param minPrimitives The minimum number of primitives in a leaf-node.
 	 * This parameters should be alway above 1.
 	 */
-	void buildAccelStructure(size_t maxDepth, size_t minPrimitives) {
+	void buildAccelStructure([[maybe_unused]] size_t maxDepth, [[maybe_unused]] size_t minPrimitives) {
+		PROFILE_ZONE("bsp build");
+		// wait for the solids, which are still being loaded
+		for (auto& solid : m_vPendingSolids)
+			add(*solid.get());
+		m_vPendingSolids.clear();
+		m_lightTree.build(m_vpLights);
+		m_lightTreeValid = true;
+		m_generation = newGeneration();
 #ifdef ENABLE_BSP
 		m_pBSPTree->build(m_vpPrims, maxDepth, minPrimitives);
 #else 
 		printf("Warning: BSP support is not enabled!\n");
 #endif		
 	}
+	/**
+	 * @brief Returns the bounding box of the scene geometry
+	 * @details The solids, which are still being loaded, are not taken into account
+	 * @return The smallest axis-aligned box containing all the primitives of the scene
+	 */
+	CBoundingBox getBoundingBox(void) const
+	{
+		CBoundingBox res;
+		for (auto& pPrim : m_vpPrims)
+			res.extend(pPrim->getBoundingBox());
+		return res;
+	}
+	/**
+	 * @brief Sets the share of the memory budgets, which the BSP tree of the scene may use (see CBSPTree::setBudgetShare())
+	 * @param nShares The number of scenes, whose trees exist at the same time
+	 */
+	void setBudgetShare([[maybe_unused]] size_t nShares)
+	{
+#ifdef ENABLE_BSP
+		m_pBSPTree->setBudgetShare(nShares);
+#endif
+	}
+	/**
+	 * @brief Returns the container with all scene primitives
+	 * @return The vector with pointers to the scene primitives
+	 */
+	const std::vector<ptr_prim_t>& getPrims(void) const { return m_vpPrims; }
+	/**
+	 * @brief Returns the container with all scene cameras
+	 * @return The vector with pointers to the scene cameras
+	 */
+	const std::vector<ptr_camera_t>& getCameras(void) const { return m_vpCameras; }
+	/**
+	 * @brief Returns the index of the active camera
+	 * @return The index of the active camera
+	 */
+	size_t getActiveCameraIndex(void) const { return m_activeCamera; }
 	/**
 	 * @brief Returns the container with all scene light source objects
 	 * @note This method is to be used only in OpenRT shaders
 	 * @return The vector with pointers to the scene light sources
 	 */
-	const std::vector<ptr_light_t>	getLights(void) const { return m_vpLights; }
+	const std::vector<ptr_light_t>&	getLights(void) const { return m_vpLights; }
+	/**
+	 * @brief Checks whether any light source of the scene casts shadows
+	 * @retval true If at least one light source casts shadows
+	 * @retval false Otherwise
+	 */
+	bool castsShadows(void) const { return m_nShadowLights > 0; }
+	/**
+	 * @brief Visits the light sources, which illuminate the point \b p
+	 * @details The callback function \b fn is called for every selected light source as fn(ILight& light, float weight).
+	 * The light's contribution should be multiplied with the \a weight. See @ref CLightTree for details.
+	 * If lights were added after the last call of buildAccelStructure() (or it was not called yet), all the lights are visited with unit weight
+	 * @param p The point to be illuminated
+	 * @param fn The callback function
+	 */
+	template <typename F>
+	void forEachLight(const Vec3f& p, F&& fn) const
+	{
+		if (m_lightTreeValid) m_lightTree.forEachLight(p, fn);
+		else for (auto& pLight : m_vpLights) fn(*pLight, 1.0f);
+	}
+	/**
+	 * @brief Sets the light sampling parameters
+	 * @param threshold The light sources, whose attenuated intensity at the shading point is below this threshold, are skipped. Zero value disables culling
+	 * @param nSamples The number of stochastically chosen light sources per shading point. Zero value enables the exact mode, where all the
+	 * not-culled light sources are visited
+	 */
+	void setLightSampling(float threshold, size_t nSamples = 0)
+	{
+		m_lightTree.setThreshold(threshold);
+		m_lightTree.setNumSamples(nSamples);
+	}
+	/**
+	 * @brief Returns the light sampling parameters
+	 * @return The culling threshold and the number of stochastically chosen light sources per shading point (see setLightSampling())
+	 */
+	std::pair<float, size_t> getLightSampling(void) const { return std::make_pair(m_lightTree.getThreshold(), m_lightTree.getNumSamples()); }
+	/**
+	 * @brief Returns the background color
+	 * @return The background color
+	 */
+	Vec3f getBackgroundColor(void) const { return m_bgColor; }
 	/**
 	 * @brief Returns the active camera
 	 * @retval ptr_camera_t The pointer to active camera
@@ -112,6 +232,7 @@ public:
 		return m_pBSPTree->intersect(ray);
 #else
 		bool hit = false;
+		STATS_ADD(primTests, m_vpPrims.size());
 		for (auto& pPrim : m_vpPrims)
 			hit |= pPrim->intersect(ray);
 		return hit;
@@ -121,8 +242,9 @@ public:
 	/**
 	 * find occluder
 	 */
-	bool occluded(Ray& ray)
+	bool occluded(Ray& ray) const
 	{
+		STATS_ADD(shadowRays, 1);
 #ifdef ENABLE_BSP
 		return m_pBSPTree->intersect(lvalue_cast(Ray(ray)));
 #else
@@ -131,6 +253,88 @@ public:
 		return false;
 #endif
 	}
+	/**
+	 * @brief Checks whether the shadow ray \b ray towards the light source \b pLight is occluded
+	 * @details This function tests the last occluder of the light source from \b cache first and traverses the acceleration structure
+	 * only if the cached primitive does not block the ray. The cache is updated with the found occluder
+	 * @param ray The shadow ray
+	 * @param cache The occluder cache of the calling thread
+	 * @param pLight Pointer to the light source
+	 * @retval true If ray \b ray intersects any object
+	 * @retval false otherwise
+	 */
+	bool occluded(const Ray& ray, COccluderCache& cache, const ILight* pLight) const
+	{
+		STATS_ADD(shadowRays, 1);
+		cache.validate(m_generation);
+		const IPrim*& pOccluder = cache.get(pLight);
+		if (pOccluder) {
+			STATS_ADD(primTests, 1);
+			bool hit = pOccluder->occluded(lvalue_cast(Ray(ray)));
+			cache.count(hit);
+			if (hit) return true;
+		}
+
+		Ray shadow(ray);
+#ifdef ENABLE_BSP
+		if (m_pBSPTree->intersect(shadow)) {
+			pOccluder = shadow.hit.get();
+			return true;
+		}
+#else
+		STATS_ADD(primTests, m_vpPrims.size());
+		for (auto& pPrim : m_vpPrims)
+			if (pPrim->occluded(shadow)) {
+				pOccluder = pPrim.get();
+				return true;
+			}
+#endif
+		return false;
+	}
+	/**
+	 * @brief Returns the identifier of the current version of the scene geometry
+	 * @details A new identifier is generated every time the acceleration structure is (re-) built
+	 * @return The identifier of the current version of the scene geometry
+	 */
+	size_t getGeneration(void) const { return m_generation; }
+
+	// ==================== Activation Class ====================
+	/**
+	 * @brief Scope guard of the active scene
+	 * @details Restores the scene, which was active in the calling thread before, when it goes out of scope
+	 */
+	class CActivation
+	{
+	public:
+		~CActivation(void) { t_pActive = m_pPrevious; }
+		CActivation(const CActivation&) = delete;
+		const CActivation& operator=(const CActivation&) = delete;
+
+	private:
+		friend class CScene;
+		explicit CActivation(const CScene* pScene) : m_pPrevious(t_pActive) { t_pActive = pScene; }
+
+	private:
+		const CScene* m_pPrevious;	///< The scene, which was active before
+	};
+
+	/**
+	 * @brief Makes the scene active in the calling thread
+	 * @details The shaders may be shared between several scenes, e.g. between the snapshots of an animation (see @ref CAnimation),
+	 * but they keep a reference only to the scene they were created for. Therefore the shaders query the lights and the occluders
+	 * of the active scene (see getActive()). RayTrace() activates the scene automatically
+	 * @code
+	 * auto active = scene.activate();
+	 * @endcode
+	 * @return The guard, which keeps the scene active until it goes out of scope
+	 */
+	[[nodiscard]] CActivation activate(void) const { return CActivation(this); }
+	/**
+	 * @brief Returns the scene, which is active in the calling thread
+	 * @param scene The scene to be returned if no scene was activated in the calling thread
+	 * @return The active scene
+	 */
+	static const CScene& getActive(const CScene& scene) { return t_pActive ? *t_pActive : scene; }
 
 	/**
 	 trace the given ray and shade it and
@@ -138,6 +342,7 @@ public:
 	 */
 	Vec3f RayTrace(Ray& ray) const
 	{
+		auto active = activate();
 		return intersect(ray) ? ray.hit->getShader()->shade(ray) : m_bgColor;
 	}
 
@@ -146,9 +351,25 @@ private:
 	Vec3f						m_bgColor;    			///< background color
 	std::vector<ptr_prim_t> 	m_vpPrims;				///< primitives
 	std::vector<ptr_light_t>	m_vpLights;				///< lights
+	CLightTree					m_lightTree;			///< Acceleration structure for the lights
+	bool						m_lightTreeValid = false;	///< Flag indicating that the light tree holds all the lights
+	size_t						m_nShadowLights = 0;	///< The number of lights, which cast shadows
 	std::vector<ptr_camera_t>	m_vpCameras;			///< Cameras
 	size_t						m_activeCamera = 0;	//< The index of the active camera
+	std::vector<std::shared_future<ptr_solid_t>> m_vPendingSolids;	///< Solids, which are still being loaded
+	size_t						m_generation = 0;		///< The version of the scene geometry
 #ifdef ENABLE_BSP		
 	std::unique_ptr<CBSPTree>	m_pBSPTree = nullptr;	///< Pointer to the acceleration structure
 #endif
+
+	static inline thread_local const CScene* t_pActive = nullptr;	///< The active scene of the calling thread
+
+
+private:
+	// Returns a new unique identifier for the version of the scene geometry
+	static size_t newGeneration(void)
+	{
+		static std::atomic<size_t> generation(0);
+		return ++generation;
+	}
 };
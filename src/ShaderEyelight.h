@@ -25,6 +25,14 @@ public:
 	CShaderEyelight(const ptr_texture_t pTexture)
 		: CShaderFlat(pTexture)
 	{}
+	/**
+	 * @brief Constructor
+	 * @details This is a light-source-free shader. The texture is resolved lazily
+	 * @param texture The future holding the pointer to the texture (see @ref CAssetLoader)
+	 */
+	CShaderEyelight(const future_texture_t& texture)
+		: CShaderFlat(texture)
+	{}
 	virtual ~CShaderEyelight(void) = default;
 
 	virtual Vec3f shade(const Ray& ray) const override
@@ -2,6 +2,7 @@
 
 #include "IShader.h"
 #include "Texture.h"
+#include <atomic>
 
 /**
  * @brief Flat shader class
@@ -20,18 +21,59 @@ public:
 	 * @details This is a light-source-free shader
 	 * @param pTexture Pointer to the texture
 	 */
-	CShaderFlat(const ptr_texture_t pTexture) : m_pTexture(pTexture) {}
+	CShaderFlat(const ptr_texture_t pTexture) : m_pTexture(pTexture.get()), m_texture(makeReady(pTexture)) {}
+	/**
+	 * @brief Constructor
+	 * @details This is a light-source-free shader. The texture is resolved lazily, \a i.e. the first shading call waits until the texture is loaded
+	 * @param texture The future holding the pointer to the texture (see @ref CAssetLoader)
+	 */
+	CShaderFlat(const future_texture_t& texture) : m_texture(texture) {}
 
 	virtual Vec3f shade(const Ray& ray) const override
 	{
-		if (m_pTexture) {
-			return  m_pTexture->getTexel(ray.hit->getTextureCoords(ray));
+		const CTexture* pTexture = getTexture();
+		if (pTexture) {
+			return  pTexture->getTexel(ray.hit->getTextureCoords(ray));
 		}
-		else 
+		else
 			return m_color;
 	}
 
+
+protected:
+	/**
+	 * @brief Returns the shader's solid color
+	 * @return The color of the object, which is used if the shader has no texture
+	 */
+	Vec3f getColor(void) const { return m_color; }
+	/**
+	 * @brief Returns the shader's texture
+	 * @details If the texture is still being loaded, this function blocks until it is ready
+	 * @retval The pointer to the texture
+	 * @retval nullptr If the shader has no texture
+	 */
+	const CTexture* getTexture(void) const
+	{
+		const CTexture* pTexture = m_pTexture.load(std::memory_order_acquire);
+		if (!pTexture && m_texture.valid()) {
+			pTexture = m_texture.get().get();
+			m_pTexture.store(pTexture, std::memory_order_release);
+		}
+		return pTexture;
+	}
+
+
+private:
+	static future_texture_t makeReady(const ptr_texture_t pTexture)
+	{
+		std::promise<ptr_texture_t> promise;
+		promise.set_value(pTexture);
+		return promise.get_future().share();
+	}
+
+
 private:
 	Vec3f m_color;
-	const ptr_texture_t m_pTexture = nullptr;
+	mutable std::atomic<const CTexture*>	m_pTexture = nullptr;	///< Resolved texture
+	const future_texture_t					m_texture;				///< The (future) texture, keeps the texture alive
 };
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ShaderFlat.h"
+#include "ShadowQuery.h"
+#include "PhongKernel.h"
 
 class CShaderPhong : public CShaderFlat
 {
@@ -39,9 +41,50 @@ public:
 		, m_ks(ks)
 		, m_ke(ke)
 	{}
+	/**
+	* @brief Constructor
+	* @details The texture is resolved lazily, \a i.e. the first shading call waits until the texture is loaded
+	* @param scene Reference to the scene
+	* @param texture The future holding the pointer to the texture (see @ref CAssetLoader)
+	* @param ka The ambient coefficient
+	* @param kd The diffuse reflection coefficients
+	* @param ks The specular refelection coefficients
+	* @param ke The shininess exponent
+	*/
+	CShaderPhong(CScene& scene, const future_texture_t& texture, float ka, float kd, float ks, float ke)
+		: CShaderFlat(texture)
+		, m_scene(scene)
+		, m_ka(ka)
+		, m_kd(kd)
+		, m_ks(ks)
+		, m_ke(ke)
+	{}
 	virtual ~CShaderPhong(void) = default;
 
-	virtual Vec3f shade(const Ray& ray) const override
+	virtual Vec3f shade(const Ray& ray) const override;
+	virtual Vec3f shadeDeferred(const Ray& ray, std::vector<ShadowQuery>& vShadows) const override;
+
+	virtual void shadeBatch(const Ray* const* ppRays, size_t n, Vec3f* pColors, std::vector<ShadowQuery>& vShadows) const override
+	{
+		shadeBatch<true, true, true>(ppRays, n, pColors, vShadows);
+	}
+
+
+protected:
+	/**
+	 * @brief Calculates the color of the hit by the ray \b ray object
+	 * @details The template parameters allow to remove the work, which is not needed for the particular shader configuration, at compile time.
+	 * With all the flags set, the features are checked at run time. See @ref CShaderPhongT
+	 * @tparam Textured If false, the shader is assumed to have no texture and the solid color is used
+	 * @tparam Specular If false, the shader is assumed to have no specular term (ks = 0)
+	 * @tparam Shadows If false, no light source is assumed to cast shadows
+	 * @param ray The ray hitting the primitive. ray.hit must point to the primitive
+	 * @param fnShadow Function resolving the contribution of a shadow-casting light source: 
+	 * Vec3f fnShadow(const ILight& light, Ray& shadow, const Vec3f& contribution) returns the part of \b contribution which is to be added immediately
+	 * @return The color of the hit objesct
+	 */
+	template <bool Textured, bool Specular, bool Shadows, typename F>
+	Vec3f shade(const Ray& ray, F&& fnShadow) const
 	{
 		// get shading normal
 		Vec3f normal = ray.hit->getNormal(ray);
@@ -51,12 +94,16 @@ public:
 			normal = -normal;
 
 		// calculate reflection vector
-		Vec3f reflect = normalize(ray.dir - 2 * normal.dot(ray.dir) * normal);
+		Vec3f reflect;
+		if constexpr (Specular)
+			reflect = normalize(ray.dir - 2 * normal.dot(ray.dir) * normal);
 
 		// ambient term
 		Vec3f ambientIntensity(1, 1, 1);
 
-		Vec3f color = CShaderFlat::shade(ray);
+		Vec3f color;
+		if constexpr (Textured) color = CShaderFlat::shade(ray);
+		else color = getColor();
 		Vec3f ambientColor = m_ka * color;
 		Vec3f res = ambientColor.mul(ambientIntensity);
 
@@ -64,35 +111,140 @@ public:
 		Ray shadow;
 		shadow.org = ray.org + ray.t * ray.dir;
 
-		// iterate over all light sources
-		for (auto pLight : m_scene.getLights()) {
+		// iterate over the light sources, selected by the scene light tree
+		getScene().forEachLight(shadow.org, [&](ILight& light, float weight) {
 			// get direction to light, and intensity
-			std::optional<Vec3f> lightIntensity = pLight->illuminate(shadow);
+			std::optional<Vec3f> lightIntensity = light.illuminate(shadow);
 			if (lightIntensity) {
+				Vec3f intensity = weight * lightIntensity.value();
+				Vec3f lightColor = Vec3f::all(0);
+
 				// diffuse term
 				float cosLightNormal = shadow.dir.dot(normal);
 				if (cosLightNormal > 0.0f) {
-					if (pLight->shadow() && m_scene.occluded(shadow))
-						continue;
-
 					Vec3f diffuseColor = m_kd * color;
-					res += (diffuseColor * cosLightNormal).mul(lightIntensity.value());
+					lightColor += (diffuseColor * cosLightNormal).mul(intensity);
 				}
 
 				// specular term
-				float cosLightReflect = shadow.dir.dot(reflect);
-				if (cosLightReflect > 0) {
-					Vec3f specularColor = m_ks * RGB(1, 1, 1); // white highlight;
-					res += (specularColor * powf(cosLightReflect, m_ke)).mul(lightIntensity.value());
+				if constexpr (Specular) {
+					float cosLightReflect = shadow.dir.dot(reflect);
+					if (cosLightReflect > 0) {
+						Vec3f specularColor = m_ks * RGB(1, 1, 1); // white highlight;
+						lightColor += (specularColor * powf(cosLightReflect, m_ke)).mul(intensity);
+					}
 				}
+
+				// the surface may be shadowed only if it faces the light source
+				if (Shadows && cosLightNormal > 0.0f && light.shadow())
+					res += fnShadow(light, shadow, lightColor);
+				else
+					res += lightColor;
 			}
-		}
+		});
 
 		for (int i = 0; i < 3; i++)
 			if (res.val[i] > 1) res.val[i] = 1;
 
 		return res;
 	}
+	/**
+	 * @brief Calculates the colors of a batch of hits, deferring the shadow tests (see IShader::shadeBatch())
+	 * @details The hit - light samples are gathered into arrays and evaluated by the SIMD kernel (see PhongKernel). The template parameters
+	 * have the same meaning as for shade(): without the specular term the reflection vectors are not computed and the kernel skips the powers,
+	 * without shadows all the contributions are added immediately
+	 * @param ppRays The rays hitting the primitives with this shader
+	 * @param n The number of rays
+	 * @param[out] pColors The colors of the hits without the deferred contributions
+	 * @param[in,out] vShadows The container for the shadow queries
+	 */
+	template <bool Textured, bool Specular, bool Shadows>
+	void shadeBatch(const Ray* const* ppRays, size_t n, Vec3f* pColors, std::vector<ShadowQuery>& vShadows) const
+	{
+		static thread_local PhongSamples samples;
+		samples.clear();
+		const CScene& scene = getScene();
+
+		// gather the hit - light samples and the ambient term
+		Ray shadow;
+		for (size_t i = 0; i < n; i++) {
+			const Ray& ray = *ppRays[i];
+			Vec3f normal = ray.hit->getNormal(ray);
+			if (normal.dot(ray.dir) > 0)
+				normal = -normal;
+			Vec3f reflect = Vec3f::all(0);
+			if constexpr (Specular)
+				reflect = normalize(ray.dir - 2 * normal.dot(ray.dir) * normal);
+			Vec3f color;
+			if constexpr (Textured) color = CShaderFlat::shade(ray);
+			else color = getColor();
+			pColors[i] = m_ka * color;
+
+			shadow.org = ray.org + ray.t * ray.dir;
+			scene.forEachLight(shadow.org, [&](ILight& light, float weight) {
+				std::optional<Vec3f> lightIntensity = light.illuminate(shadow);
+				if (lightIntensity)
+					samples.push_back(i, &light, static_cast<float>(shadow.t), normal, reflect, shadow.dir, weight * lightIntensity.value(), color);
+			});
+		}
+
+		// diffuse and specular terms
+		PhongKernel::illuminate(samples, m_kd, Specular ? m_ks : 0.0f, m_ke);
+
+		// accumulate the contributions or defer them to the shadow queue
+		for (size_t s = 0; s < samples.size(); s++) {
+			Vec3f contribution(samples.result[0][s], samples.result[1][s], samples.result[2][s]);
+			if (Shadows && samples.cosLN[s] > 0 && samples.pLight[s]->shadow()) {
+				const Ray& ray = *ppRays[samples.hit[s]];
+				ShadowQuery query;
+				query.ray.org = ray.org + ray.t * ray.dir;
+				query.ray.dir = Vec3f(samples.light[0][s], samples.light[1][s], samples.light[2][s]);
+				query.ray.t = samples.dist[s];
+				query.contribution = contribution;
+				query.pLight = samples.pLight[s];
+				query.id = samples.hit[s];
+				vShadows.push_back(query);
+			}
+			else
+				pColors[samples.hit[s]] += contribution;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			for (int c = 0; c < 3; c++)
+				if (pColors[i].val[c] > 1) pColors[i].val[c] = 1;
+	}
+	/**
+	 * @brief Returns the scene, which provides the lights and the occluders
+	 * @return The active scene of the calling thread (see CScene::activate()) or the scene of the shader
+	 */
+	const CScene& getScene(void) const { return CScene::getActive(m_scene); }
+	/**
+	 * @brief Returns the function, which traces the shadow ray immediately
+	 * @return The function to be passed as \b fnShadow argument to shade()
+	 */
+	auto traceShadow(void) const
+	{
+		return [&scene = getScene()](const ILight& light, Ray& shadow, const Vec3f& contribution) {
+			static thread_local COccluderCache cache;
+			return scene.occluded(shadow, cache, &light) ? Vec3f::all(0) : contribution;
+		};
+	}
+	/**
+	 * @brief Returns the function, which defers the shadow ray into the shadow queue \b vShadows
+	 * @param vShadows The shadow queue
+	 * @return The function to be passed as \b fnShadow argument to shade()
+	 */
+	static auto deferShadow(std::vector<ShadowQuery>& vShadows)
+	{
+		return [&vShadows](const ILight& light, Ray& shadow, const Vec3f& contribution) {
+			ShadowQuery query;
+			query.ray = shadow;
+			query.contribution = contribution;
+			query.pLight = &light;
+			vShadows.push_back(query);
+			return Vec3f::all(0);
+		};
+	}
 
 
 protected:
@@ -102,3 +254,14 @@ protected:
 	float 	m_ks;    ///< specular refelection coefficients
 	float 	m_ke;    ///< shininess exponent
 };
+
+// the helpers returning the shadow functions have to be defined before their use
+inline Vec3f CShaderPhong::shade(const Ray& ray) const
+{
+	return shade<true, true, true>(ray, traceShadow());
+}
+
+inline Vec3f CShaderPhong::shadeDeferred(const Ray& ray, std::vector<ShadowQuery>& vShadows) const
+{
+	return shade<true, true, true>(ray, deferShadow(vShadows));
+}
@@ -0,0 +1,105 @@
+// Specialized Phong shader classes
+#pragma once
+
+#include "ShaderPhong.h"
+
+// ================================ Specialized Phong Shader Class ================================
+/**
+ * @brief Phong shader class, specialized for a particular configuration at compile time
+ * @details The generic @ref CShaderPhong checks at run time, whether it has a texture, whether the specular term is needed and
+ * whether the light sources cast shadows. These properties are fixed at construction time, thus this class moves the checks to compile time.
+ * Use the factory function makeShaderPhong() in order to get the minimal instantiation for the given constructor arguments.
+ * The light sources may still be added after the shader is created: the variant without shadows checks the scene (see CScene::castsShadows())
+ * and switches to the shadowed code as soon as a shadow-casting light source appears.
+ * @tparam Textured Flag indicating whether the shader has a texture
+ * @tparam Specular Flag indicating whether the shader has the specular term (ks > 0)
+ * @tparam Shadows Flag indicating whether the scene had light sources, which cast shadows, when the shader was created
+ */
+template <bool Textured, bool Specular, bool Shadows>
+class CShaderPhongT : public CShaderPhong
+{
+public:
+	using CShaderPhong::CShaderPhong;
+	virtual ~CShaderPhongT(void) = default;
+
+	virtual Vec3f shade(const Ray& ray) const override
+	{
+		if (!Shadows && getScene().castsShadows()) return CShaderPhong::shade<Textured, Specular, true>(ray, traceShadow());
+		return CShaderPhong::shade<Textured, Specular, Shadows>(ray, traceShadow());
+	}
+
+	virtual Vec3f shadeDeferred(const Ray& ray, std::vector<ShadowQuery>& vShadows) const override
+	{
+		if (!Shadows && getScene().castsShadows()) return CShaderPhong::shade<Textured, Specular, true>(ray, deferShadow(vShadows));
+		return CShaderPhong::shade<Textured, Specular, Shadows>(ray, deferShadow(vShadows));
+	}
+
+	virtual void shadeBatch(const Ray* const* ppRays, size_t n, Vec3f* pColors, std::vector<ShadowQuery>& vShadows) const override
+	{
+		if (!Shadows && getScene().castsShadows()) CShaderPhong::shadeBatch<Textured, Specular, true>(ppRays, n, pColors, vShadows);
+		else CShaderPhong::shadeBatch<Textured, Specular, Shadows>(ppRays, n, pColors, vShadows);
+	}
+};
+
+namespace detail {
+	// Instantiates the specialized shader for the run-time flags
+	template <bool Textured, typename T>
+	inline ptr_shader_t instantiateShaderPhong(bool specular, bool shadows, CScene& scene, const T& colorOrTexture, float ka, float kd, float ks, float ke)
+	{
+		if (specular) {
+			if (shadows)	return std::make_shared<CShaderPhongT<Textured, true, true>>(scene, colorOrTexture, ka, kd, ks, ke);
+			else			return std::make_shared<CShaderPhongT<Textured, true, false>>(scene, colorOrTexture, ka, kd, ks, ke);
+		}
+		else {
+			if (shadows)	return std::make_shared<CShaderPhongT<Textured, false, true>>(scene, colorOrTexture, ka, kd, ks, ke);
+			else			return std::make_shared<CShaderPhongT<Textured, false, false>>(scene, colorOrTexture, ka, kd, ks, ke);
+		}
+	}
+}
+
+/**
+ * @brief Creates the Phong shader specialized for the given arguments
+ * @note The variant with shadows is chosen, if the scene already has a shadow-casting light source
+ * @param scene Reference to the scene
+ * @param color The color of the object
+ * @param ka The ambient coefficient
+ * @param kd The diffuse reflection coefficients
+ * @param ks The specular refelection coefficients
+ * @param ke The shininess exponent
+ * @return Pointer to the shader
+ */
+inline ptr_shader_t makeShaderPhong(CScene& scene, const Vec3f& color, float ka, float kd, float ks, float ke)
+{
+	return detail::instantiateShaderPhong<false>(ks != 0, scene.castsShadows(), scene, color, ka, kd, ks, ke);
+}
+/**
+ * @brief Creates the Phong shader specialized for the given arguments
+ * @note The variant with shadows is chosen, if the scene already has a shadow-casting light source
+ * @param scene Reference to the scene
+ * @param pTexture Pointer to the texture
+ * @param ka The ambient coefficient
+ * @param kd The diffuse reflection coefficients
+ * @param ks The specular refelection coefficients
+ * @param ke The shininess exponent
+ * @return Pointer to the shader
+ */
+inline ptr_shader_t makeShaderPhong(CScene& scene, const ptr_texture_t pTexture, float ka, float kd, float ks, float ke)
+{
+	if (!pTexture) return makeShaderPhong(scene, Vec3f::all(0), ka, kd, ks, ke);
+	return detail::instantiateShaderPhong<true>(ks != 0, scene.castsShadows(), scene, pTexture, ka, kd, ks, ke);
+}
+/**
+ * @brief Creates the Phong shader specialized for the given arguments
+ * @note The variant with shadows is chosen, if the scene already has a shadow-casting light source
+ * @param scene Reference to the scene
+ * @param texture The future holding the pointer to the texture (see @ref CAssetLoader)
+ * @param ka The ambient coefficient
+ * @param kd The diffuse reflection coefficients
+ * @param ks The specular refelection coefficients
+ * @param ke The shininess exponent
+ * @return Pointer to the shader
+ */
+inline ptr_shader_t makeShaderPhong(CScene& scene, const future_texture_t& texture, float ka, float kd, float ks, float ke)
+{
+	return detail::instantiateShaderPhong<true>(ks != 0, scene.castsShadows(), scene, texture, ka, kd, ks, ke);
+}
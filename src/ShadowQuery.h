@@ -0,0 +1,15 @@
+// Deferred shadow query structure
+#pragma once
+
+#include "ray.h"
+
+class ILight;
+
+/// Deferred shadow query: the light contribution, which is to be added to the shaded color if the shadow ray is not occluded
+struct ShadowQuery
+{
+	Ray				ray;				///< Shadow ray from the surface point towards the light source (ray.t is the distance to the light)
+	Vec3f			contribution;		///< The color to be added if the light source is visible
+	const ILight*	pLight = nullptr;	///< The light source
+	size_t			id = 0;				///< Identifier of the shaded hit (set by the caller)
+};
@@ -0,0 +1,189 @@
+// TCP Socket class
+#pragma once
+
+#include "types.h"
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+
+// ================================ Socket Class ================================
+/**
+ * @brief Minimal blocking TCP socket class (POSIX only)
+ * @details This class owns the socket descriptor and closes it in the destructor. All the transfer methods send or receive the whole buffer
+ * and report failures (e.g. a closed connection) with their return value
+ */
+class CSocket
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param fd The socket descriptor to be owned
+	 */
+	explicit CSocket(int fd = -1) : m_fd(fd) {}
+	CSocket(const CSocket&) = delete;
+	CSocket(CSocket&& other) : m_fd(other.m_fd) { other.m_fd = -1; }
+	~CSocket(void) { close(); }
+	const CSocket& operator=(const CSocket&) = delete;
+	CSocket& operator=(CSocket&& other)
+	{
+		if (this != &other) {
+			close();
+			m_fd = other.m_fd;
+			other.m_fd = -1;
+		}
+		return *this;
+	}
+
+	/**
+	 * @brief Creates a socket listening on all the interfaces
+	 * @param port The TCP port. If zero, a free port is chosen by the system (see getPort())
+	 * @return The listening socket, which is not valid if the port could not be bound
+	 */
+	static CSocket listen(word port)
+	{
+		CSocket res(::socket(AF_INET, SOCK_STREAM, 0));
+		if (!res.isValid()) return res;
+		int yes = 1;
+		setsockopt(res.m_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (::bind(res.m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(res.m_fd, SOMAXCONN) != 0) {
+			printf("ERROR: Can't listen on port %u\n", port);
+			res.close();
+		}
+		return res;
+	}
+	/**
+	 * @brief Connects to a listening socket
+	 * @param host The host name or address
+	 * @param port The TCP port
+	 * @return The connected socket, which is not valid if the connection failed
+	 */
+	static CSocket connect(const std::string& host, word port)
+	{
+		addrinfo hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* pInfo = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pInfo) != 0) {
+			printf("ERROR: Can't resolve host %s\n", host.c_str());
+			return CSocket();
+		}
+		CSocket res;
+		for (addrinfo* p = pInfo; p; p = p->ai_next) {
+			res = CSocket(::socket(p->ai_family, p->ai_socktype, p->ai_protocol));
+			if (res.isValid() && ::connect(res.m_fd, p->ai_addr, p->ai_addrlen) == 0) break;
+			res.close();
+		}
+		freeaddrinfo(pInfo);
+		if (res.isValid()) {
+			int yes = 1;
+			setsockopt(res.m_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		}
+		return res;
+	}
+	/**
+	 * @brief Accepts a new connection
+	 * @return The connected socket
+	 */
+	CSocket accept(void) const { return CSocket(::accept(m_fd, nullptr, nullptr)); }
+	/**
+	 * @brief Sends the whole buffer
+	 * @param pData Pointer to the data
+	 * @param size The size of the data in bytes
+	 * @retval true If all the data was sent
+	 * @retval false If the connection failed
+	 */
+	bool send(const void* pData, size_t size) const
+	{
+		const char* p = static_cast<const char*>(pData);
+		while (size > 0) {
+			ssize_t n = ::send(m_fd, p, size, MSG_NOSIGNAL);
+			if (n <= 0) return false;
+			p += n;
+			size -= static_cast<size_t>(n);
+		}
+		return true;
+	}
+	/**
+	 * @brief Receives the whole buffer
+	 * @param pData Pointer to the buffer
+	 * @param size The size of the data in bytes
+	 * @retval true If all the data was received
+	 * @retval false If the connection was closed or failed
+	 */
+	bool recv(void* pData, size_t size) const
+	{
+		char* p = static_cast<char*>(pData);
+		while (size > 0) {
+			ssize_t n = ::recv(m_fd, p, size, 0);
+			if (n <= 0) return false;
+			p += n;
+			size -= static_cast<size_t>(n);
+		}
+		return true;
+	}
+	/**
+	 * @brief Returns the local port of the socket
+	 * @return The TCP port
+	 */
+	word getPort(void) const
+	{
+		sockaddr_in addr = {};
+		socklen_t len = sizeof(addr);
+		getsockname(m_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+		return ntohs(addr.sin_port);
+	}
+	/**
+	 * @brief Returns the socket descriptor
+	 * @return The socket descriptor
+	 */
+	int getFd(void) const { return m_fd; }
+	/**
+	 * @brief Checks whether the socket is valid
+	 * @retval true If the socket is open
+	 * @retval false Otherwise
+	 */
+	bool isValid(void) const { return m_fd >= 0; }
+	/**
+	 * @brief Closes the socket
+	 */
+	void close(void)
+	{
+		if (m_fd >= 0) ::close(m_fd);
+		m_fd = -1;
+	}
+
+
+private:
+	int m_fd;	///< The socket descriptor
+};
+
+// ================================ Shard Message Structure ================================
+/**
+ * @brief Header of the messages exchanged between the coordinator and the workers
+ * @details A job message (coordinator to worker) consists of the header only. A result message (worker to coordinator) is followed by
+ * the rendered pixels of the region: width x height x 3 floats, row by row
+ */
+struct ShardMessage
+{
+	/// Message types
+	enum Type : dword {
+		job = 1,		///< Render the region of the frame
+		result = 2,		///< The rendered region follows
+		quit = 3,		///< Finish the worker
+		alive = 4		///< The worker is still rendering the region (keep-alive)
+	};
+	dword	type = 0;	///< The message type
+	dword	frame = 0;	///< The frame index
+	int		x = 0;		///< The region of the frame
+	int		y = 0;
+	int		width = 0;
+	int		height = 0;
+};
+#endif
@@ -142,3 +142,5 @@ private:
 	Vec3f					m_pivot;		///< The pivot point (origin)
 	std::vector<ptr_prim_t>	m_vpPrims;		///< Container for the primitives which build the solid
 };
+
+using ptr_solid_t = std::shared_ptr<CSolid>;
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "types.h"
+#include "MemoryStats.h"
+#include <future>
 
 // ================================ Texture Class ================================
 /**
@@ -28,10 +30,25 @@ public:
 		if (!empty()) {
 			if (img.type() != CV_32FC3)
 				(*this).convertTo(*this, CV_32FC3, 1.0 / 255);
+
+			// the texture is downsampled, while it exceeds the budget of the textures (see CMemoryStats)
+			// the bytes are reserved with the check, so that the textures loaded concurrently do not exceed the budget together
+			auto& stats = CMemoryStats::instance();
+			const Size size = (*this).size();
+			while (!stats.tryAdd(CMemoryStats::Subsystem::textures, total() * elemSize())) {
+				if (rows <= 1 || cols <= 1) {
+					stats.add(CMemoryStats::Subsystem::textures, static_cast<int64>(total() * elemSize()));
+					break;
+				}
+				resize(*this, *this, Size(cols / 2, rows / 2), 0, 0, INTER_AREA);
+			}
+			if ((*this).size() != size)
+				printf("WARNING: The texture exceeds the memory budget, downsampled from %dx%d to %dx%d\n", size.width, size.height, cols, rows);
+			m_bytes = total() * elemSize();
 		}
 	}
 	CTexture(const CTexture&) = delete;
-	~CTexture(void) = default;
+	~CTexture(void) { CMemoryStats::instance().add(CMemoryStats::Subsystem::textures, -static_cast<int64>(m_bytes)); }
 	const CTexture& operator=(const CTexture&) = delete;
 		
 	/**
@@ -63,6 +80,11 @@ public:
 			return (*this).at<Vec3f>(y, x);
 		}
 	}
+
+
+private:
+	size_t	m_bytes = 0;	///< The size of the texture buffer accounted in @ref CMemoryStats
 };
 
 using ptr_texture_t = std::shared_ptr<CTexture>;
+using future_texture_t = std::shared_future<ptr_texture_t>;
@@ -0,0 +1,175 @@
+// Thread Pool class
+#pragma once
+
+#include "types.h"
+#include <functional>
+#include <future>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// ================================ Thread Pool Class ================================
+/**
+ * @brief Work-stealing thread pool class
+ * @details Every worker thread owns a task queue. A worker takes the tasks from the back of its own queue and, when its queue
+ * is empty, steals the tasks from the front of the queues of the other workers. Tasks enqueued by a worker thread go to its own queue,
+ * tasks enqueued by other threads are distributed over the queues round-robin or go to the queue of the given worker.
+ * The result of every task is delivered via a future object.
+ * @code
+ * CThreadPool pool(4);
+ * auto res = pool.enqueue([] { return imread("texture.jpg"); });
+ * Mat img = res.get();		// blocks until the task is finished
+ * @endcode
+ */
+class CThreadPool
+{
+public:
+	/**
+	 * @brief Constructor
+	 * @param nThreads The number of worker threads. If zero, the number of concurrent threads supported by the hardware is used
+	 */
+	CThreadPool(size_t nThreads = 0)
+	{
+		if (nThreads == 0) nThreads = MAX(1, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < nThreads; i++)
+			m_vpQueues.push_back(std::make_unique<Queue>());
+		for (size_t i = 0; i < nThreads; i++)
+			m_vWorkers.emplace_back([this, i] { run(i); });
+	}
+	CThreadPool(const CThreadPool&) = delete;
+	/**
+	 * @brief Destructor
+	 * @details Finishes all the tasks, which are still in the queues and joins the worker threads
+	 */
+	~CThreadPool(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_terminate = true;
+		}
+		m_cv.notify_all();
+		for (auto& worker : m_vWorkers)
+			worker.join();
+	}
+	const CThreadPool& operator=(const CThreadPool&) = delete;
+
+	/**
+	 * @brief Adds a new task
+	 * @param task The callable object to be executed by one of the worker threads
+	 * @return The future object, which will hold the result of the task
+	 */
+	template <typename F>
+	auto enqueue(F&& task) -> std::future<std::invoke_result_t<F>>
+	{
+		size_t worker = (t_pPool == this) ? t_worker : m_next.fetch_add(1, std::memory_order_relaxed) % m_vWorkers.size();
+		return enqueue(std::forward<F>(task), worker);
+	}
+	/**
+	 * @brief Adds a new task to the queue of the given worker
+	 * @details The task is still executed by another worker, if that one runs out of work
+	 * @param task The callable object to be executed by one of the worker threads
+	 * @param worker The index of the worker, whose queue receives the task
+	 * @return The future object, which will hold the result of the task
+	 */
+	template <typename F>
+	auto enqueue(F&& task, size_t worker) -> std::future<std::invoke_result_t<F>>
+	{
+		using res_t = std::invoke_result_t<F>;
+		auto pTask = std::make_shared<std::packaged_task<res_t()>>(std::forward<F>(task));
+		std::future<res_t> res = pTask->get_future();
+		{
+			// count the task before it becomes visible, so that the waiting workers do not miss it
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_nPending++;
+		}
+		Queue& queue = *m_vpQueues[worker % m_vWorkers.size()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			queue.tasks.emplace_back([pTask] { (*pTask)(); });
+		}
+		m_cv.notify_one();
+		return res;
+	}
+	/**
+	 * @brief Returns the number of worker threads
+	 * @return The number of worker threads
+	 */
+	size_t getNumThreads(void) const { return m_vWorkers.size(); }
+	/**
+	 * @brief Returns the number of tasks, which were executed by another worker than the one they were enqueued to
+	 * @return The number of stolen tasks
+	 */
+	size_t getNumSteals(void) const { return m_nSteals; }
+	/**
+	 * @brief Returns the index of the calling worker thread
+	 * @return The index of the worker within its pool, or -1 if the function is not called from a worker thread
+	 */
+	static int getWorkerIndex(void) { return t_pPool ? static_cast<int>(t_worker) : -1; }
+
+
+private:
+	/// Task queue of a worker
+	struct Queue {
+		std::deque<std::function<void(void)>>	tasks;
+		std::mutex								mtx;
+	};
+
+	// Takes a task from the own queue or steals one from the other queues
+	bool pop(size_t worker, std::function<void(void)>& task)
+	{
+		const size_t nWorkers = m_vWorkers.size();
+		for (size_t k = 0; k < nWorkers; k++) {
+			Queue& queue = *m_vpQueues[(worker + k) % nWorkers];
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			if (queue.tasks.empty()) continue;
+			if (k == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				m_nSteals++;
+			}
+			m_nPending--;
+			return true;
+		}
+		return false;
+	}
+	// Worker thread loop: executes the tasks until the pool is terminated and all the queues are empty
+	void run(size_t worker)
+	{
+		t_pPool = this;
+		t_worker = worker;
+		for (;;) {
+			std::function<void(void)> task;
+			if (pop(worker, task)) {
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_mtx);
+			if (m_nPending > 0) {				// the task is counted, but not yet in the queue
+				lock.unlock();
+				std::this_thread::yield();
+				continue;
+			}
+			if (m_terminate) return;
+			m_cv.wait(lock, [this] { return m_terminate || m_nPending > 0; });
+		}
+	}
+
+
+private:
+	std::vector<std::thread>				m_vWorkers;				///< The worker threads
+	std::vector<std::unique_ptr<Queue>>		m_vpQueues;				///< The task queues of the workers
+	std::mutex								m_mtx;					///< Mutex protecting the sleep of the workers
+	std::condition_variable					m_cv;					///< Condition variable notifying the workers
+	std::atomic<size_t>						m_nPending = 0;			///< The number of tasks in all the queues
+	std::atomic<size_t>						m_next = 0;				///< The queue for the next task enqueued from outside
+	std::atomic<size_t>						m_nSteals = 0;			///< The number of stolen tasks
+	bool									m_terminate = false;	///< Flag indicating that the workers should finish
+
+	static inline thread_local CThreadPool*	t_pPool = nullptr;		///< The pool of the calling worker thread
+	static inline thread_local size_t		t_worker = 0;			///< The index of the calling worker thread
+};
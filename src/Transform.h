@@ -158,6 +158,23 @@ public:
 		V = Vec4f(reinterpret_cast<float*>(Mat(t * Mat(V)).data));
 		return Vec3f(V.val[0], V.val[1], V.val[2]);
 	}
+	/**
+	* @brief Applies affine transormation matrix \b t to a normal \b n
+	* @details The normals are transformed with the inverse transposed linear part of \b t, which is proportional to its cofactor matrix
+	* @param n The normal in 3D space
+	* @param t The transformation matrix (size: 4 x 4)
+	* @returns The transformed normalized normal
+	*/
+	static Vec3f	normal(const Vec3f& n, const Mat& t) {
+		Vec3f r0(t.at<float>(0, 0), t.at<float>(0, 1), t.at<float>(0, 2));
+		Vec3f r1(t.at<float>(1, 0), t.at<float>(1, 1), t.at<float>(1, 2));
+		Vec3f r2(t.at<float>(2, 0), t.at<float>(2, 1), t.at<float>(2, 2));
+		Vec3f c0 = r1.cross(r2);
+		Vec3f c1 = r2.cross(r0);
+		Vec3f c2 = r0.cross(r1);
+		float sign = r0.dot(c0) < 0 ? -1.0f : 1.0f;		// the sign of the determinant
+		return normalize(sign * Vec3f(c0.dot(n), c1.dot(n), c2.dot(n)));
+	}
 	
 	
 private:
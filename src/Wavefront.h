@@ -0,0 +1,305 @@
+// Wavefront Render Pipeline class
+#pragma once
+
+#include "Scene.h"
+#include "ShadowQuery.h"
+#include "Profiler.h"
+#include "MemoryStats.h"
+
+// ================================ Wavefront Class ================================
+/**
+ * @brief Wavefront render pipeline class
+ * @details Instead of tracing and shading every pixel at once, this class processes the whole image (or its region) stage by stage:
+ * -# generate(): generates the primary rays
+ * -# intersect(): finds the closest hits of the primary rays
+ * -# sort(): sorts the hits by shader (and thus by texture) and by primitive
+ * -# shade(): shades the hits, deferring the shadow rays into a queue (see IShader::shadeDeferred())
+ * -# traceShadows(): traces the queued shadow rays
+ * -# resolve(): adds the visible light contributions and writes the colors into the image
+ *
+ * Every stage runs a tight loop over a large queue, which improves the coherence of the memory accesses. The stages may be called
+ * separately for benchmarking; the time spent in every stage is accumulated and may be retrieved with getStageTimes().
+ */
+class CWavefront
+{
+public:
+	/// Accumulated time spent in the pipeline stages in milliseconds
+	struct StageTimes {
+		double generate = 0;
+		double intersect = 0;
+		double sort = 0;
+		double shade = 0;
+		double shadow = 0;
+		double resolve = 0;
+	};
+
+	/**
+	 * @brief Constructor
+	 * @param scene Reference to the scene
+	 */
+	CWavefront(CScene& scene) : m_scene(scene) {}
+	CWavefront(const CWavefront&) = delete;
+	~CWavefront(void) { CMemoryStats::instance().add(CMemoryStats::Subsystem::framebuffers, -static_cast<int64>(m_memory)); }
+	const CWavefront& operator=(const CWavefront&) = delete;
+
+	/**
+	 * @brief Renders the scene with the active camera
+	 * @param[out] img The image (type: CV_32FC3) of the camera resolution
+	 */
+	void render(Mat& img) { render(img, Rect(0, 0, img.cols, img.rows)); }
+	/**
+	 * @brief Renders a region of the image with the active camera
+	 * @param[out] img The image (type: CV_32FC3) of the camera resolution
+	 * @param roi The region of the image to be rendered
+	 */
+	void render(Mat& img, const Rect& roi)
+	{
+		generate(*m_scene.getActiveCamera(), roi);
+		intersect();
+		sort();
+		shade();
+		traceShadows();
+		resolve(img);
+
+		// the image and the queues are accounted as framebuffers (see CMemoryStats)
+		size_t bytes = img.total() * img.elemSize() + m_vRays.capacity() * sizeof(Ray) + m_vPixels.capacity() * sizeof(Point) + m_vColors.capacity() * sizeof(Vec3f)
+			+ m_vHits.capacity() * sizeof(size_t) + m_vShadows.capacity() * sizeof(ShadowQuery) + m_vVisible.capacity() * sizeof(uchar);
+		CMemoryStats::instance().add(CMemoryStats::Subsystem::framebuffers, static_cast<int64>(bytes) - static_cast<int64>(m_memory));
+		m_memory = bytes;
+	}
+
+	/**
+	 * @brief Stage 1: Generates the primary rays for the pixels in region \b roi
+	 * @param camera The camera
+	 * @param roi The region of the image
+	 */
+	void generate(ICamera& camera, const Rect& roi)
+	{
+		PROFILE_ZONE("generate");
+		int64 ticks = getTickCount();
+		const size_t nRays = roi.area();
+		m_vRays.resize(nRays);
+		m_vPixels.resize(nRays);
+		m_vColors.resize(nRays);
+		parallel_for_(Range(0, roi.height), [&](const Range& range) {
+			RayBatch batch;
+			camera.InitRays(batch, Rect(roi.x, roi.y + range.start, roi.width, range.end - range.start));
+			for (int y = range.start; y < range.end; y++)
+				for (int x = 0; x < roi.width; x++) {
+					size_t i = static_cast<size_t>(y) * roi.width + x;
+					m_vRays[i] = Ray();
+					batch.getRay(i - static_cast<size_t>(range.start) * roi.width, m_vRays[i]);
+					m_vPixels[i] = Point(roi.x + x, roi.y + y);
+				}
+		});
+		m_times.generate += elapsed(ticks);
+	}
+	/**
+	 * @brief Stage 2: Finds the closest hits for the primary rays
+	 * @details The rays, which miss the scene get the background color
+	 */
+	void intersect(void)
+	{
+		PROFILE_ZONE("trace");
+		int64 ticks = getTickCount();
+		std::vector<uchar> vHit(m_vRays.size());
+		parallel_for_(Range(0, static_cast<int>(m_vRays.size())), [&](const Range& range) {
+			for (int i = range.start; i < range.end; i++) {
+				vHit[i] = m_scene.intersect(m_vRays[i]) ? 1 : 0;
+				STATS_PRIMARY(m_vRays[i]);
+				if (!vHit[i]) m_vColors[i] = m_scene.getBackgroundColor();
+			}
+			STATS_PUBLISH();
+		});
+		m_vHits.clear();
+		for (size_t i = 0; i < vHit.size(); i++)
+			if (vHit[i]) m_vHits.push_back(i);
+		m_times.intersect += elapsed(ticks);
+	}
+	/**
+	 * @brief Stage 3: Sorts the hits by shader and by primitive
+	 * @details Since the textures are bound to the shaders, the hits using the same texture become neighbours in the queue
+	 */
+	void sort(void)
+	{
+		PROFILE_ZONE("sort");
+		int64 ticks = getTickCount();
+		std::vector<std::pair<const IShader*, const IPrim*>> vKeys(m_vRays.size());
+		for (size_t i : m_vHits)
+			vKeys[i] = std::make_pair(m_vRays[i].hit->getShader().get(), m_vRays[i].hit.get());
+		std::stable_sort(m_vHits.begin(), m_vHits.end(), [&vKeys](size_t a, size_t b) { return vKeys[a] < vKeys[b]; });
+		m_times.sort += elapsed(ticks);
+	}
+	/**
+	 * @brief Stage 4: Shades the hits
+	 * @details The sorted hits are split into batches of the same shader, which are shaded at once (see IShader::shadeBatch()).
+	 * The shadow rays are not traced, but collected into the shadow queue
+	 */
+	void shade(void)
+	{
+		PROFILE_ZONE("shade");
+		int64 ticks = getTickCount();
+
+		// split the sorted hit queue into the batches
+		std::vector<const IShader*> vpShaders(m_vHits.size());
+		for (size_t h = 0; h < m_vHits.size(); h++)
+			vpShaders[h] = m_vRays[m_vHits[h]].hit->getShader().get();
+		std::vector<size_t> vBatches;
+		for (size_t h = 0; h < m_vHits.size(); h++)
+			if (h == 0 || vpShaders[h] != vpShaders[h - 1] || h - vBatches.back() >= m_batchSize)
+				vBatches.push_back(h);
+		vBatches.push_back(m_vHits.size());
+
+		// shade the batches
+		const int nBatches = static_cast<int>(vBatches.size()) - 1;
+		std::vector<std::vector<ShadowQuery>> vvShadows(MAX(0, nBatches));
+		parallel_for_(Range(0, nBatches), [&](const Range& range) {
+			auto active = m_scene.activate();
+			std::vector<const Ray*> vpRays;
+			std::vector<Vec3f> vColors;
+			for (int b = range.start; b < range.end; b++) {
+				const size_t begin = vBatches[b];
+				const size_t n = vBatches[b + 1] - begin;
+				vpRays.resize(n);
+				vColors.resize(n);
+				for (size_t k = 0; k < n; k++)
+					vpRays[k] = &m_vRays[m_vHits[begin + k]];
+				vpShaders[begin]->shadeBatch(vpRays.data(), n, vColors.data(), vvShadows[b]);
+				for (size_t k = 0; k < n; k++)
+					m_vColors[m_vHits[begin + k]] = vColors[k];
+				for (auto& query : vvShadows[b])
+					query.id = m_vHits[begin + query.id];
+			}
+		});
+		m_vShadows.clear();
+		for (auto& vShadows : vvShadows)
+			m_vShadows.insert(m_vShadows.end(), vShadows.begin(), vShadows.end());
+		m_times.shade += elapsed(ticks);
+	}
+	/**
+	 * @brief Stage 5: Traces the shadow rays from the shadow queue
+	 * @details The shadow queries are gathered into batches of neighbouring pixels (tiles), which are sorted by light source and by direction.
+	 * Every batch is traced as a stream by a single thread, which tests the last occluder of the light source first (see @ref COccluderCache)
+	 */
+	void traceShadows(void)
+	{
+		PROFILE_ZONE("shadow");
+		int64 ticks = getTickCount();
+		const size_t nShadows = m_vShadows.size();
+
+		// sort the queries by tile, light source and direction
+		using key_t = std::tuple<int, int, const ILight*, int>;
+		std::vector<key_t> vKeys(nShadows);
+		std::vector<size_t> vOrder(nShadows);
+		for (size_t s = 0; s < nShadows; s++) {
+			const Point& pixel = m_vPixels[m_vShadows[s].id];
+			vKeys[s] = std::make_tuple(pixel.y / m_shadowTileSize, pixel.x / m_shadowTileSize, m_vShadows[s].pLight, dirBucket(m_vShadows[s].ray.dir));
+			vOrder[s] = s;
+		}
+		std::sort(vOrder.begin(), vOrder.end(), [&vKeys](size_t a, size_t b) { return vKeys[a] < vKeys[b]; });
+
+		// split the sorted queue into the tile batches
+		std::vector<size_t> vBatches;
+		for (size_t s = 0; s < nShadows; s++)
+			if (s == 0 || std::get<0>(vKeys[vOrder[s]]) != std::get<0>(vKeys[vOrder[s - 1]]) || std::get<1>(vKeys[vOrder[s]]) != std::get<1>(vKeys[vOrder[s - 1]]))
+				vBatches.push_back(s);
+		vBatches.push_back(nShadows);
+
+		// trace the batches
+		m_vVisible.resize(nShadows);
+		std::atomic<size_t> nLookups(0);
+		std::atomic<size_t> nHits(0);
+		parallel_for_(Range(0, static_cast<int>(vBatches.size()) - 1), [&](const Range& range) {
+			static thread_local COccluderCache cache;
+			size_t lookups = cache.getNumLookups();
+			size_t hits = cache.getNumHits();
+			for (int b = range.start; b < range.end; b++)
+				for (size_t s = vBatches[b]; s < vBatches[b + 1]; s++) {
+					const ShadowQuery& query = m_vShadows[vOrder[s]];
+					m_vVisible[vOrder[s]] = m_scene.occluded(query.ray, cache, query.pLight) ? 0 : 1;
+				}
+			nLookups += cache.getNumLookups() - lookups;
+			nHits += cache.getNumHits() - hits;
+			STATS_PUBLISH();
+		});
+		m_nCacheLookups += nLookups;
+		m_nCacheHits += nHits;
+		m_times.shadow += elapsed(ticks);
+	}
+	/**
+	 * @brief Stage 6: Adds the contributions of the visible light sources and writes the colors into the image
+	 * @param[out] img The image (type: CV_32FC3)
+	 */
+	void resolve(Mat& img)
+	{
+		PROFILE_ZONE("resolve");
+		int64 ticks = getTickCount();
+		for (size_t s = 0; s < m_vShadows.size(); s++)
+			if (m_vVisible[s]) {
+				Vec3f& color = m_vColors[m_vShadows[s].id];
+				color += m_vShadows[s].contribution;
+				for (int c = 0; c < 3; c++)
+					if (color.val[c] > 1) color.val[c] = 1;
+			}
+		for (size_t i = 0; i < m_vRays.size(); i++)
+			img.at<Vec3f>(m_vPixels[i].y, m_vPixels[i].x) = m_vColors[i];
+		m_times.resolve += elapsed(ticks);
+	}
+
+	/**
+	 * @brief Returns the time spent in the pipeline stages
+	 * @return The accumulated time spent in every stage in milliseconds
+	 */
+	const StageTimes& getStageTimes(void) const { return m_times; }
+	/**
+	 * @brief Resets the accumulated stage times
+	 */
+	void resetStageTimes(void) { m_times = StageTimes(); }
+	/**
+	 * @brief Returns the sizes of the ray, hit and shadow queues after the last run
+	 * @return The number of primary rays, the number of hits and the number of shadow rays
+	 */
+	std::tuple<size_t, size_t, size_t> getQueueSizes(void) const { return std::make_tuple(m_vRays.size(), m_vHits.size(), m_vShadows.size()); }
+	/**
+	 * @brief Returns the statistics of the occluder cache
+	 * @return The number of the shadow rays blocked by the cached occluder and the number of the cache lookups
+	 */
+	std::pair<size_t, size_t> getOccluderCacheStats(void) const { return std::make_pair(m_nCacheHits, m_nCacheLookups); }
+	/**
+	 * @brief Sets the size of the tiles, into which the shadow queries are batched
+	 * @param tileSize The tile size in pixels
+	 */
+	void setShadowTileSize(int tileSize) { m_shadowTileSize = MAX(1, tileSize); }
+
+
+private:
+	static double elapsed(int64 ticks) { return 1000.0 * (getTickCount() - ticks) / getTickFrequency(); }
+	// Quantizes the direction \b dir into one of 6 x 8 x 8 cube-map cells
+	static int dirBucket(const Vec3f& dir)
+	{
+		Vec3f a(fabsf(dir.val[0]), fabsf(dir.val[1]), fabsf(dir.val[2]));
+		int axis = (a.val[0] > a.val[1]) ? ((a.val[0] > a.val[2]) ? 0 : 2) : ((a.val[1] > a.val[2]) ? 1 : 2);
+		int face = 2 * axis + (dir.val[axis] < 0 ? 1 : 0);
+		float u = dir.val[(axis + 1) % 3] / a.val[axis];		// [-1; 1]
+		float v = dir.val[(axis + 2) % 3] / a.val[axis];		// [-1; 1]
+		int iu = MIN(7, static_cast<int>(4 * (u + 1)));
+		int iv = MIN(7, static_cast<int>(4 * (v + 1)));
+		return (face * 8 + iv) * 8 + iu;
+	}
+
+
+private:
+	CScene&						m_scene;		///< The scene
+	std::vector<Ray>			m_vRays;		///< The ray queue
+	std::vector<Point>			m_vPixels;		///< The pixel coordinates of the rays
+	std::vector<Vec3f>			m_vColors;		///< The colors of the rays
+	std::vector<size_t>			m_vHits;		///< The hit queue: indices of the rays, which hit the scene
+	std::vector<ShadowQuery>	m_vShadows;		///< The shadow query queue
+	std::vector<uchar>			m_vVisible;		///< The results of the shadow queries
+	StageTimes					m_times;		///< Time spent in every stage
+	size_t						m_batchSize = 256;		///< The maximum number of hits in a shading batch
+	int							m_shadowTileSize = 16;	///< The size of the tiles for batching the shadow queries
+	size_t						m_nCacheLookups = 0;	///< The number of the occluder cache lookups
+	size_t						m_nCacheHits = 0;		///< The number of the occluder cache hits
+	size_t						m_memory = 0;			///< The size of the image and the queues accounted in @ref CMemoryStats
+};
@@ -0,0 +1,124 @@
+// Distributed Rendering Worker class
+#pragma once
+
+#include "Socket.h"
+#ifndef _WIN32
+#include "RenderEngine.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// ================================ Worker Class ================================
+/**
+ * @brief Render worker of the distributed rendering
+ * @details The worker connects to the coordinator (see @ref CCoordinator), renders the assigned regions of the frames with its own
+ * render engine and sends the pixels back. The scene of every frame is requested from the callback function once and reused for all
+ * the regions of that frame. The seed of the samplers is the frame index, thus the regions rendered by different workers fit together.
+ * While a region is being rendered, the worker sends keep-alive messages (see setHeartbeat()), so that the coordinator does not
+ * consider a long region as lost.
+ * @code
+ * CAnimation animation(scene);
+ * CRenderEngine engine(scene);
+ * CWorker worker(engine, [&](size_t frame) { return animation.snapshot(frame); });
+ * worker.run("localhost", 7777);
+ * @endcode
+ */
+class CWorker
+{
+public:
+	/// Function returning the scene for the given frame
+	using scene_fn_t = std::function<std::shared_ptr<const CScene>(size_t)>;
+
+	/**
+	 * @brief Constructor
+	 * @param engine The render engine
+	 * @param fnScene The function returning the scene for the given frame
+	 */
+	CWorker(CRenderEngine& engine, scene_fn_t fnScene) : m_engine(engine), m_fnScene(fnScene) {}
+	CWorker(const CWorker&) = delete;
+	~CWorker(void) = default;
+	const CWorker& operator=(const CWorker&) = delete;
+
+	/**
+	 * @brief Connects to the coordinator and renders the assigned regions until the coordinator asks to quit
+	 * @details The connection is retried for a few seconds, which allows to start the workers before the coordinator
+	 * @param host The host name or address of the coordinator
+	 * @param port The TCP port of the coordinator
+	 * @retval true If the coordinator asked to quit
+	 * @retval false If the connection failed or was closed
+	 */
+	bool run(const std::string& host, word port)
+	{
+		CSocket socket;
+		for (int attempt = 0; attempt < 50 && !socket.isValid(); attempt++) {
+			if (attempt) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			socket = CSocket::connect(host, port);
+		}
+		if (!socket.isValid()) {
+			printf("ERROR: Can't connect to the coordinator %s:%u\n", host.c_str(), port);
+			return false;
+		}
+
+		std::shared_ptr<const CScene> pScene;
+		size_t sceneFrame = 0;
+		Mat img;
+		for (;;) {
+			ShardMessage msg;
+			if (!socket.recv(&msg, sizeof(msg))) return false;
+			if (msg.type == ShardMessage::quit) return true;
+			if (msg.type != ShardMessage::job) return false;
+
+			if (!pScene || sceneFrame != msg.frame) {
+				pScene = m_fnScene(msg.frame);
+				sceneFrame = msg.frame;
+				img = Mat(pScene->getActiveCamera()->getResolution(), CV_32FC3, Scalar::all(0));
+			}
+			Rect region(msg.x, msg.y, msg.width, msg.height);
+			if ((region & Rect(0, 0, img.cols, img.rows)) != region) return false;
+			m_engine.setFrame(msg.frame);
+			{
+				// the keep-alive messages are sent from an own thread, which finishes before the result is sent
+				std::mutex mtx;
+				std::condition_variable cvDone;
+				bool done = false;
+				std::thread heartbeat([&, alive = msg]() mutable {
+					alive.type = ShardMessage::alive;
+					std::unique_lock<std::mutex> lock(mtx);
+					while (!cvDone.wait_for(lock, std::chrono::duration<double>(m_heartbeat), [&done] { return done; }))
+						socket.send(&alive, sizeof(alive));
+				});
+				m_engine.render(img, *pScene, region);
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					done = true;
+				}
+				cvDone.notify_one();
+				heartbeat.join();
+			}
+
+			Mat tile = img(region).clone();		// continuous
+			msg.type = ShardMessage::result;
+			if (!socket.send(&msg, sizeof(msg)) || !socket.send(tile.data, tile.total() * tile.elemSize())) return false;
+			m_nShards++;
+		}
+	}
+	/**
+	 * @brief Sets the interval of the keep-alive messages
+	 * @details The interval should be well below the timeout of the coordinator (see CCoordinator::setTimeout())
+	 * @param seconds The time between two keep-alive messages in seconds
+	 */
+	void setHeartbeat(double seconds) { m_heartbeat = MAX(0.001, seconds); }
+	/**
+	 * @brief Returns the number of rendered regions
+	 * @return The number of regions sent to the coordinator
+	 */
+	size_t getNumShards(void) const { return m_nShards; }
+
+
+private:
+	CRenderEngine&	m_engine;			///< The render engine
+	scene_fn_t		m_fnScene;			///< The function returning the scene for the given frame
+	size_t			m_nShards = 0;		///< The number of rendered regions
+	double			m_heartbeat = 15;	///< The interval of the keep-alive messages in seconds
+};
+#endif
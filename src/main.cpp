@@ -13,25 +13,144 @@
 #include "ShaderFlat.h"
 #include "ShaderEyelight.h"
 #include "ShaderPhong.h"
+#include "ShaderPhongT.h"
 
 #include "Texture.h"
 #include "Transform.h"
 
 #include "LightOmni.h"
-#include "timer.h"
+#include "AssetLoader.h"
+#include "Wavefront.h"
+#include "RenderEngine.h"
+#include "Animation.h"
+#include "FrameWriter.h"
+#include "FrameSink.h"
+#include "Coordinator.h"
+#include "Worker.h"
+#include "Profiler.h"
+#include "RayStats.h"
+#include "MemoryStats.h"
+#include "CpuDispatch.h"
 
-Mat RenderFrame(void)
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+/// Exit codes of the application
+enum ExitCode {
+	EXIT_OK = 0,		///< The frames were rendered and written
+	EXIT_USAGE = 1,		///< Invalid command-line arguments
+	EXIT_IO = 2,		///< An input or output file could not be read or written
+	EXIT_ERROR = 3		///< Rendering failed with an exception
+};
+
+/// Run-time configuration of the renderer
+struct Options {
+	Size		resolution		= Size(1280, 720);	///< Camera resolution
+	size_t		firstFrame		= 0;				///< Index of the first frame to be rendered
+	size_t		nFrames			= 1;				///< Number of frames to be rendered
+	size_t		nSides			= 32;				///< Number of sides of the spheres
+	size_t		nThreads		= 0;				///< Number of render threads (0 - all hardware threads)
+	size_t		nConcurrentFrames	= 1;			///< Number of frames rendered concurrently
+	int			tileSize		= 32;				///< Size of the render tiles
+	int			maxDepth		= 20;				///< Maximal depth of the BSP tree
+	int			minPrimitives	= 3;				///< Minimal number of primitives in a BSP leaf
+	int			maxSamples		= 0;				///< Maximal number of samples per pixel of the adaptive anti-aliasing (0 - off)
+	bool		wavefront		= false;			///< Use the wavefront pipeline instead of the tile engine
+	bool		reproject		= false;			///< Reuse the primary hits of the previous frame
+	bool		rasterize		= false;			///< Rasterize the primary visibility
+	bool		costMaps		= false;			///< Write the render cost of every pixel next to the image
+	bool		headless		= false;			///< Do not open any windows
+	FILE*		pRawStream		= nullptr;			///< Stream receiving the raw frames
+	std::string	dataPath;							///< Path to the textures
+	std::string	output;								///< File name of the last frame
+	std::string	video;								///< File name of the video
+	std::string	framePattern;						///< Pattern of the file names of the individual frames
+	std::string	viewPattern;						///< Pattern of the file names of the views (empty - active camera only)
+	std::string	json;								///< File name of the timing summary ("-" - standard output)
+	std::string	profile;							///< File name of the Chrome trace of the profile zones
+	std::string	metrics;							///< File name of the Prometheus metrics of the ray counters
+	int			coordinatorPort	= -1;				///< TCP port of the coordinator of the distributed rendering (-1 - local rendering)
+	int			shardSize		= 0;				///< Size of the regions distributed to the workers (0 - whole frames)
+	double		shardTimeout	= 60;				///< Time in seconds, after which the shard of a silent worker is reassigned
+	size_t		nSpawn			= 0;				///< Number of local worker processes started by the coordinator
+	std::string	worker;								///< Address of the coordinator (host:port), if this process is a render worker
+	std::vector<std::string> vWorkerArgs;			///< Command-line arguments of the local worker processes
+};
+
+/// Timing summary of a run
+struct Summary {
+	double				setup = 0;		///< Time spent on the scene setup in milliseconds
+	std::vector<double>	vFrames;		///< Time spent on every frame in milliseconds
+	double				stall = 0;		///< Time the rendering waited for the frame output in milliseconds
+	CRayStats::Counters	rays;			///< The ray counters at the end of the last frame
+	size_t				nIOErrors = 0;	///< The number of files, which could not be read or written
+};
+
+static double elapsed(int64 ticks) { return 1000.0 * (getTickCount() - ticks) / getTickFrequency(); }
+
+// Prints the ray throughput of the last frame and updates the metrics file
+// If the frames overlap (\b perFrame is false), the counters collected between two frames belong to several frames, thus only the cumulative rate is reported
+static void reportRays([[maybe_unused]] const Options& options, [[maybe_unused]] Summary& summary, [[maybe_unused]] bool perFrame = true)
+{
+#ifdef ENABLE_STATS
+	CRayStats::Counters counters = CRayStats::instance().collect();
+	double render = 0;
+	for (double t : summary.vFrames) render += t;
+	CRayStats::Counters frame = perFrame ? counters - summary.rays : counters;
+	double frameMs = perFrame ? summary.vFrames.back() : render;
+	summary.rays = counters;
+	if (perFrame)
+		printf("Rays: %.2f Mrays/s (%llu primary, %llu shadow), cumulative %.2f Mrays/s\n", frame.getMrays(frameMs),
+			static_cast<unsigned long long>(frame[CRayStats::Counter::primaryRays]), static_cast<unsigned long long>(frame[CRayStats::Counter::shadowRays]),
+			counters.getMrays(render));
+	else
+		printf("Rays: cumulative %.2f Mrays/s (%llu primary, %llu shadow in total)\n", counters.getMrays(render),
+			static_cast<unsigned long long>(counters[CRayStats::Counter::primaryRays]), static_cast<unsigned long long>(counters[CRayStats::Counter::shadowRays]));
+	if (!options.metrics.empty() && !CRayStats::writePrometheus(options.metrics, counters, render, frame, frameMs))
+		fprintf(stderr, "ERROR: Can't write file %s\n", options.metrics.c_str());
+#endif
+}
+
+#ifndef _WIN32
+// Starts the local worker processes, which connect to the coordinator on the port \b port
+static std::vector<pid_t> spawnWorkers(const std::vector<std::string>& vArgs, word port, size_t nWorkers)
 {
+	std::vector<std::string> vWorkerArgs(vArgs);
+	vWorkerArgs.push_back("--worker=127.0.0.1:" + std::to_string(port));
+	std::vector<char*> vpArgs;
+	for (auto& arg : vWorkerArgs) vpArgs.push_back(&arg[0]);
+	vpArgs.push_back(nullptr);
+
+	std::vector<pid_t> res;
+	fflush(stdout);
+	for (size_t w = 0; w < nWorkers; w++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			execvp(vpArgs[0], vpArgs.data());
+			_exit(EXIT_ERROR);
+		}
+		if (pid > 0) res.push_back(pid);
+		else printf("ERROR: Can't start a worker process\n");
+	}
+	return res;
+}
+#endif
+
+Mat RenderFrame(const Options& options, Summary& summary)
+{
+	int64 ticks = getTickCount();
+	std::optional<CMemoryPhase> setupPhase(std::in_place, "setup");	// left before the rendering
+
 	// Camera resolution
-	//const Size resolution(1920, 1080);
-	const Size resolution(1280, 720);
-	//const Size resolution(768, 480);
-	//const Size resolution(480, 360);
-	//const Size resolution(352, 240);
-	
+	const Size resolution = options.resolution;
 
 	// number of sides of the spheres
-	const size_t nSides = 32;
+	const size_t nSides = options.nSides;
 	
 	// Background color
 	const Vec3f bgColor = RGB(0, 0, 0);
@@ -48,27 +167,21 @@ Mat RenderFrame(void)
 	scene.add(cam1);				
 	scene.add(cam2);
 
-#ifdef WIN32
-	const std::string dataPath = "../data/";
-#else
-	const std::string dataPath = "../../../data/";
-#endif
-
-	// Textures
-	Mat imgEarth = imread(dataPath + "earth_8k.jpg");
-	if (imgEarth.empty()) printf("ERROR: Texture file is not found!\n");
-	auto pTextureEarth = std::make_shared<CTexture>(imgEarth);
-	Mat imgMoon = imread(dataPath + "moon_8k.jpg");
-	if (imgMoon.empty()) printf("ERROR: Texture file is not found!\n");
-	auto pTextureMoon = std::make_shared<CTexture>(imgMoon);
+	const std::string dataPath = options.dataPath;
 
+	// Textures (decoded in background, while the geometry and the BSP tree are being built)
+	CAssetLoader loader;
+	auto textureEarth = loader.loadTexture(dataPath + "earth_8k.jpg");
+	auto textureMoon = loader.loadTexture(dataPath + "moon_8k.jpg");
 
-	// Shaders
-	auto pShaderEarth = std::make_shared<CShaderPhong>(scene, pTextureEarth, 0.1f, 0.9f, 0.0f, 40.0f);
-	auto pShaderMoon = std::make_shared<CShaderPhong>(scene, pTextureMoon, 0.1f, 0.9f, 0.0f, 40.0f);
 
 	// Light
 	auto sun = std::make_shared<CLightOmni>(Vec3f::all(3e10), Vec3f(0, 0, 0), false);
+	scene.add(sun);
+
+	// Shaders
+	auto pShaderEarth = makeShaderPhong(scene, textureEarth, 0.1f, 0.9f, 0.0f, 40.0f);			// see eyden-bench for the comparison with the generic shader
+	auto pShaderMoon = makeShaderPhong(scene, textureMoon, 0.1f, 0.9f, 0.0f, 40.0f);
 
 	// Geometry
 	auto earth = CSolidSphere(pShaderEarth, Vec3f(150000, 0, 0), 6.371f, nSides);
@@ -80,70 +193,422 @@ Mat RenderFrame(void)
 	moon.transform(transform.get());
 
 	// Add everything to the scene
-	scene.add(sun);
 	scene.add(earth);
 	scene.add(moon);
 
 	scene.setActiveCamera(1);
+	std::cout << "Scene bounds are : " << scene.getBoundingBox() << std::endl;
 	Mat img(resolution, CV_32FC3);									// image array
 	Mat frame_img;
 	
-	const size_t nFrames = 1;										// 180 frames - 6 seconds of video
-	VideoWriter videoWriter;
-	if (nFrames) {
+	const size_t nFrames = options.nFrames;							// 180 frames - 6 seconds of video
+	CFrameWriter frameWriter(4);									// the frames are written in the background
+	if (nFrames > 1 && !options.video.empty()) {
 		auto codec = VideoWriter::fourcc('M', 'J', 'P', 'G');		// Native windows codec
 		//auto codec = VideoWriter::fourcc('H', '2', '6', '4');		// Try it on MacOS
-		videoWriter.open("video.avi", codec, 30, resolution);
-		if (!videoWriter.isOpened()) printf("ERROR: Can't open vide file for writing\n");
+		auto pVideo = std::make_shared<CFrameSinkVideo>(options.video, codec, 30, resolution);
+		if (pVideo->isOpened()) frameWriter.addSink(pVideo);
+		else summary.nIOErrors++;
 	}
+	if (nFrames > 1 && !options.headless) frameWriter.addSink(std::make_shared<CFrameSinkDisplay>("frame", 5));
+	if (!options.framePattern.empty()) frameWriter.addSink(std::make_shared<CFrameSinkFile>(options.framePattern));	// e.g. lossless float frames
+	if (options.pRawStream) frameWriter.addSink(std::make_shared<CFrameSinkRaw>(options.pRawStream));					// pipe into an external encoder
 
 	// --- PUT YOUR CODE HERE ---
 	// derive the transormation matrices here
 	Mat earthTransform = Mat::eye(4, 4, CV_32FC1);
 	Mat moonTransform = Mat::eye(4, 4, CV_32FC1);
 
-	for (size_t frame = 0; frame < nFrames; frame++) {
-		// Build BSPTree
-		scene.buildAccelStructure(20, 3);
-		
-		img.setTo(0);
-		parallel_for_(Range(0, img.rows), [&](const Range& range) {
-			Ray ray;												// primary ray
-			for (int y = range.start; y < range.end; y++) {
-				Vec3f* pImg = img.ptr<Vec3f>(y);					// fast processing via pointers
-				for (int x = 0; x < img.cols; x++) {
-					scene.getActiveCamera()->InitRay(ray, x, y, Vec2f::all(0.5f));	// initialize ray
-					pImg[x] = scene.RayTrace(ray);
-				} // x
-			} // y
-			});
-		img.convertTo(frame_img, CV_8UC3, 255);
-		if (nFrames > 1) {
-			videoWriter << frame_img;
-			imshow("frame", frame_img);
-			printf("Frame %zu / %zu\n", frame, nFrames); 
-			waitKey(5);
+	// Every frame is rendered from its own snapshot of the scene (see CAnimation), which re-uses the arenas of this scene
+	CScene frameScene(bgColor);
+
+	// Wavefront mode: the image is rendered stage by stage (see CWavefront)
+	const bool useWavefront = options.wavefront;
+	CWavefront wavefront(frameScene);
+	CRenderEngine engine(scene, options.nThreads, options.tileSize, CRenderEngine::TileOrder::morton);
+
+	// Adaptive anti-aliasing: 4 to maxSamples samples per pixel
+	const bool antiAliasing = options.maxSamples > 1;
+	if (antiAliasing) engine.setAdaptiveSampling(4, options.maxSamples, 0.01f);
+
+	// Temporal reprojection: the primary hits of the previous frame are tested first
+	engine.setReprojection(options.reproject);
+
+	// Hybrid mode: the primary hits are rasterized, the shadow rays are traced
+	engine.setRasterization(options.rasterize);
+
+	// Instrumentation: BSP nodes, primitive tests, shadow rays and time of every pixel
+	engine.setCostMap(options.costMaps);
+
+	// The transforms are given as functions of the frame index, so that all the modes render the same geometry in every frame
+	// --- PUT YOUR CODE HERE ---
+	// Describe the transforms here
+	Mat rotationAroundTheSun = Mat::eye(4, 4, CV_32FC1);
+	auto power = [](const Mat& t, size_t n) {
+		Mat res = Mat::eye(4, 4, CV_32FC1);
+		for (size_t i = 0; i < n; i++) res = t * res;
+		return res;
+	};
+	CAnimation animation(scene);
+	animation.setAccelStructure(options.maxDepth, options.minPrimitives);
+	animation.animate(earth, [&](size_t frame) { return power(rotationAroundTheSun * earthTransform, frame); });
+	animation.animate(moon, [&](size_t frame) { return power(rotationAroundTheSun * moonTransform, frame); });
+	auto onFrame = [&](size_t frame, const Mat& frameImg) {
+		frameImg.copyTo(img);
+		frameWriter.push(img, frame);
+		summary.vFrames.push_back(elapsed(ticks));
+		reportRays(options, summary, false);						// the frames are rendered concurrently or by the workers
+		ticks = getTickCount();
+		if (nFrames > 1) printf("Frame %zu / %zu\n", frame - options.firstFrame, nFrames);
+	};
+
+	summary.setup = elapsed(ticks);
+	setupPhase.reset();
+	const bool distributed = options.coordinatorPort >= 0 || !options.worker.empty();
+	const bool multiView = !options.viewPattern.empty() && !distributed;
+	const bool frameParallel = options.nConcurrentFrames > 1 && !useWavefront && !distributed && !multiView;
+	if (multiView) {
+		// Multi-view mode: all the cameras are rendered in one pass over the same BSP tree
+		auto pSnapshot = animation.snapshot(options.firstFrame);
+		std::vector<Mat> vViews;
+		engine.setFrame(static_cast<dword>(options.firstFrame));
+		ticks = getTickCount();
+		{
+			MEMORY_PHASE("render");
+			engine.render(vViews, *pSnapshot);
+		}
+		summary.vFrames.push_back(elapsed(ticks));
+		reportRays(options, summary);
+		for (size_t v = 0; v < vViews.size(); v++) {
+			const std::string fileName = CFrameSinkFile::getFileName(options.viewPattern, v);
+			vViews[v].convertTo(frame_img, CV_8UC3, 255);
+			if (!imwrite(fileName, frame_img)) {
+				fprintf(stderr, "ERROR: Can't write file %s\n", fileName.c_str());
+				summary.nIOErrors++;
+			}
+		}
+		vViews[pSnapshot->getActiveCameraIndex()].copyTo(img);
+	}
+	else if (distributed) {
+#ifdef _WIN32
+		throw std::runtime_error("Distributed rendering is not supported on this platform");
+#else
+		if (!options.worker.empty()) {
+			// Worker mode: the regions assigned by the coordinator are rendered and sent back
+			size_t colon = options.worker.find_last_of(':');
+			if (colon == std::string::npos) throw std::runtime_error("The coordinator address must be given as host:port");
+			CWorker worker(engine, [&animation](size_t frame) { return animation.snapshot(frame); });
+			worker.setHeartbeat(options.shardTimeout / 4);
+			if (!worker.run(options.worker.substr(0, colon), static_cast<word>(std::stoi(options.worker.substr(colon + 1)))))
+				throw std::runtime_error("Lost the connection to the coordinator");
+			printf("Worker rendered %zu shards\n", worker.getNumShards());
+			return Mat();
 		}
 
-		// --- PUT YOUR CODE HERE ---
-		// Apply transforms here 
-		Mat rotationAroundTheSun = Mat::eye(4, 4, CV_32FC1);
-		earth.transform(rotationAroundTheSun * earthTransform);
-		moon.transform(rotationAroundTheSun * moonTransform);
+		// Coordinator mode: the frames or their regions are rendered by the workers
+		CCoordinator coordinator(static_cast<word>(options.coordinatorPort), resolution, options.shardSize);
+		if (!coordinator.isValid()) throw std::runtime_error("Can't start the coordinator");
+		coordinator.setTimeout(options.shardTimeout);
+		printf("Coordinator is listening on port %u\n", coordinator.getPort());
+		std::vector<pid_t> vWorkers = spawnWorkers(options.vWorkerArgs, coordinator.getPort(), options.nSpawn);
+		ticks = getTickCount();
+		MEMORY_PHASE("render");
+		bool success = coordinator.run(options.firstFrame, nFrames, onFrame);
+		for (pid_t pid : vWorkers) waitpid(pid, nullptr, 0);
+		if (!success) throw std::runtime_error("Distributed rendering failed");
+		printf("Workers: %zu, reassigned shards: %zu\n", coordinator.getNumWorkers(), coordinator.getNumReassigned());
+#endif
+	}
+	else if (frameParallel) {
+		ticks = getTickCount();
+		MEMORY_PHASE("render");
+		animation.render(options.firstFrame, nFrames, options.nConcurrentFrames, options.nThreads, onFrame, [&](CRenderEngine& frameEngine) {
+			frameEngine.setTileSize(options.tileSize);
+			if (antiAliasing) frameEngine.setAdaptiveSampling(4, options.maxSamples, 0.01f);
+			frameEngine.setReprojection(options.reproject);
+			frameEngine.setRasterization(options.rasterize);
+		});
+	}
+	else for (size_t frame = options.firstFrame; frame < options.firstFrame + nFrames; frame++) {
+		PROFILE_ZONE("frame");
+		ticks = getTickCount();
 
-		// --- PUT YOUR CODE HERE ---
-		// Apply camera animation here
+		// Snapshot of the scene with its BSP tree
+		{
+			MEMORY_PHASE("bsp build");
+			animation.snapshot(frame, frameScene);
+		}
+
+		{
+			MEMORY_PHASE("render");
+			img.setTo(0);
+			if (useWavefront)
+				wavefront.render(img);
+			else {
+				engine.setFrame(static_cast<dword>(frame));
+				engine.render(img, frameScene);
+			}
+		}
+		frameWriter.push(img, frame);
+		summary.vFrames.push_back(elapsed(ticks));
+		reportRays(options, summary);
+		if (nFrames > 1) printf("Frame %zu / %zu\n", frame - options.firstFrame, nFrames);
+		if (options.reproject && !useWavefront) {
+			auto& stats = engine.getReprojectionStats();
+			printf("Reprojection: %.1f%% hits (%zu reused, %zu rejected, %zu traced)\n", 100 * stats.getHitRate(), stats.reused, stats.rejected, stats.traced);
+		}
+	}
+	img.convertTo(frame_img, CV_8UC3, 255);
+	{
+		MEMORY_PHASE("output");
+		frameWriter.flush();
+	}
+	summary.stall = frameWriter.getStallTime();
+	summary.nIOErrors += frameWriter.getNumFailed();
+	for (auto& texture : { textureEarth, textureMoon })
+		if (texture.get()->empty()) summary.nIOErrors++;			// the loader reported the missing file
+	if (nFrames > 1) printf("Frame output stalled the rendering for %.0f ms\n", summary.stall);
+
+	if (useWavefront && !multiView) {
+		auto& times = wavefront.getStageTimes();
+		printf("Wavefront stages (ms): generate %.1f, intersect %.1f, sort %.1f, shade %.1f, shadow %.1f, resolve %.1f\n",
+			times.generate, times.intersect, times.sort, times.shade, times.shadow, times.resolve);
+	}
+	else if (!frameParallel && !distributed) {
+		// the sample and cost maps are written next to the image, e.g. image_spp.png and image_nodes.png for image.jpg
+		std::string prefix = options.output.empty() ? "image" : options.output;
+		size_t dot = prefix.find_last_of('.'), slash = prefix.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) prefix.erase(dot);
+
+		if (multiView) printf("Views: %zu\n", scene.getCameras().size());
+		auto& vTileTimes = engine.getTileTimes();
+		double minTime = std::numeric_limits<double>::max(), maxTime = 0, sumTime = 0;
+		for (auto& tileTime : vTileTimes) {
+			minTime = MIN(minTime, tileTime.time);
+			maxTime = MAX(maxTime, tileTime.time);
+			sumTime += tileTime.time;
+		}
+		printf("Tiles: %zu on %zu threads (%zu stolen), time per tile (ms): min %.2f, mean %.2f, max %.2f\n",
+			vTileTimes.size(), engine.getNumThreads(), engine.getNumSteals(), minTime, sumTime / MAX(1, vTileTimes.size()), maxTime);
+		if (antiAliasing) {
+			printf("Samples per pixel: mean %.2f\n", mean(engine.getSampleMap())[0]);
+			const std::string fileName = prefix + "_spp.png";
+			if (!imwrite(fileName, engine.getSampleHeatmap())) {
+				fprintf(stderr, "ERROR: Can't write file %s\n", fileName.c_str());
+				summary.nIOErrors++;
+			}
+		}
+		if (options.costMaps && !multiView) {
+			const CCostMap& costMap = *engine.getCostMap();
+			printf("Cost per pixel: mean %.1f nodes, %.1f primitive tests, %.2f shadow rays, %.0f ns\n",
+				mean(costMap.get(CCostMap::Channel::nodes))[0], mean(costMap.get(CCostMap::Channel::prims))[0],
+				mean(costMap.get(CCostMap::Channel::shadows))[0], mean(costMap.get(CCostMap::Channel::time))[0]);
+			if (!costMap.write(prefix)) throw std::runtime_error("Can't write the cost maps " + prefix + "_*");
+		}
 	}
 	return frame_img;
 }
 
+// Writes the timing summary as JSON
+static bool writeSummary(const std::string& fileName, const Options& options, const Summary& summary, double total, int status)
+{
+	FILE* pFile = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+	if (!pFile) return false;
+	double render = 0;
+	for (double t : summary.vFrames) render += t;
+	fprintf(pFile, "{\n");
+	fprintf(pFile, "  \"status\": %d,\n", status);
+	fprintf(pFile, "  \"resolution\": [%d, %d],\n", options.resolution.width, options.resolution.height);
+	fprintf(pFile, "  \"first_frame\": %zu,\n", options.firstFrame);
+	fprintf(pFile, "  \"frames\": %zu,\n", summary.vFrames.size());
+	fprintf(pFile, "  \"threads\": %zu,\n", options.nThreads ? options.nThreads : static_cast<size_t>(MAX(1, std::thread::hardware_concurrency())));
+	fprintf(pFile, "  \"isa\": \"%s\",\n", CCpuDispatch::getName(CCpuDispatch::instance().getISA()));
+	fprintf(pFile, "  \"setup_ms\": %.3f,\n", summary.setup);
+	fprintf(pFile, "  \"render_ms\": %.3f,\n", render);
+	fprintf(pFile, "  \"output_stall_ms\": %.3f,\n", summary.stall);
+	fprintf(pFile, "  \"total_ms\": %.3f,\n", total);
+	fprintf(pFile, "  \"memory\": ");
+	CMemoryStats::instance().writeJson(pFile, "  ");
+	fprintf(pFile, ",\n");
+	fprintf(pFile, "  \"frame_ms\": [");
+	for (size_t f = 0; f < summary.vFrames.size(); f++)
+		fprintf(pFile, "%s%.3f", f ? ", " : "", summary.vFrames[f]);
+	fprintf(pFile, "]\n}\n");
+	if (pFile != stdout) fclose(pFile);
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
-	DirectGraphicalModels::Timer::start("Rendering...");
-	Mat img = RenderFrame();
-	DirectGraphicalModels::Timer::stop();
-	imshow("Image", img);
-	waitKey();
-	imwrite("image.jpg", img);
-	return 0;
+	const std::string keys =
+		"{help ?      |              | Print this message}"
+		"{width       | 1280         | Image width in pixels}"
+		"{height      | 720          | Image height in pixels}"
+		"{first       | 0            | Index of the first frame}"
+		"{frames      | 1            | Number of frames}"
+		"{sides       | 32           | Number of sides of the spheres}"
+		"{threads     | 0            | Number of render threads (0 - all hardware threads)}"
+		"{parallel-frames | 1        | Number of frames rendered concurrently from scene snapshots}"
+		"{tile        | 32           | Size of the render tiles in pixels}"
+		"{depth       | 20           | Maximal depth of the BSP tree}"
+		"{leaf        | 3            | Minimal number of primitives in a BSP leaf}"
+		"{spp         | 0            | Maximal number of samples per pixel of the adaptive anti-aliasing (0 - off)}"
+		"{wavefront   |              | Use the wavefront pipeline}"
+		"{reproject   |              | Reuse the primary hits of the previous frame}"
+		"{raster      |              | Rasterize the primary visibility instead of tracing the primary rays}"
+		"{cost-maps   |              | Write the BSP nodes, primitive tests, shadow rays and time of every pixel next to the output image}"
+		"{data        |              | Path to the data folder}"
+		"{output      | image.jpg    | File name of the last frame (empty - do not write)}"
+		"{video       | video.avi    | File name of the video, written if more than one frame is rendered (empty - do not write)}"
+		"{frame-files |              | Pattern of the frame file names, e.g. frame_%04zu.pfm}"
+		"{views       |              | Render all the cameras of the first frame in one pass into files with this pattern, e.g. view_%zu.png}"
+		"{raw         |              | Pipe the raw 8-bit BGR frames to the standard output}"
+		"{headless    |              | Do not open any windows}"
+		"{json        |              | File name of the JSON timing summary (- for the standard output)}"
+		"{profile     |              | Print the profile phases and write the Chrome trace into this file (requires ENABLE_PROFILER)}"
+		"{metrics     |              | Write the ray counters in the Prometheus text format into this file after every frame (requires ENABLE_STATS)}"
+		"{memory-budget |            | Memory budgets in MB, e.g. textures=256,bsp_nodes=64 (subsystems: primitives, bsp_nodes, bsp_leaves, textures, framebuffers, video)}"
+		"{coordinator |              | Distribute the rendering to the workers connecting to this TCP port (0 - any free port)}"
+		"{spawn       | 0            | Number of local worker processes started by the coordinator}"
+		"{shard       | 0            | Size of the regions distributed to the workers in pixels (0 - whole frames)}"
+		"{shard-timeout | 60         | Seconds without a message, after which the shard of a worker is reassigned; the workers send keep-alive messages 4 times as often}"
+		"{worker      |              | Render the regions assigned by the coordinator at host:port}";
+	CommandLineParser parser(argc, argv, keys);
+	parser.about("eyden-tracer");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return EXIT_OK;
+	}
+
+	Options options;
+	options.resolution		= Size(parser.get<int>("width"), parser.get<int>("height"));
+	options.firstFrame		= static_cast<size_t>(MAX(0, parser.get<int>("first")));
+	options.nFrames			= static_cast<size_t>(MAX(0, parser.get<int>("frames")));
+	options.nSides			= static_cast<size_t>(MAX(0, parser.get<int>("sides")));
+	options.nThreads		= static_cast<size_t>(MAX(0, parser.get<int>("threads")));
+	options.nConcurrentFrames	= static_cast<size_t>(MAX(1, parser.get<int>("parallel-frames")));
+	options.tileSize		= parser.get<int>("tile");
+	options.maxDepth		= parser.get<int>("depth");
+	options.minPrimitives	= parser.get<int>("leaf");
+	options.maxSamples		= parser.get<int>("spp");
+	options.wavefront		= parser.has("wavefront");
+	options.reproject		= parser.has("reproject");
+	options.rasterize		= parser.has("raster");
+	options.costMaps		= parser.has("cost-maps");
+	options.headless		= parser.has("headless");
+	options.dataPath		= parser.get<std::string>("data");
+	options.output			= parser.get<std::string>("output");
+	options.video			= parser.get<std::string>("video");
+	options.framePattern	= parser.get<std::string>("frame-files");
+	options.viewPattern		= parser.get<std::string>("views");
+	options.json			= parser.get<std::string>("json");
+	options.profile			= parser.get<std::string>("profile");
+	options.metrics			= parser.get<std::string>("metrics");
+	options.coordinatorPort	= parser.has("coordinator") ? parser.get<int>("coordinator") : -1;
+	options.shardSize		= MAX(0, parser.get<int>("shard"));
+	options.shardTimeout	= parser.get<double>("shard-timeout");
+	options.nSpawn			= static_cast<size_t>(MAX(0, parser.get<int>("spawn")));
+	options.worker			= parser.get<std::string>("worker");
+	if (options.coordinatorPort >= 0)
+		// the local workers get the same scene options
+		for (int i = 0; i < argc; i++) {
+			std::string arg = argv[i];
+			std::string key = arg.substr(MIN(arg.size(), arg.find_first_not_of('-')));
+			if (i == 0 || (key.rfind("coordinator", 0) && key.rfind("spawn", 0) && key.rfind("raw", 0) && key.rfind("json", 0) && key.rfind("metrics", 0) && key.rfind("profile", 0)))
+				options.vWorkerArgs.push_back(arg);
+		}
+	if (options.dataPath.empty())
+#ifdef WIN32
+		options.dataPath = "../data/";
+#else
+		options.dataPath = "../../../data/";
+#endif
+	if (options.dataPath.back() != '/' && options.dataPath.back() != '\\') options.dataPath += "/";
+
+	const bool validBudgets = CMemoryStats::instance().parseBudgets(parser.get<std::string>("memory-budget"));
+
+	if (!parser.check() || !validBudgets || options.resolution.width <= 0 || options.resolution.height <= 0 || options.nFrames == 0 || options.nSides < 3 || options.tileSize <= 0 || options.maxDepth < 0 || options.minPrimitives < 1
+		|| (!options.framePattern.empty() && !CFrameSinkFile::isValidPattern(options.framePattern))
+		|| (!options.viewPattern.empty() && !CFrameSinkFile::isValidPattern(options.viewPattern)) || options.coordinatorPort > 65535 || options.shardTimeout <= 0) {
+		parser.printErrors();
+		fprintf(stderr, "ERROR: Invalid arguments, see --help\n");
+		return EXIT_USAGE;
+	}
+
+	if (!options.worker.empty()) {
+		// the worker sends the rendered regions to the coordinator and writes nothing
+		options.headless = true;
+		options.output.clear();
+		options.video.clear();
+		options.framePattern.clear();
+		options.json.clear();
+		options.profile.clear();
+	}
+	else if (parser.has("raw")) {
+		// the frames get the original standard output, all the messages go to the standard error
+		fflush(stdout);
+#ifdef _WIN32
+		FILE* pRaw = _fdopen(_dup(_fileno(stdout)), "wb");
+		_setmode(_fileno(pRaw), _O_BINARY);
+		_dup2(_fileno(stderr), _fileno(stdout));
+#else
+		FILE* pRaw = fdopen(dup(fileno(stdout)), "wb");
+		dup2(fileno(stderr), fileno(stdout));
+#endif
+		options.pRawStream = pRaw;
+		options.headless = true;
+	}
+
+	printf("Kernels: %s\n", CCpuDispatch::instance().getReport().c_str());
+
+	int status = EXIT_OK;
+	Summary summary;
+	int64 ticks = getTickCount();
+	Mat img;
+	try {
+		PROFILE_ZONE("render");
+		printf("Rendering... ");
+		img = RenderFrame(options, summary);
+	}
+	catch (const std::exception& e) {
+		fprintf(stderr, "ERROR: %s\n", e.what());
+		status = EXIT_ERROR;
+	}
+	double total = elapsed(ticks);
+	if (status == EXIT_OK) printf("Done! (%.0f ms)\n", total);
+	CMemoryStats::instance().printSummary();
+	CMemoryStats::instance().checkBudgets();
+
+	if (status == EXIT_OK && !options.headless) {
+		imshow("Image", img);
+		waitKey();
+	}
+	if (status == EXIT_OK && !options.output.empty() && !imwrite(options.output, img)) {
+		fprintf(stderr, "ERROR: Can't write file %s\n", options.output.c_str());
+		status = EXIT_IO;
+	}
+	if (!options.profile.empty()) {
+#ifdef ENABLE_PROFILER
+		CProfiler::instance().printPhases();
+		if (!CProfiler::instance().writeChromeTrace(options.profile)) {
+			fprintf(stderr, "ERROR: Can't write file %s\n", options.profile.c_str());
+			if (status == EXIT_OK) status = EXIT_IO;
+		}
+#else
+		fprintf(stderr, "WARNING: The profiler is disabled in this build, configure with ENABLE_PROFILER\n");
+#endif
+	}
+#ifndef ENABLE_STATS
+	if (!options.metrics.empty()) fprintf(stderr, "WARNING: The ray counters are disabled in this build, configure with ENABLE_STATS\n");
+	if (options.costMaps) fprintf(stderr, "WARNING: The cost maps record only the time in this build, configure with ENABLE_STATS\n");
+#endif
+	if (status == EXIT_OK && summary.nIOErrors) {
+		fprintf(stderr, "ERROR: %zu input or output files could not be read or written\n", summary.nIOErrors);
+		status = EXIT_IO;
+	}
+	if (!options.json.empty() && !writeSummary(options.json, options, summary, total, status)) {
+		fprintf(stderr, "ERROR: Can't write file %s\n", options.json.c_str());
+		if (status == EXIT_OK) status = EXIT_IO;
+	}
+	return status;
 }
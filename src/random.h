@@ -6,13 +6,81 @@
 #include "types.h"
 #include <random>
 
+// ================================ PCG Generator Class ==============================
+/**
+* @brief Permuted congruential generator (PCG32)
+* @details A small and fast generator with 64 bits of state and 32-bit output (see <a href="https://www.pcg-random.org">www.pcg-random.org</a>).
+* Different \a streams with the same seed produce independent sequences. The class satisfies the requirements of the 
+* <a href="https://en.cppreference.com/w/cpp/named_req/UniformRandomBitGenerator">UniformRandomBitGenerator</a>, thus it may be used with the standard distributions
+*/
+class CPCG32
+{
+public:
+	using result_type = dword;
+
+	/**
+	* @brief Constructor
+	* @param seed The initial state
+	* @param stream The index of the sequence
+	*/
+	CPCG32(qword seed = 0x853c49e6748fea9bULL, qword stream = 0xda3e39cb94b95bdbULL) { this->seed(seed, stream); }
+	/**
+	* @brief Restarts the generator
+	* @param seed The initial state
+	* @param stream The index of the sequence
+	*/
+	void seed(qword seed, qword stream = 0xda3e39cb94b95bdbULL)
+	{
+		m_state = 0;
+		m_inc = (stream << 1) | 1;
+		(*this)();
+		m_state += seed;
+		(*this)();
+	}
+	/**
+	* @brief Returns the next random number
+	* @return The random number from interval [0, 2<sup>32</sup>)
+	*/
+	dword operator()(void)
+	{
+		qword old = m_state;
+		m_state = old * 6364136223846793005ULL + m_inc;
+		dword xorshifted = static_cast<dword>(((old >> 18) ^ old) >> 27);
+		dword rot = static_cast<dword>(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+	static constexpr dword min(void) { return 0; }
+	static constexpr dword max(void) { return 0xffffffff; }
+
+
+private:
+	qword m_state;		///< The state
+	qword m_inc;		///< The increment, selecting the sequence
+};
+
 // ================================ Random Namespace ==============================
 /**
 * @brief Random number generation
-* @details This namespace collects methods for generating random numbers and vectors with uniform and normal distributions
+* @details This namespace collects methods for generating random numbers and vectors with uniform and normal distributions.
+* Every thread has its own PCG32 generator. By default it is seeded from the clock and the thread id; with seed() the
+* sequence of the calling thread may be restarted, e.g. for every pixel, in order to make the results independent of the thread schedule
 * @author Sergey G. Kosov, sergey.kosov@project-10.de
 */
 namespace Random {
+	/**
+	* @brief Returns the generator of the calling thread
+	* @return The thread-local generator
+	*/
+	inline CPCG32& generator(void)
+	{
+		static thread_local CPCG32 generator(static_cast<qword>(clock()) + std::hash<std::thread::id>()(std::this_thread::get_id()));
+		return generator;
+	}
+	/**
+	* @brief Restarts the generator of the calling thread
+	* @param seed The new seed
+	*/
+	inline void seed(qword seed) { generator().seed(seed); }
 	/**
 	* @brief Returns an integer random number with uniform distribution
 	* @details This function produces random integer values \a i, uniformly distributed on the closed interval [\b min, \b max], that is, distributed according to the discrete probability function:
@@ -26,9 +94,8 @@ namespace Random {
 	template <typename T>
 	inline T u(T min, T max)
 	{
-		static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
 		std::uniform_int_distribution<T> distribution(min, max);
-		return distribution(generator);
+		return distribution(generator());
 	}
 	/**
 	* @brief Returns a floating-point random number with uniform distribution
@@ -43,9 +110,9 @@ namespace Random {
 	template <typename T>
 	inline T U(T min = 0, T max = 1)
 	{
-		static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
-		std::uniform_real_distribution<T> distribution(min, max);
-		return distribution(generator);
+		// 24 random bits are exactly representable in float, 32 in double
+		T u = std::is_same_v<T, float> ? static_cast<T>(generator()() >> 8) * static_cast<T>(1.0 / 16777216.0) : static_cast<T>(generator()()) * static_cast<T>(1.0 / 4294967296.0);
+		return min + (max - min) * u;
 	}
 	/**
 	* @brief Returns a floating-point random number with normal distribution
@@ -60,9 +127,10 @@ namespace Random {
 	template <typename T>
 	inline T N(T mu = 0, T sigma = 1)
 	{
-		static thread_local std::mt19937 generator(static_cast<unsigned int>(clock() + std::hash<std::thread::id>()(std::this_thread::get_id())));
-		std::normal_distribution<T> distribution(mu, sigma);
-		return distribution(generator);
+		// Box-Muller transform
+		T u1 = 1 - U<T>();									// (0; 1]
+		T u2 = U<T>();
+		return mu + sigma * sqrt(-2 * log(u1)) * cos(2 * static_cast<T>(Pi) * u2);
 	}
 
 
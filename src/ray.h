@@ -16,3 +16,49 @@ struct Ray
 	float							u = 0;											///< Barycentric u coordinate
 	float							v = 0;											///< Barycentric v coordinate
 };
+
+/**
+ * @brief Batch of rays in the structure-of-arrays layout
+ * @details The rays of a rectangular region of the screen are stored row by row, every coordinate in its own array. This layout allows
+ * the cameras to generate the rays with vectorized loops (see ICamera::InitRays()). The BSP tree and the primitives intersect single rays,
+ * therefore the renderers unpack every ray with getRay() before the traversal
+ */
+struct RayBatch
+{
+	Rect				region;			///< The pixels of the rays
+	std::vector<float>	orgX;			///< Origins
+	std::vector<float>	orgY;
+	std::vector<float>	orgZ;
+	std::vector<float>	dirX;			///< Normalized directions
+	std::vector<float>	dirY;
+	std::vector<float>	dirZ;
+
+	/**
+	 * @brief Resizes the arrays for the region \b roi
+	 * @param roi The pixels of the rays
+	 */
+	void resize(const Rect& roi)
+	{
+		region = roi;
+		const size_t n = static_cast<size_t>(roi.area());
+		for (auto* pArray : { &orgX, &orgY, &orgZ, &dirX, &dirY, &dirZ })
+			pArray->resize(n);
+	}
+	/**
+	 * @brief Returns the number of rays
+	 * @return The number of rays
+	 */
+	size_t size(void) const { return dirX.size(); }
+	/**
+	 * @brief Initializes the ray \b ray with the i-th ray of the batch
+	 * @param i The index of the ray, i.e. (y - region.y) * region.width + (x - region.x) for the pixel (x, y)
+	 * @param[out] ray The ray with the maximum hit distance and without hit
+	 */
+	void getRay(size_t i, Ray& ray) const
+	{
+		ray.org = Vec3f(orgX[i], orgY[i], orgZ[i]);
+		ray.dir = Vec3f(dirX[i], dirY[i], dirZ[i]);
+		ray.t = std::numeric_limits<double>::infinity();
+		ray.hit = nullptr;
+	}
+};